@@ -13,6 +13,15 @@
 namespace linuxdeploy {
     namespace core {
         namespace appdir {
+            // how AppDir::deduplicateFiles() replaces files which have the same contents as another file
+            enum DEDUPLICATION_POLICY {
+                // replace duplicates with hardlinks, which is transparent to the applications
+                DEDUPLICATE_WITH_HARDLINKS = 0,
+                // replace duplicates with relative symlinks, which are also preserved by tools which don't handle
+                // hardlinks
+                DEDUPLICATE_WITH_SYMLINKS,
+            };
+
             /*
              * Base class for AppDirs.
              */
@@ -43,6 +52,8 @@ namespace linuxdeploy {
 
                     // deploy shared library
                     //
+                    // if path is a symlink, e.g., the soname link, the file it points to is copied, and the symlinks are
+                    // recreated next to it
                     // if destination is specified, the library is copied to this location, and the rpath is adjusted accordingly
                     // the dependencies are copied to the normal destination, though
                     bool deployLibrary(const boost::filesystem::path& path, const boost::filesystem::path& destination = "");
@@ -62,6 +73,12 @@ namespace linuxdeploy {
                     // the dependencies end up in the regular location
                     bool deployDependenciesOnlyForElfFile(const boost::filesystem::path& elfFilePath, bool failSilentForNonElfFile = false);
 
+                    // deploy dependencies for multiple ELF files in the AppDir, see deployDependenciesOnlyForElfFile()
+                    // the files' dependencies are traced together, which requires fewer resolver calls
+                    // files which cannot be handled are skipped, in that case, false is returned after processing the
+                    // remaining files
+                    bool deployDependenciesOnlyForElfFiles(const std::vector<boost::filesystem::path>& elfFilePaths, bool failSilentForNonElfFile = false);
+
                     // deploy desktop file
                     bool deployDesktopFile(const desktopfile::DesktopFile& desktopFile);
 
@@ -113,6 +130,31 @@ namespace linuxdeploy {
 
                     // disable deployment of copyright files for this instance
                     void setDisableCopyrightFilesDeployment(bool disable);
+
+                    // set maximum number of parallel jobs used to trace dependencies
+                    // 0 means number of CPU cores, which is the default
+                    // must be called before any files are deployed
+                    void setJobs(unsigned int jobs);
+
+                    // set maximum number of files copied in parallel by executeDeferredOperations()
+                    // 0 means the number of jobs, which is the default
+                    // I/O bound setups, e.g., network filesystems, may benefit from values higher than that
+                    void setCopyQueueDepth(unsigned int depth);
+
+                    // add entries of an excludelist file to the libraries which are not deployed, in addition to the
+                    // excludelist generated at build time
+                    // the file contains one filename or glob pattern per line, # starts a comment
+                    // must be called before any files are deployed
+                    // returns false if the file cannot be read
+                    bool addExcludelistFile(const boost::filesystem::path& path);
+
+                    // replace files in the AppDir whose contents are identical to another file's with links to that
+                    // file, according to the given policy, and log the number of bytes saved
+                    // only files of the same size are read and compared, files which are hardlinks of each other
+                    // already, symlinks and empty files are left alone
+                    // should be called once all files have been deployed, i.e., after executeDeferredOperations()
+                    // returns false if some of the files could not be replaced
+                    bool deduplicateFiles(DEDUPLICATION_POLICY policy = DEDUPLICATE_WITH_HARDLINKS);
             };
         }
     }
@@ -0,0 +1,64 @@
+// system includes
+#include <stdexcept>
+#include <string>
+
+// library includes
+#include <boost/filesystem.hpp>
+
+#pragma once
+
+namespace linuxdeploy {
+    namespace core {
+        namespace copy_engine {
+            // thrown if a file cannot be copied
+            class CopyError : public std::runtime_error {
+                public:
+                    explicit CopyError(const std::string& msg) : std::runtime_error(msg) {}
+            };
+
+            // how files are put into the AppDir
+            enum COPY_MODE {
+                // copy the data, sharing it with the source file if the filesystem supports it
+                COPY_MODE_COPY = 0,
+                // create hardlinks where possible, which is only safe for AppDirs which are thrown away after use, as
+                // tools modifying the files in place would also modify the source files
+                COPY_MODE_HARDLINK,
+            };
+
+            // methods which can be used to copy a file, in the order in which they're tried
+            enum COPY_METHOD {
+                // share the data with the source file (FICLONE), e.g., on btrfs or XFS
+                COPY_METHOD_REFLINK = 0,
+                // copy within the kernel, which may also share the data, e.g., on NFS
+                COPY_METHOD_COPY_FILE_RANGE,
+                COPY_METHOD_SENDFILE,
+                COPY_METHOD_READ_WRITE,
+                COPY_METHOD_HARDLINK,
+                COPY_METHODS_COUNT,
+            };
+
+            // select mode used by copyFile()
+            // by default, files are copied, unless $USE_HARDLINKS is set
+            void setCopyMode(COPY_MODE mode);
+
+            // return mode used by copyFile()
+            COPY_MODE getCopyMode();
+
+            // copy regular file, or the file a symlink points to, replacing the destination if it exists
+            // holes in sparse files are preserved
+            // if allowHardlink is true and hardlink mode is selected, a hardlink is created if possible
+            // a destination with more than one link is never written to, it is replaced instead
+            // returns the method which has been used
+            // throws CopyError on failure
+            COPY_METHOD copyFile(const boost::filesystem::path& from, const boost::filesystem::path& to, bool allowHardlink = false);
+
+            // replace file with a copy if it has more than one link, to make sure modifying it doesn't modify any
+            // other files
+            // throws CopyError on failure
+            void breakHardlink(const boost::filesystem::path& path);
+
+            // return number of files copyFile() has copied with the given method
+            size_t getCopiedFilesCount(COPY_METHOD method);
+        }
+    }
+}
@@ -0,0 +1,92 @@
+// system includes
+#include <string>
+#include <vector>
+
+// library includes
+#include <boost/filesystem.hpp>
+
+#pragma once
+
+namespace linuxdeploy {
+    namespace core {
+        namespace dependency_cache {
+            // data stored for a single file
+            class CachedFile {
+                public:
+                    // rpath (or runpath) stored in the file
+                    std::string rpath;
+
+                    // whether the file's dependencies have been traced
+                    bool hasDependencies = false;
+
+                    // transitive dependencies as returned by ElfFile::traceDynamicDependencies()
+                    std::vector<boost::filesystem::path> dependencies;
+            };
+
+            /*
+             * Persistent cache of the data gathered by tracing ELF files, shared between runs of linuxdeploy.
+             *
+             * Files are identified by their canonical path, device, inode, size and modification time. The entries of
+             * the dependencies are validated the same way on every lookup. The whole cache is discarded if the linker's
+             * cache (/etc/ld.so.cache), $LD_LIBRARY_PATH or the environment key (e.g., the dependency resolver) have
+             * changed since it was written.
+             *
+             * Note that the absence of files is not recorded: if a library is added to a directory which is searched
+             * before the one the library has been found in when the entry was created, the entry is still used.
+             *
+             * The cache file is mapped into memory and looked up directly using binary search. New entries are kept in
+             * memory until save() is called, which merges them with the entries other processes may have written in
+             * the meantime, and atomically replaces the file. This makes the cache safe to use from multiple
+             * processes. All methods may be called from multiple threads.
+             */
+            class DependencyCache {
+                private:
+                    class PrivateData;
+                    PrivateData* d;
+
+                public:
+                    // load cache from given path
+                    // environmentKey describes any further settings the entries depend on, e.g., the dependency
+                    // resolver, and is treated like the rest of the environment
+                    // if the file does not exist, cannot be read or has been written for another environment, the
+                    // cache is empty
+                    explicit DependencyCache(const boost::filesystem::path& path, const std::string& environmentKey = "");
+                    ~DependencyCache();
+
+                    DependencyCache(const DependencyCache&) = delete;
+                    DependencyCache& operator=(const DependencyCache&) = delete;
+
+                public:
+                    // return path of the cache in the user's cache directory, i.e., $XDG_CACHE_HOME/linuxdeploy or
+                    // ~/.cache/linuxdeploy
+                    // returns an empty path if neither of the variables is set
+                    static boost::filesystem::path getDefaultPath();
+
+                public:
+                    // look up data of given file
+                    // returns false if there is no entry for the file, or if the file or one of its dependencies has
+                    // changed since the entry has been created
+                    bool lookup(const boost::filesystem::path& path, CachedFile& cachedFile) const;
+
+                    // add or replace entry for given file
+                    // the entry is not stored if the file or one of its dependencies cannot be found
+                    void insert(const boost::filesystem::path& path, const CachedFile& cachedFile);
+
+                    // write the entries to disk, merging them with the entries in the file written by other processes
+                    // in the meantime
+                    // entries of files which have changed are dropped
+                    // returns false if the cache could not be written
+                    bool save();
+
+                    // return number of entries, including the ones not saved yet
+                    size_t size() const;
+
+                    // return number of lookups which have returned an entry
+                    size_t getHits() const;
+
+                    // return number of lookups which haven't returned an entry
+                    size_t getMisses() const;
+            };
+        }
+    }
+}
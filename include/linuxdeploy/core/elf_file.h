@@ -1,4 +1,6 @@
 // system includes
+#include <map>
+#include <memory>
 #include <vector>
 #include <string>
 // including system elf header, which allows for interpretation of the return values of the methods
@@ -7,6 +9,11 @@
 // library includes
 #include <boost/filesystem.hpp>
 
+// local includes
+#include "linuxdeploy/core/dependency_cache.h"
+#include "linuxdeploy/core/log.h"
+#include "linuxdeploy/util/thread_pool.h"
+
 #pragma once
 
 namespace linuxdeploy {
@@ -24,6 +31,46 @@ namespace linuxdeploy {
                     explicit DependencyNotFoundError(const std::string& msg) : std::runtime_error(msg) {}
             };
 
+            // methods traceDynamicDependencies() can use to resolve the dependencies of an ELF file
+            enum DEPENDENCY_RESOLVER {
+                // in-process resolver, reads the dynamic section and emulates the search algorithm of the system's linker
+                NATIVE_RESOLVER = 0,
+                // runs ldd on the file and parses its output
+                LDD_RESOLVER,
+            };
+
+            // methods getRPath() and setRPath() can use to read and modify the rpath
+            enum RPATH_EDITOR {
+                // in-process editor, modifies the dynamic section, and moves the dynamic string table to a new segment
+                // at the end of the file if the new value doesn't fit into it
+                NATIVE_EDITOR = 0,
+                // runs patchelf
+                PATCHELF_EDITOR,
+            };
+
+            // methods strip() can use to remove the symbols and the debug information from an ELF file
+            enum STRIPPER {
+                // in-process stripper, writes a copy of the file without the removed sections, leaving the segments
+                // which are loaded at runtime untouched
+                NATIVE_STRIPPER = 0,
+                // runs binutils' strip
+                BINUTILS_STRIPPER,
+            };
+
+            // result of tracing a single file's dependencies with ElfFile::traceDynamicDependencies(paths)
+            class DependencyTraceResult {
+                public:
+                    std::vector<boost::filesystem::path> dependencies;
+
+                    // set if the dependencies could not be traced, e.g., because a library is missing
+                    // contains the message traceDynamicDependencies() would have thrown a DependencyNotFoundError with
+                    std::string error;
+            };
+
+            // messages about a single file, collected while processing multiple files in parallel, so that the
+            // caller can print them along with the file's other messages
+            typedef std::vector<std::pair<log::LD_LOGLEVEL, std::string>> FileMessages;
+
             class ElfFile {
                 private:
                     class PrivateData;
@@ -43,22 +90,92 @@ namespace linuxdeploy {
                     // return system (ELF) endianness
                     static uint8_t getSystemElfEndianness();
 
+                    // select method used by traceDynamicDependencies()
+                    // by default, the native resolver is used, unless $USE_LDD is set
+                    static void setDependencyResolver(DEPENDENCY_RESOLVER resolver);
+
+                    // return method used by traceDynamicDependencies()
+                    static DEPENDENCY_RESOLVER getDependencyResolver();
+
+                    // select method used by getRPath() and setRPath()
+                    // by default, the native editor is used, unless $USE_PATCHELF is set
+                    static void setRPathEditor(RPATH_EDITOR editor);
+
+                    // return method used by getRPath() and setRPath()
+                    static RPATH_EDITOR getRPathEditor();
+
+                    // select method used by strip()
+                    // by default, the native stripper is used, unless $USE_STRIP is set
+                    static void setStripper(STRIPPER stripper);
+
+                    // return method used by strip()
+                    static STRIPPER getStripper();
+
+                    // parsed files are cached process-wide, keyed by their device and inode numbers, modification time
+                    // and size
+                    // these return how many constructor calls could use the cached data, and how many had to parse the file
+                    static size_t getParseCacheHits();
+                    static size_t getParseCacheMisses();
+
+                    // drop all cached data and reset the counters
+                    static void clearParseCache();
+
+                    // use a persistent cache for the results of traceDynamicDependencies() and getRPath()
+                    // the cache is disabled by default, pass nullptr to disable it again
+                    static void setDependencyCache(std::shared_ptr<dependency_cache::DependencyCache> cache);
+
+                    // return persistent cache, or nullptr if it is disabled
+                    static std::shared_ptr<dependency_cache::DependencyCache> getDependencyCache();
+
+                    // trace dynamic library dependencies of multiple ELF files
+                    // works like the non-static traceDynamicDependencies(), but if ldd has to be used, it's called once
+                    // for as many files as the system's argument size limit allows, rather than once per file
+                    // the returned map contains a result for every path passed in
+                    static std::map<boost::filesystem::path, DependencyTraceResult> traceDynamicDependencies(const std::vector<boost::filesystem::path>& paths);
+
+                    // works like traceDynamicDependencies(paths), but traces the files in parallel using the given pool
+                    static std::map<boost::filesystem::path, DependencyTraceResult> traceDynamicDependencies(const std::vector<boost::filesystem::path>& paths, util::thread_pool::ThreadPool& pool);
+
+                    // set rpaths of multiple ELF files, rpaths maps the files' paths to the values to set
+                    // works like setRPath(), but the files are edited in parallel using the given pool, and if patchelf
+                    // has to be used, it's called once per rpath value for as many files as the system's argument size
+                    // limit allows, rather than once per file
+                    // returns an error message for every file whose rpath could not be set
+                    // if messages is passed, the warnings and debug messages about the single files are stored in it
+                    // rather than being logged
+                    static std::map<boost::filesystem::path, std::string> setRPaths(const std::map<boost::filesystem::path, std::string>& rpaths, util::thread_pool::ThreadPool& pool, std::map<boost::filesystem::path, FileMessages>* messages = nullptr);
+
                 public:
                     // recursively trace dynamic library dependencies of a given ELF file
                     // this works for both libraries and executables
                     // the resulting vector consists of absolute paths to the libraries determined by the same methods a system's
                     // linker would use
+                    // if the native resolver cannot find a library, ldd is used as a fallback
                     std::vector<boost::filesystem::path> traceDynamicDependencies();
 
+                    // works like traceDynamicDependencies(), but the native resolver searches and parses the libraries
+                    // in parallel using the given pool
+                    // the result is the same as the one of the sequential variant
+                    std::vector<boost::filesystem::path> traceDynamicDependencies(util::thread_pool::ThreadPool& pool);
+
                     // fetch rpath stored in binary
                     // it appears that according to the ELF standard, the rpath is ignored in libraries, therefore if the path
                     // points to an executable, an empty string is returned
                     std::string getRPath();
 
                     // set rpath in ELF file
+                    // if the native editor cannot edit the file, e.g., because of an unusual layout, patchelf is used as a
+                    // fallback
                     // returns true on success, false otherwise
                     bool setRPath(const std::string& value);
 
+                    // write a copy of the file without symbol tables, debug information and comments to destination
+                    // destination may be the file itself, in which case it is replaced once the copy has been written
+                    // the copy has the same permissions as the file
+                    // if the native stripper cannot handle the file, strip is used as a fallback
+                    // returns true on success, false otherwise
+                    bool strip(const boost::filesystem::path& destination);
+
                     // return ELF class
                     uint8_t getElfClass();
 
@@ -0,0 +1,75 @@
+// system includes
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// library includes
+#include <boost/filesystem.hpp>
+
+#pragma once
+
+namespace linuxdeploy {
+    namespace core {
+        namespace excludelist_matcher {
+            // thrown if an excludelist file cannot be read
+            class ExcludelistError : public std::runtime_error {
+                public:
+                    explicit ExcludelistError(const std::string& msg) : std::runtime_error(msg) {}
+            };
+
+            /*
+             * Matches filenames against an excludelist, i.e., a list of sonames and glob patterns as understood by
+             * fnmatch() with FNM_PATHNAME.
+             *
+             * The entries are compiled once when constructing the matcher. Literal entries are put into a perfect hash
+             * table, so that looking them up requires a single hash calculation and string comparison. All the glob
+             * patterns are combined into a single automaton, which is simulated bit-parallel, i.e., a filename is
+             * scanned once, no matter how many patterns there are.
+             *
+             * Matching does not modify the matcher, and may be performed from multiple threads.
+             */
+            class ExcludelistMatcher {
+                private:
+                    class PrivateData;
+                    PrivateData* d;
+
+                public:
+                    // compile given entries, which may be literal filenames as well as glob patterns
+                    explicit ExcludelistMatcher(const std::vector<std::string>& entries);
+
+                    // compile entries which have been separated into literal filenames and glob patterns already
+                    ExcludelistMatcher(const std::vector<std::string>& literals, const std::vector<std::string>& patterns);
+
+                    ~ExcludelistMatcher();
+
+                    ExcludelistMatcher(const ExcludelistMatcher&) = delete;
+                    ExcludelistMatcher& operator=(const ExcludelistMatcher&) = delete;
+
+                public:
+                    // return matcher for the excludelist generated at build time
+                    static const ExcludelistMatcher& getGenerated();
+
+                    // return entries of the excludelist generated at build time
+                    static std::vector<std::string> getGeneratedEntries();
+
+                    // read entries from an excludelist file
+                    // the file contains one entry per line, everything after a # is ignored, as are empty lines
+                    // throws ExcludelistError if the file cannot be read
+                    static std::vector<std::string> readEntries(const boost::filesystem::path& path);
+
+                    // check whether entry is a glob pattern rather than a literal filename
+                    static bool isPattern(const std::string& entry);
+
+                public:
+                    // check whether filename matches any of the entries
+                    bool matches(const std::string& fileName) const;
+
+                    // return number of distinct literal filenames
+                    size_t literalsCount() const;
+
+                    // return number of glob patterns
+                    size_t patternsCount() const;
+            };
+        }
+    }
+}
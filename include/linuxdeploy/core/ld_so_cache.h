@@ -0,0 +1,65 @@
+// system includes
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// library includes
+#include <boost/filesystem.hpp>
+
+#pragma once
+
+namespace linuxdeploy {
+    namespace core {
+        namespace ld_so_cache {
+            // thrown by constructor if the cache file cannot be read
+            class LdSoCacheError : public std::runtime_error {
+                public:
+                    explicit LdSoCacheError(const std::string& msg) : std::runtime_error(msg) {}
+            };
+
+            // return names of the glibc-hwcaps subdirectories (e.g., x86-64-v3) the system's linker searches for
+            // libraries of the given ELF class and machine, in the order it searches them
+            // only the x86-64 microarchitecture levels are supported, the list is empty for all other architectures
+            std::vector<std::string> getGlibcHwcapsSubdirectories(uint8_t elfClass, uint16_t elfMachine);
+
+            /*
+             * Read-only view of the linker's cache, usually found in /etc/ld.so.cache.
+             *
+             * The file is mapped into memory, and lookups are performed directly on the mapped data, using the same
+             * binary search the linker uses. Both the old (libc5 compatible) and the new (glibc-ld.so.cache1.1) format
+             * are supported.
+             *
+             * Like the linker, lookups prefer the entries of the glibc-hwcaps subdirectories supported by the CPU (see
+             * getGlibcHwcapsSubdirectories()) over the generic ones. Entries of the legacy hwcaps subdirectories are
+             * ignored.
+             */
+            class LdSoCache {
+                private:
+                    class PrivateData;
+                    PrivateData* d;
+
+                public:
+                    explicit LdSoCache(const boost::filesystem::path& path);
+                    ~LdSoCache();
+
+                    LdSoCache(const LdSoCache&) = delete;
+                    LdSoCache& operator=(const LdSoCache&) = delete;
+
+                public:
+                    // return instance reading the system's cache, shared by all users for the whole run
+                    // returns nullptr if the system's cache cannot be read, e.g., because there is none
+                    static std::shared_ptr<LdSoCache> getInstance();
+
+                public:
+                    // look up path of library with the given soname which is compatible with given ELF class and machine
+                    // the returned string points into the mapped file and remains valid as long as the instance exists
+                    // returns nullptr if no matching library could be found
+                    const char* lookup(const char* soname, uint8_t elfClass, uint16_t elfMachine) const;
+
+                    // return number of entries in the cache
+                    size_t size() const;
+            };
+        }
+    }
+}
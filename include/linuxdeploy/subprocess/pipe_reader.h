@@ -12,6 +12,9 @@ class pipe_reader {
 private:
     const int pipe_fd_;
 
+    // set once the write end of the pipe has been closed and all data has been read
+    bool eof_ = false;
+
 public:
     /**
      * Construct new instance from pipe file descriptor.
@@ -32,5 +35,12 @@ public:
      * @param buffer buffer to store read data into
      * @returns amount of characters read from the pipe
      */
-    size_t read(std::vector<std::string::value_type>& buffer) const;
+    size_t read(std::vector<std::string::value_type>& buffer);
+
+    /**
+     * Check whether the end of the pipe has been reached, i.e., a read() returned 0 because the write end has been
+     * closed rather than because there was no data available.
+     * @return true if there is nothing left to read from the pipe, false otherwise
+     */
+    bool eof() const;
 };
@@ -1,7 +1,9 @@
 // system headers
+#include <chrono>
 #include <unordered_map>
 #include <vector>
 #include <signal.h>
+#include <sys/resource.h>
 
 // local headers
 #include "linuxdeploy/subprocess/subprocess.h"
@@ -17,22 +19,38 @@ namespace linuxdeploy {
             int stdout_fd_ = -1;
             int stderr_fd_ = -1;
 
+            // becomes readable once the child process has exited, see exit_fd()
+            int exit_fd_ = -1;
+            // true if exit_fd_ is the process-wide SIGCHLD self-pipe rather than a pidfd owned by this instance
+            bool exit_fd_is_shared_ = false;
+
             // process exited
             bool exited_ = false;
             // exit code -- will be initialized by close()
             int exit_code_ = -1;
 
+            // used to calculate the wall time in resource_usage_
+            std::chrono::steady_clock::time_point start_time_;
+            // filled in once the process has been reaped
+            subprocess_resource_usage resource_usage_;
+
             // these constants help make the pipe code more readable
             static constexpr int READ_END_ = 0, WRITE_END_ = 1;
 
-            static std::vector<char*> make_args_vector_(const std::vector<std::string>& args);
+            // returned by close() if the process could not be spawned, like shells do if a command cannot be found
+            static constexpr int SPAWN_FAILED_EXIT_CODE_ = 127;
 
-            static std::vector<char*> make_env_vector_(const subprocess_env_map_t& env);
+            static std::vector<char*> make_args_vector_(const std::vector<std::string>& args);
 
             static int check_waitpid_status_(int status);
 
             static void close_pipe_fd_(int fd);
 
+            void open_exit_fd_();
+
+            // stores the resource usage reported by wait4(), and records it in subprocess_statistics
+            void record_resource_usage_(const struct rusage& usage);
+
         public:
             /**
              * Create a child process.
@@ -51,7 +69,7 @@ namespace linuxdeploy {
             ~process();
 
             /**
-             * @return child process's ID
+             * @return child process's ID, -1 if the process could not be spawned
              */
             int pid() const;
 
@@ -66,6 +84,22 @@ namespace linuxdeploy {
              */
             int stderr_fd() const;
 
+            /**
+             * File descriptor which becomes readable once the child process has exited, to be used with poll() and
+             * alike. Uses a pidfd where the kernel supports it (Linux 5.3+), and a SIGCHLD self-pipe otherwise.
+             * The self-pipe is shared by all processes, therefore a notification may belong to another child, and
+             * the notification for this child may be consumed by another thread. Callers must check is_running()
+             * whenever the file descriptor becomes readable and should not wait on it indefinitely if
+             * exit_fd_is_shared() returns true.
+             * @return file descriptor signaling the process's exit
+             */
+            int exit_fd() const;
+
+            /**
+             * @return true if exit_fd() is the process-wide SIGCHLD self-pipe, false if it is a pidfd
+             */
+            bool exit_fd_is_shared() const;
+
             /**
              * Close all pipes and wait for process to exit.
              * If process is not running any more, just returns exit code.
@@ -73,6 +107,13 @@ namespace linuxdeploy {
              */
             int close();
 
+            /**
+             * Resources used by the process. Available once the process has exited, i.e., after close() has been
+             * called or is_running() has returned false. All zero if the process could not be spawned.
+             * @return resources used by the process
+             */
+            const subprocess_resource_usage& resource_usage() const;
+
             /**
              * Kill underlying process with given signal. By default, SIGTERM is used to end the process.
              */
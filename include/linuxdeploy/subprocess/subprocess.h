@@ -2,11 +2,15 @@
 
 // system headers
 #include <cstdio>
+#include <functional>
 #include <unordered_map>
 #include <string>
 #include <utility>
 #include <vector>
 
+// library headers
+#include <boost/utility/string_view.hpp>
+
 // local headers
 #include "subprocess_result.h"
 
@@ -14,18 +18,70 @@ namespace linuxdeploy {
     namespace subprocess {
         typedef std::unordered_map<std::string, std::string> subprocess_env_map_t;
 
+        // receives output of a subprocess, the data is only valid during the call
+        typedef std::function<void(boost::string_view data)> subprocess_output_callback_t;
+
+        /**
+         * Splits output passed in chunks of arbitrary size into lines, and passes them on to a callback without the
+         * trailing line break. Lines which are contained in a single chunk are passed on without copying them.
+         */
+        class line_splitter {
+        private:
+            subprocess_output_callback_t line_callback_;
+            // incomplete line at the end of the previous chunk(s)
+            std::string partial_line_;
+
+        public:
+            explicit line_splitter(subprocess_output_callback_t line_callback);
+
+            /**
+             * Pass on all complete lines in data, and keep the rest until the next call.
+             */
+            void feed(boost::string_view data);
+
+            /**
+             * Pass on the remaining incomplete line, if any. To be called once there is no more data.
+             */
+            void finish();
+        };
+
         class subprocess {
         private:
             std::vector<std::string> args_{};
             std::unordered_map<std::string, std::string> env_{};
 
+            int run_(const subprocess_output_callback_t& stdout_callback,
+                     const subprocess_output_callback_t& stderr_callback,
+                     subprocess_resource_usage& resource_usage) const;
+
         public:
             subprocess(std::initializer_list<std::string> args, subprocess_env_map_t env = {});
 
             explicit subprocess(std::vector<std::string> args, subprocess_env_map_t env = {});
 
+            /**
+             * Run process and collect its output.
+             * @return exit code and output of the process
+             */
             subprocess_result run() const;
 
+            /**
+             * Run process and pass its output to the callbacks as soon as it has been read from the pipes, in chunks
+             * of arbitrary size. The output is not stored, which makes this the cheapest way to process large outputs.
+             * @param stdout_callback called with the data read from the process's stdout, may be empty
+             * @param stderr_callback called with the data read from the process's stderr, may be empty
+             * @return exit code of the process
+             */
+            int run(const subprocess_output_callback_t& stdout_callback,
+                    const subprocess_output_callback_t& stderr_callback) const;
+
+            /**
+             * Like run() with output callbacks, but the callbacks are called for every line, without the line break.
+             * A final line not terminated by a line break is passed on, too.
+             */
+            int run_lines(const subprocess_output_callback_t& stdout_line_callback,
+                          const subprocess_output_callback_t& stderr_line_callback) const;
+
             std::string check_output() const;
         };
     }
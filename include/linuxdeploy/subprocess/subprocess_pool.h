@@ -0,0 +1,127 @@
+#pragma once
+
+// system headers
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// local headers
+#include "subprocess.h"
+#include "subprocess_result.h"
+
+namespace linuxdeploy {
+    namespace subprocess {
+        /**
+         * Runs many subprocesses concurrently, with at most a given number of them running at the same time.
+         * The pipes and exit fds of all running processes are watched by a single event loop thread, so there is no
+         * thread blocked per process. The results are handed out through futures or callbacks.
+         * The destructor waits for all submitted commands to finish.
+         */
+        class subprocess_pool {
+        public:
+            typedef std::function<void(subprocess_result)> callback_t;
+
+        private:
+            // a submitted command, and what to do with its result
+            struct job_ {
+                std::vector<std::string> args;
+                subprocess_env_map_t env;
+                std::function<void(subprocess_result)> on_result;
+                std::function<void(std::exception_ptr)> on_error;
+            };
+
+            // defined in the implementation, holds the process and its output
+            class running_job_;
+
+            const size_t max_concurrency_;
+
+            std::mutex mutex_;
+            // notified whenever a job has been finished
+            std::condition_variable job_finished_;
+            std::deque<std::unique_ptr<job_>> queue_;
+            // jobs submitted but not finished yet, whether queued or running
+            size_t unfinished_jobs_ = 0;
+            bool stopping_ = false;
+            // first error of a job submitted with a callback, or of a callback itself, rethrown by wait()
+            std::exception_ptr error_;
+            // set if the event loop has failed, all unfinished jobs are failed with it
+            std::exception_ptr event_loop_error_;
+
+            // self-pipe used to wake up the event loop when jobs are submitted
+            int wake_up_fds_[2] = {-1, -1};
+
+            std::thread event_loop_;
+
+            void enqueue_(std::unique_ptr<job_> job);
+
+            void wake_up_event_loop_();
+
+            // hands out the result or error of a job with deliver, and marks it as finished
+            void finish_job_(const std::function<void()>& deliver);
+
+            void run_event_loop_();
+
+            // starts queued jobs and handles the events of the running ones until the pool is destroyed
+            // throws if the events cannot be waited for anymore
+            void process_events_(std::vector<std::unique_ptr<running_job_>>& running_jobs);
+
+            // hands out error to all running and queued jobs, used when the event loop has failed
+            void fail_all_jobs_(std::vector<std::unique_ptr<running_job_>>& running_jobs, const std::exception_ptr& error);
+
+        public:
+            /**
+             * Create pool and start its event loop.
+             * @param max_concurrency maximum number of processes running at the same time, 0 means the number of
+             *     CPU cores
+             */
+            explicit subprocess_pool(size_t max_concurrency = 0);
+
+            subprocess_pool(const subprocess_pool&) = delete;
+
+            subprocess_pool& operator=(const subprocess_pool&) = delete;
+
+            /**
+             * Waits for all submitted commands to finish. Errors not fetched with wait() are dropped.
+             */
+            ~subprocess_pool();
+
+            /**
+             * @return maximum number of processes running at the same time
+             */
+            size_t max_concurrency() const;
+
+            /**
+             * Run command once a slot is free.
+             * @param args parameters for process
+             * @param env additional environment variables (current environment will be copied)
+             * @return future providing the result, or the exception thrown while running the command
+             */
+            std::future<subprocess_result> submit(std::vector<std::string> args, subprocess_env_map_t env = {});
+
+            /**
+             * Run command once a slot is free, and call callback with the result.
+             * The callback is called from the event loop thread, so it should not take long, and must not wait for
+             * other commands to finish. Exceptions thrown while running the command or by the callback are rethrown by
+             * wait().
+             * @param args parameters for process
+             * @param env additional environment variables (current environment will be copied)
+             * @param callback function to call with the result
+             */
+            void submit(std::vector<std::string> args, subprocess_env_map_t env, callback_t callback);
+
+            /**
+             * Wait until all commands submitted so far have finished.
+             * Rethrows the first exception of the commands submitted with a callback since the last call, if any.
+             */
+            void wait();
+        };
+    }
+}
@@ -6,10 +6,27 @@
 #include <utility>
 #include <vector>
 
+// library headers
+#include <boost/utility/string_view.hpp>
+
 namespace linuxdeploy {
     namespace subprocess {
         typedef std::vector<std::string::value_type> subprocess_result_buffer_t;
 
+        /**
+         * Resources used by a child process, as reported by wait4().
+         */
+        struct subprocess_resource_usage {
+            // filename of the executable, without the directory
+            std::string executable;
+            // time from spawning the process until it was reaped
+            double wall_time_seconds = 0;
+            double user_time_seconds = 0;
+            double system_time_seconds = 0;
+            // maximum resident set size
+            long max_rss_kib = 0;
+        };
+
         /**
          * Result of subprocess execution. Follows Value Object design pattern.
          */
@@ -18,20 +35,38 @@ namespace linuxdeploy {
             int exit_code_;
             subprocess_result_buffer_t stdout_contents_;
             subprocess_result_buffer_t stderr_contents_;
+            subprocess_resource_usage resource_usage_;
 
         public:
             subprocess_result(int exit_code, subprocess_result_buffer_t stdout_contents,
-                              subprocess_result_buffer_t stderr_contents);
+                              subprocess_result_buffer_t stderr_contents,
+                              subprocess_resource_usage resource_usage = {});
 
             int exit_code() const;
 
+            /**
+             * @return resources used by the process, all zero if it could not be spawned
+             */
+            const subprocess_resource_usage& resource_usage() const;
+
             const subprocess_result_buffer_t& stdout_contents() const;
 
             std::string stdout_string() const;
 
+            /**
+             * @return view of the stdout contents without the terminating null character, valid as long as this
+             *     object, for reading the output without copying it
+             */
+            boost::string_view stdout_view() const;
+
             const subprocess_result_buffer_t& stderr_contents() const;
 
             std::string stderr_string() const;
+
+            /**
+             * @return view of the stderr contents without the terminating null character, see stdout_view()
+             */
+            boost::string_view stderr_view() const;
         };
     }
 }
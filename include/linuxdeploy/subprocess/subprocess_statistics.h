@@ -0,0 +1,73 @@
+#pragma once
+
+// system headers
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// local headers
+#include "subprocess_result.h"
+
+namespace linuxdeploy {
+    namespace subprocess {
+        /**
+         * Resources used by all the child processes running the same executable.
+         */
+        struct subprocess_statistics_entry {
+            std::string executable;
+            size_t processes_count = 0;
+            double wall_time_seconds = 0;
+            double user_time_seconds = 0;
+            double system_time_seconds = 0;
+            // maximum of the single processes' maximum resident set sizes
+            long max_rss_kib = 0;
+        };
+
+        /**
+         * Process-wide record of the resources used by child processes, aggregated per executable.
+         * Every child process is recorded automatically once it has been reaped, which allows finding out which of the
+         * external tools take the most time.
+         */
+        class subprocess_statistics {
+        private:
+            mutable std::mutex mutex_;
+            std::map<std::string, subprocess_statistics_entry> entries_;
+
+            subprocess_statistics() = default;
+
+        public:
+            subprocess_statistics(const subprocess_statistics&) = delete;
+
+            subprocess_statistics& operator=(const subprocess_statistics&) = delete;
+
+            static subprocess_statistics& instance();
+
+            /**
+             * Add resources used by a child process.
+             */
+            void record(const subprocess_resource_usage& resource_usage);
+
+            /**
+             * Drop all records.
+             */
+            void clear();
+
+            /**
+             * @return one entry per executable, sorted by the wall time spent in its processes, in descending order
+             */
+            std::vector<subprocess_statistics_entry> entries() const;
+
+            /**
+             * @return human readable table of entries(), empty if no child processes have been recorded
+             */
+            std::string summary() const;
+
+            /**
+             * @return entries() as JSON array of objects, using the same keys as the struct members
+             */
+            std::string to_json() const;
+        };
+    }
+}
@@ -0,0 +1,252 @@
+#pragma once
+
+// system headers
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace linuxdeploy {
+    namespace util {
+        namespace thread_pool {
+            /**
+             * Fixed-size work-stealing thread pool.
+             *
+             * Every worker has its own task queue. Workers process their own queues in LIFO order, and steal from the
+             * other queues in FIFO order when they run out of work. Threads waiting for a group of tasks in run() take
+             * part in the processing, therefore tasks can submit and wait for further tasks without running into a
+             * deadlock.
+             */
+            class ThreadPool {
+            private:
+                typedef std::function<void()> task_t;
+
+                struct TaskQueue {
+                    std::mutex mutex;
+                    std::deque<task_t> tasks;
+                };
+
+                // state of a single call to run()
+                struct TaskGroup {
+                    std::mutex mutex;
+                    size_t pendingTasks = 0;
+                    std::exception_ptr error;
+                };
+
+                // the last queue is shared by all threads which are not workers of this pool
+                std::vector<std::unique_ptr<TaskQueue>> _queues;
+                std::vector<std::thread> _workers;
+
+                // used to put idle threads to sleep
+                std::mutex _mutex;
+                std::condition_variable _condition;
+                size_t _queuedTasks = 0;
+                bool _stopping = false;
+
+                // the pool and queue index of the current thread, if it is a worker
+                struct WorkerInfo {
+                    const ThreadPool* pool;
+                    size_t index;
+                };
+
+                static WorkerInfo& currentWorker() {
+                    static thread_local WorkerInfo info{nullptr, 0};
+                    return info;
+                }
+
+                size_t ownQueueIndex() const {
+                    const auto& info = currentWorker();
+
+                    if (info.pool == this)
+                        return info.index;
+
+                    return _queues.size() - 1;
+                }
+
+                void push(task_t task) {
+                    {
+                        auto& queue = *_queues[ownQueueIndex()];
+                        std::lock_guard<std::mutex> lock(queue.mutex);
+                        queue.tasks.emplace_back(std::move(task));
+                    }
+
+                    {
+                        std::lock_guard<std::mutex> lock(_mutex);
+                        ++_queuedTasks;
+                    }
+
+                    _condition.notify_all();
+                }
+
+                bool pop(task_t& task) {
+                    const auto ownIndex = ownQueueIndex();
+
+                    // newest task of the own queue first, it's likely to use data still in the cache
+                    {
+                        auto& queue = *_queues[ownIndex];
+                        std::lock_guard<std::mutex> lock(queue.mutex);
+
+                        if (!queue.tasks.empty()) {
+                            task = std::move(queue.tasks.back());
+                            queue.tasks.pop_back();
+                            return true;
+                        }
+                    }
+
+                    // steal the oldest task from one of the other queues
+                    for (size_t offset = 1; offset < _queues.size(); ++offset) {
+                        auto& queue = *_queues[(ownIndex + offset) % _queues.size()];
+                        std::lock_guard<std::mutex> lock(queue.mutex);
+
+                        if (!queue.tasks.empty()) {
+                            task = std::move(queue.tasks.front());
+                            queue.tasks.pop_front();
+                            return true;
+                        }
+                    }
+
+                    return false;
+                }
+
+                // runs a single queued task, returns false if there was none
+                bool runQueuedTask() {
+                    task_t task;
+
+                    if (!pop(task))
+                        return false;
+
+                    {
+                        std::lock_guard<std::mutex> lock(_mutex);
+                        --_queuedTasks;
+                    }
+
+                    task();
+                    return true;
+                }
+
+                void workerLoop(size_t index) {
+                    currentWorker() = WorkerInfo{this, index};
+
+                    for (;;) {
+                        if (runQueuedTask())
+                            continue;
+
+                        std::unique_lock<std::mutex> lock(_mutex);
+                        _condition.wait(lock, [this]() { return _stopping || _queuedTasks > 0; });
+
+                        if (_stopping)
+                            return;
+                    }
+                }
+
+            public:
+                /**
+                 * Create pool.
+                 * The thread calling run() takes part in processing the tasks, therefore jobs - 1 worker threads are
+                 * started.
+                 * @param jobs maximum number of tasks to run in parallel, 0 means defaultConcurrency()
+                 */
+                explicit ThreadPool(unsigned int jobs = 0) {
+                    if (jobs == 0)
+                        jobs = defaultConcurrency();
+
+                    for (unsigned int i = 0; i < jobs; ++i)
+                        _queues.emplace_back(new TaskQueue);
+
+                    for (unsigned int i = 0; i + 1 < jobs; ++i)
+                        _workers.emplace_back(&ThreadPool::workerLoop, this, i);
+                }
+
+                ~ThreadPool() {
+                    {
+                        std::lock_guard<std::mutex> lock(_mutex);
+                        _stopping = true;
+                    }
+
+                    _condition.notify_all();
+
+                    for (auto& worker : _workers)
+                        worker.join();
+                }
+
+                ThreadPool(const ThreadPool&) = delete;
+                ThreadPool& operator=(const ThreadPool&) = delete;
+
+                /**
+                 * @return number of CPU cores, or 1 if that cannot be determined
+                 */
+                static unsigned int defaultConcurrency() {
+                    const auto concurrency = std::thread::hardware_concurrency();
+                    return concurrency > 0 ? concurrency : 1;
+                }
+
+                /**
+                 * @return maximum number of tasks run in parallel
+                 */
+                size_t jobs() const {
+                    return _workers.size() + 1;
+                }
+
+                /**
+                 * Run tasks in the pool and wait for all of them to finish.
+                 * The calling thread processes queued tasks while waiting. May be called from within tasks.
+                 * If any of the tasks throws an exception, the first one is rethrown once all tasks have finished.
+                 * @param tasks tasks to run
+                 */
+                void run(const std::vector<task_t>& tasks) {
+                    if (tasks.empty())
+                        return;
+
+                    auto group = std::make_shared<TaskGroup>();
+                    group->pendingTasks = tasks.size();
+
+                    for (const auto& task : tasks) {
+                        push([this, group, task]() {
+                            try {
+                                task();
+                            } catch (...) {
+                                std::lock_guard<std::mutex> lock(group->mutex);
+                                if (!group->error)
+                                    group->error = std::current_exception();
+                            }
+
+                            bool groupFinished;
+
+                            {
+                                std::lock_guard<std::mutex> lock(group->mutex);
+                                groupFinished = --group->pendingTasks == 0;
+                            }
+
+                            // wake up the thread waiting for the group
+                            if (groupFinished) {
+                                std::lock_guard<std::mutex> lock(_mutex);
+                                _condition.notify_all();
+                            }
+                        });
+                    }
+
+                    auto isGroupFinished = [&group]() {
+                        std::lock_guard<std::mutex> lock(group->mutex);
+                        return group->pendingTasks == 0;
+                    };
+
+                    while (!isGroupFinished()) {
+                        if (runQueuedTask())
+                            continue;
+
+                        // the remaining tasks are running in other threads
+                        std::unique_lock<std::mutex> lock(_mutex);
+                        _condition.wait(lock, [this, &isGroupFinished]() { return _queuedTasks > 0 || isGroupFinished(); });
+                    }
+
+                    if (group->error)
+                        std::rethrow_exception(group->error);
+                }
+            };
+        }
+    }
+}
@@ -1,26 +1,36 @@
 // system headers
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <condition_variable>
+#include <fstream>
+#include <functional>
+#include <iterator>
 #include <set>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // library headers
 #include <boost/filesystem.hpp>
 #include <CImg.h>
-#include <fnmatch.h>
 
 
 // local headers
 #include "linuxdeploy/core/appdir.h"
+#include "linuxdeploy/core/copy_engine.h"
 #include "linuxdeploy/core/elf_file.h"
+#include "linuxdeploy/core/excludelist_matcher.h"
 #include "linuxdeploy/core/log.h"
 #include "linuxdeploy/desktopfile/desktopfileentry.h"
 #include "linuxdeploy/util/util.h"
 #include "linuxdeploy/subprocess/subprocess.h"
 #include "copyright.h"
-
-// auto-generated headers
-#include "excludelist.h"
 #include "appdir_root_setup.h"
 
 using namespace linuxdeploy::core;
@@ -90,6 +100,425 @@ namespace {
             _storedOperations.clear();
         }
     };
+
+    /**
+     * Stages a deployed file has to go through once it has been registered, i.e., copying it, stripping it and setting
+     * its rpath, in this order.
+     * Messages are collected rather than logged, so that the pipelines of multiple files can be run in parallel, and
+     * the log can be printed in a deterministic order.
+     */
+    class FilePipeline {
+    public:
+        // path of the file in the AppDir
+        bf::path path;
+
+        bool copy = false;
+        bf::path fromPath;
+        bf::perms addedPermissions = bf::no_perms;
+
+        bool strip = false;
+
+        bool setRPath = false;
+        std::string rpath;
+
+        std::vector<std::pair<LD_LOGLEVEL, std::string>> messages;
+        bool success = true;
+
+        void log(LD_LOGLEVEL level, const std::string& message) {
+            messages.emplace_back(level, message);
+        }
+
+        void fail(const std::string& message) {
+            log(LD_ERROR, message);
+            success = false;
+        }
+    };
+
+    /**
+     * Records which ELF files' dependencies have been traced during a run.
+     * The resolvers return the transitive closure of a file's dependencies, i.e., the dependencies of every file in the
+     * closure are part of the closure, too. Once a closure has been deployed, none of its members need to be traced
+     * again.
+     */
+    class DependencyGraph {
+    private:
+        // canonical paths of the files handed to the resolver
+        // the closures themselves are not needed once they have been deployed, so they aren't kept
+        std::set<bf::path> _resolvedFiles;
+
+        // canonical paths of all files whose dependencies are known, i.e., the traced files and the members of their
+        // closures
+        std::set<bf::path> _tracedFiles;
+
+        static bf::path canonicalPath(const bf::path& path) {
+            boost::system::error_code ec;
+            auto canonicalPath = bf::canonical(path, ec);
+
+            if (ec)
+                return path;
+
+            return canonicalPath;
+        }
+
+    public:
+        DependencyGraph() = default;
+
+        /**
+         * Check whether a file's dependencies are known already.
+         * @param path path to ELF file
+         * @return true if the file has been traced or is part of a recorded closure, false otherwise
+         */
+        bool hasBeenTraced(const bf::path& path) const {
+            return _tracedFiles.find(canonicalPath(path)) != _tracedFiles.end();
+        }
+
+        /**
+         * Mark a file and all members of its closure as traced.
+         * @param path path to traced ELF file
+         * @param closure dependencies returned by the resolver
+         */
+        void addClosure(const bf::path& path, const std::vector<bf::path>& closure) {
+            const auto tracedFile = canonicalPath(path);
+
+            _resolvedFiles.insert(tracedFile);
+            _tracedFiles.insert(tracedFile);
+
+            for (const auto& dependency : closure)
+                _tracedFiles.insert(canonicalPath(dependency));
+        }
+
+        /**
+         * @return number of files handed to the resolver
+         */
+        size_t closuresCount() const {
+            return _resolvedFiles.size();
+        }
+
+        /**
+         * @return number of files whose dependencies are known
+         */
+        size_t tracedFilesCount() const {
+            return _tracedFiles.size();
+        }
+    };
+
+    /**
+     * A file visited while deploying, along with all the paths it has been visited by.
+     */
+    class VisitedFile {
+    public:
+        // the path the file has been visited by first comes first
+        std::vector<bf::path> paths;
+
+        // location the file has been deployed to as a shared library, empty if it hasn't been deployed as one
+        bf::path libraryDestination;
+
+        bool hasPath(const bf::path& path) const {
+            return std::find(paths.begin(), paths.end(), path) != paths.end();
+        }
+    };
+
+    /**
+     * Set of visited files which can be shared between threads.
+     * Files are identified by device and inode rather than by path, therefore all the paths referring to the same file,
+     * e.g., symlinks or the directories merged on merged-/usr systems, are recorded as aliases of a single entry. The
+     * entries are stored in an open addressing hash table with linear probing.
+     * Paths which cannot be resolved, e.g., because the file doesn't exist (yet), are recorded by path.
+     */
+    class VisitedFileSet {
+    private:
+        class Slot {
+        public:
+            dev_t device;
+            ino_t inode;
+            // index of the file plus one, 0 for empty slots
+            size_t fileIndex;
+        };
+
+        mutable std::mutex _mutex;
+        std::vector<Slot> _slots;
+        std::vector<VisitedFile> _files;
+        std::set<bf::path> _unresolvedPaths;
+
+        static size_t hash(dev_t device, ino_t inode) {
+            uint64_t hash = static_cast<uint64_t>(inode) ^ (static_cast<uint64_t>(device) * 0x9e3779b97f4a7c15ULL);
+            hash ^= hash >> 33;
+            hash *= 0xff51afd7ed558ccdULL;
+            hash ^= hash >> 33;
+            return static_cast<size_t>(hash);
+        }
+
+        // returns the slot the file is stored in, or the empty slot it would have to be stored in
+        size_t findSlot(dev_t device, ino_t inode) const {
+            const auto mask = _slots.size() - 1;
+
+            for (auto index = hash(device, inode) & mask;; index = (index + 1) & mask) {
+                const auto& slot = _slots[index];
+
+                if (slot.fileIndex == 0 || (slot.device == device && slot.inode == inode))
+                    return index;
+            }
+        }
+
+        void grow() {
+            std::vector<Slot> oldSlots(_slots.empty() ? 64 : _slots.size() * 2, Slot{0, 0, 0});
+            _slots.swap(oldSlots);
+
+            for (const auto& slot : oldSlots) {
+                if (slot.fileIndex != 0)
+                    _slots[findSlot(slot.device, slot.inode)] = slot;
+            }
+        }
+
+        // returns the visited file, or nullptr if the path cannot be resolved or the file has not been visited
+        const VisitedFile* find(const struct stat& st) const {
+            if (_slots.empty())
+                return nullptr;
+
+            const auto& slot = _slots[findSlot(st.st_dev, st.st_ino)];
+
+            if (slot.fileIndex == 0)
+                return nullptr;
+
+            return &_files[slot.fileIndex - 1];
+        }
+
+    public:
+        VisitedFileSet() = default;
+
+        /**
+         * Add path to set. If another path referring to the same file has been added already, the path is recorded
+         * as an alias of the file.
+         * @param path path to add
+         * @param libraryDestination location the file is deployed to as a shared library, if any
+         * @return true if the file has been added, false if it was contained in the set already
+         */
+        bool insert(const bf::path& path, const bf::path& libraryDestination = bf::path()) {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            struct stat st{};
+
+            if (stat(path.c_str(), &st) != 0)
+                return _unresolvedPaths.insert(path).second;
+
+            // keep the load factor below 0.5
+            if (2 * (_files.size() + 1) > _slots.size())
+                grow();
+
+            auto& slot = _slots[findSlot(st.st_dev, st.st_ino)];
+
+            if (slot.fileIndex == 0) {
+                slot = Slot{st.st_dev, st.st_ino, _files.size() + 1};
+
+                VisitedFile file;
+                file.paths.emplace_back(path);
+                file.libraryDestination = libraryDestination;
+                _files.emplace_back(std::move(file));
+
+                return true;
+            }
+
+            auto& file = _files[slot.fileIndex - 1];
+
+            if (!file.hasPath(path))
+                file.paths.emplace_back(path);
+
+            if (file.libraryDestination.empty())
+                file.libraryDestination = libraryDestination;
+
+            return false;
+        }
+
+        /**
+         * @param path path to look up
+         * @return true if the path itself has been added to the set, false otherwise
+         */
+        bool containsPath(const bf::path& path) const {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            struct stat st{};
+
+            if (stat(path.c_str(), &st) != 0)
+                return _unresolvedPaths.find(path) != _unresolvedPaths.end();
+
+            const auto* file = find(st);
+            return file != nullptr && file->hasPath(path);
+        }
+
+        /**
+         * Look up the file a path refers to, regardless of the path it has been added by.
+         * @param path path to look up
+         * @param file set to the visited file if it is found
+         * @return true if the file has been visited, false otherwise
+         */
+        bool findFile(const bf::path& path, VisitedFile& file) const {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            struct stat st{};
+
+            if (stat(path.c_str(), &st) != 0)
+                return false;
+
+            const auto* visitedFile = find(st);
+
+            if (visitedFile == nullptr)
+                return false;
+
+            file = *visitedFile;
+            return true;
+        }
+
+        /**
+         * @return visited files which have been referred to by more than one path
+         */
+        std::vector<VisitedFile> filesWithAliases() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            std::vector<VisitedFile> files;
+
+            std::copy_if(_files.begin(), _files.end(), std::back_inserter(files), [](const VisitedFile& file) {
+                return file.paths.size() > 1;
+            });
+
+            return files;
+        }
+
+        /**
+         * @return number of visited files
+         */
+        size_t size() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _files.size() + _unresolvedPaths.size();
+        }
+    };
+
+    /**
+     * Limits the number of threads which execute a section at the same time, e.g., to limit the number of running
+     * processes independently of the number of threads.
+     * Meets the requirements of std::lock_guard.
+     */
+    class ConcurrencyLimit {
+    private:
+        std::mutex _mutex;
+        std::condition_variable _released;
+        size_t _available;
+
+    public:
+        /**
+         * @param limit maximum number of threads in the section, must be at least 1
+         */
+        explicit ConcurrencyLimit(size_t limit) : _available(limit) {}
+
+        /**
+         * Enter section, waits until another thread has left it if the limit has been reached.
+         */
+        void lock() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _released.wait(lock, [this]() { return _available > 0; });
+            --_available;
+        }
+
+        /**
+         * Leave section.
+         */
+        void unlock() {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                ++_available;
+            }
+
+            _released.notify_one();
+        }
+    };
+
+    /**
+     * A regular file in the AppDir which might have the same contents as another one.
+     */
+    class DeduplicationCandidate {
+    public:
+        bf::path path;
+        uint64_t size = 0;
+        mode_t mode = 0;
+        dev_t device = 0;
+        ino_t inode = 0;
+
+        // set by hashFileContents()
+        bool hashed = false;
+        uint64_t hash = 0;
+        bool isElfFile = false;
+    };
+
+    /**
+     * Hash the contents of a file.
+     * Files with the same hash are compared byte by byte before they're deduplicated, therefore a fast
+     * non-cryptographic hash is sufficient.
+     * @param candidate file to hash, hashed is only set if the file could be read
+     */
+    void hashFileContents(DeduplicationCandidate& candidate) {
+        std::ifstream ifs(candidate.path.string(), std::ios::binary);
+
+        if (!ifs)
+            return;
+
+        std::vector<char> buffer(64 * 1024);
+
+        uint64_t hash = 14695981039346656037ULL;
+        bool firstChunk = true;
+
+        while (ifs) {
+            ifs.read(buffer.data(), buffer.size());
+            const auto count = static_cast<size_t>(ifs.gcount());
+
+            if (firstChunk) {
+                candidate.isElfFile = count >= 4 && memcmp(buffer.data(), "\x7f" "ELF", 4) == 0;
+                firstChunk = false;
+            }
+
+            size_t offset = 0;
+
+            // the data is mixed in word by word, which is a lot faster than processing single bytes
+            for (; offset + sizeof(uint64_t) <= count; offset += sizeof(uint64_t)) {
+                uint64_t word;
+                memcpy(&word, buffer.data() + offset, sizeof(word));
+
+                hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+                hash = (hash << 31) | (hash >> 33);
+            }
+
+            for (; offset < count; ++offset)
+                hash = (hash ^ static_cast<unsigned char>(buffer[offset])) * 1099511628211ULL;
+        }
+
+        if (ifs.bad())
+            return;
+
+        candidate.hash = hash;
+        candidate.hashed = true;
+    }
+
+    /**
+     * @return true if both files could be read and have the same contents
+     */
+    bool haveSameContents(const bf::path& path, const bf::path& otherPath) {
+        std::ifstream ifs(path.string(), std::ios::binary);
+        std::ifstream otherIfs(otherPath.string(), std::ios::binary);
+
+        if (!ifs || !otherIfs)
+            return false;
+
+        std::vector<char> buffer(64 * 1024);
+        std::vector<char> otherBuffer(buffer.size());
+
+        while (ifs && otherIfs) {
+            ifs.read(buffer.data(), buffer.size());
+            otherIfs.read(otherBuffer.data(), otherBuffer.size());
+
+            if (ifs.gcount() != otherIfs.gcount() || memcmp(buffer.data(), otherBuffer.data(), ifs.gcount()) != 0)
+                return false;
+        }
+
+        return !ifs.bad() && !otherIfs.bad() && ifs.eof() && otherIfs.eof();
+    }
 }
 
 namespace linuxdeploy {
@@ -104,12 +533,18 @@ namespace linuxdeploy {
                     CopyOperationsStorage copyOperationsStorage;
                     std::set<bf::path> stripOperations;
                     std::map<bf::path, std::string> setElfRPathOperations;
+                    // symlinks to create in the AppDir once the files have been copied, symlink -> target
+                    std::map<bf::path, bf::path> symlinkOperations;
 
                     // stores all files that have been visited by the deploy functions, e.g., when they're blacklisted,
                     // have been added to the deferred operations already, etc.
                     // lookups in a single container are a lot faster than having to look up in several ones, therefore
                     // the little amount of additional memory is worth it, considering the improved performance
-                    std::set<bf::path> visitedFiles;
+                    // the set may be shared with the threads tracing dependencies
+                    VisitedFileSet visitedFiles;
+
+                    // dependencies of the ELF files traced so far, used to avoid tracing the same files over and over
+                    DependencyGraph dependencyGraph;
 
                     // used to automatically rename resources to improve the UX, e.g. icons
                     std::string appName;
@@ -120,6 +555,19 @@ namespace linuxdeploy {
                     // decides whether copyright files deployment is performed
                     bool disableCopyrightFilesDeployment = false;
 
+                    // maximum number of parallel jobs, 0 means number of CPU cores
+                    unsigned int jobs = 0;
+
+                    // created on first use
+                    std::shared_ptr<util::thread_pool::ThreadPool> threadPool;
+
+                    // maximum number of files copied in parallel, 0 means the number of jobs
+                    unsigned int copyQueueDepth = 0;
+
+                    // entries of the excludelist files passed by the user, and the matcher compiled from them
+                    std::vector<std::string> userExcludelistEntries;
+                    std::shared_ptr<excludelist_matcher::ExcludelistMatcher> userExcludelist;
+
                 public:
                 PrivateData() : copyOperationsStorage(), stripOperations(), setElfRPathOperations(), visitedFiles(), appDirPath() {
                         copyrightFilesManager = copyright::ICopyrightFilesManager::getInstance();
@@ -143,6 +591,40 @@ namespace linuxdeploy {
                          return libDirName;
                     }
 
+                    // create the parent directory of a copy's destination and calculate the actual destination path
+                    // mimics cp command behavior
+                    // throws bf::filesystem_error on failure
+                    static bool prepareCopy(const bf::path& from, bf::path& to) {
+                        if (!to.parent_path().empty() && !bf::is_directory(to.parent_path()) && !bf::create_directories(to.parent_path())) {
+                            ldLog() << LD_ERROR << "Failed to create parent directory" << to.parent_path() << "for path" << to << std::endl;
+                            return false;
+                        }
+
+                        if (*(to.string().end() - 1) == '/' || bf::is_directory(to))
+                            to /= from.filename();
+
+                        return true;
+                    }
+
+                    // copy file to the destination calculated by prepareCopy()
+                    // does not log anything, therefore it can be called from multiple threads
+                    // returns an error message, or an empty string on success
+                    static std::string copyToDestination(const bf::path& from, const bf::path& to, bf::perms addedPerms) {
+                        try {
+                            // adding permissions to a hardlink would change the source file's permissions
+                            const auto allowHardlink = (bf::status(from).permissions() & addedPerms) == addedPerms;
+
+                            if (copy_engine::copyFile(from, to, allowHardlink) != copy_engine::COPY_METHOD_HARDLINK)
+                                bf::permissions(to, addedPerms | bf::add_perms);
+                        } catch (const bf::filesystem_error& e) {
+                            return e.what();
+                        } catch (const copy_engine::CopyError& e) {
+                            return e.what();
+                        }
+
+                        return {};
+                    }
+
                     // actually copy file
                     // mimics cp command behavior
                     // also adds minimum file permissions (by default adds 0644 to existing permissions)
@@ -150,26 +632,25 @@ namespace linuxdeploy {
                         ldLog() << "Copying file" << from << "to" << to << std::endl;
 
                         try {
-                            if (!to.parent_path().empty() && !bf::is_directory(to.parent_path()) && !bf::create_directories(to.parent_path())) {
-                                ldLog() << LD_ERROR << "Failed to create parent directory" << to.parent_path() << "for path" << to << std::endl;
+                            if (!prepareCopy(from, to))
                                 return false;
-                            }
-
-                            if (*(to.string().end() - 1) == '/' || bf::is_directory(to))
-                                to /= from.filename();
 
                             if (!overwrite && bf::exists(to)) {
                                 ldLog() << LD_DEBUG << "File exists, skipping:" << to << std::endl;
                                 return true;
                             }
-
-                            bf::copy_file(from, to, bf::copy_option::overwrite_if_exists);
-                            bf::permissions(to, addedPerms | bf::add_perms);
                         } catch (const bf::filesystem_error& e) {
                             ldLog() << LD_ERROR << "Failed to copy file" << from << "to" << to << LD_NO_SPACE << ":" << e.what() << std::endl;
                             return false;
                         }
 
+                        const auto error = copyToDestination(from, to, addedPerms);
+
+                        if (!error.empty()) {
+                            ldLog() << LD_ERROR << "Failed to copy file" << from << "to" << to << LD_NO_SPACE << ":" << error << std::endl;
+                            return false;
+                        }
+
                         return true;
                     }
 
@@ -216,88 +697,539 @@ namespace linuxdeploy {
                     }
 
                     bool hasBeenVisitedAlready(const bf::path& path) {
-                        return visitedFiles.find(path) != visitedFiles.end();
+                        return visitedFiles.containsPath(path);
+                    }
+
+                    // copy file, strip it and prepare setting its rpath, skipping the stages which don't apply to it
+                    // does not log anything, the messages are collected in the pipeline, therefore it can be called
+                    // for multiple files in parallel
+                    // strip is called with stripLimit held, which limits the number of strip processes
+                    static void runFilePipeline(FilePipeline& pipeline, ConcurrencyLimit& stripLimit) {
+                        const auto& filePath = pipeline.path;
+
+                        auto strip = pipeline.strip;
+
+                        // the original rpath is checked, as the file is stripped before its rpath is set
+                        if (strip && util::stringStartsWith(elf_file::ElfFile(pipeline.copy ? pipeline.fromPath : filePath).getRPath(), "$")) {
+                            pipeline.log(LD_WARNING, "Not calling strip on binary " + filePath.string() + ": rpath starts with $");
+                            strip = false;
+                        }
+
+                        if (pipeline.copy) {
+                            // the native stripper writes the stripped copy right away, rather than copying the file and
+                            // stripping the copy afterwards
+                            if (strip && elf_file::ElfFile::getStripper() == elf_file::NATIVE_STRIPPER) {
+                                pipeline.log(LD_INFO, "Calling strip on library " + filePath.string());
+
+                                std::lock_guard<ConcurrencyLimit> lock(stripLimit);
+
+                                if (!elf_file::ElfFile(pipeline.fromPath).strip(filePath)) {
+                                    pipeline.fail("Failed to strip file " + pipeline.fromPath.string() + " to " + filePath.string());
+                                    return;
+                                }
+
+                                try {
+                                    bf::permissions(filePath, pipeline.addedPermissions | bf::add_perms);
+                                } catch (const bf::filesystem_error& e) {
+                                    pipeline.fail("Failed to set permissions of file " + filePath.string() + ": " + e.what());
+                                    return;
+                                }
+
+                                strip = false;
+                            } else {
+                                const auto error = copyToDestination(pipeline.fromPath, filePath, pipeline.addedPermissions);
+
+                                if (!error.empty()) {
+                                    pipeline.fail("Failed to copy file " + pipeline.fromPath.string() + " to " + filePath.string() + ": " + error);
+                                    return;
+                                }
+                            }
+                        }
+
+                        // files are modified in place, which must not affect the files they might be hardlinked to,
+                        // e.g., when the AppDir has been created in hardlink mode
+                        auto breakHardlink = [&pipeline, &filePath]() {
+                            try {
+                                copy_engine::breakHardlink(filePath);
+                            } catch (const copy_engine::CopyError& e) {
+                                pipeline.fail(e.what());
+                                return false;
+                            }
+
+                            return true;
+                        };
+
+                        if (strip) {
+                            if (!breakHardlink())
+                                return;
+
+                            pipeline.log(LD_INFO, "Calling strip on library " + filePath.string());
+
+                            std::lock_guard<ConcurrencyLimit> lock(stripLimit);
+
+                            if (!elf_file::ElfFile(filePath).strip(filePath)) {
+                                pipeline.fail("Failed to strip file: " + filePath.string());
+                                return;
+                            }
+                        }
+
+                        if (pipeline.setRPath) {
+                            elf_file::ElfFile elfFile(filePath);
+
+                            // no need to set rpath in debug symbols files
+                            // also, patchelf crashes on such symbols
+                            if (isInDebugSymbolsLocation(filePath) || elfFile.isDebugSymbolsFile()) {
+                                pipeline.log(LD_WARNING, "Not setting rpath in debug symbols file: " + filePath.string());
+                                pipeline.setRPath = false;
+                            } else if (!elfFile.isDynamicallyLinked()) {
+                                pipeline.log(LD_WARNING, "Not setting rpath in statically-linked file:  " + filePath.string());
+                                pipeline.setRPath = false;
+                            } else if (breakHardlink()) {
+                                // the rpath is set by runFilePipelines(), which edits the files in batches
+                                pipeline.log(LD_INFO, "Setting rpath in ELF file " + filePath.string() + " to " + pipeline.rpath);
+                            }
+                        }
+                    }
+
+                    // set the rpaths of the files whose pipelines have completed all the other stages
+                    // if patchelf has to be used, the files are grouped by their rpaths, which saves a lot of calls, as
+                    // most of the files share a few values, e.g., $ORIGIN
+                    void setRPaths(std::vector<FilePipeline>& pipelines) {
+                        std::map<bf::path, std::string> rpaths;
+                        std::map<bf::path, FilePipeline*> pipelinesByPath;
+
+                        for (auto& pipeline : pipelines) {
+                            if (!pipeline.success || !pipeline.setRPath)
+                                continue;
+
+                            rpaths[pipeline.path] = pipeline.rpath;
+                            pipelinesByPath[pipeline.path] = &pipeline;
+                        }
+
+                        if (rpaths.empty())
+                            return;
+
+                        std::map<bf::path, elf_file::FileMessages> messages;
+                        const auto errors = elf_file::ElfFile::setRPaths(rpaths, getThreadPool(), &messages);
+
+                        for (const auto& fileMessages : messages) {
+                            auto& pipeline = *pipelinesByPath.at(fileMessages.first);
+
+                            for (const auto& message : fileMessages.second)
+                                pipeline.log(message.first, message.second);
+                        }
+
+                        for (const auto& error : errors)
+                            pipelinesByPath.at(error.first)->fail("Failed to set rpath in ELF file " + error.first.string() + ": " + error.second);
+                    }
+
+                    // run pipelines in parallel, set the rpaths of the files, then print the pipelines' messages in order
+                    bool runFilePipelines(std::vector<FilePipeline>& pipelines) {
+                        // a separate pool is used if the number of files processed in parallel has been configured
+                        std::unique_ptr<util::thread_pool::ThreadPool> pipelinePool;
+
+                        if (copyQueueDepth > 0)
+                            pipelinePool.reset(new util::thread_pool::ThreadPool(copyQueueDepth));
+
+                        auto& pool = pipelinePool != nullptr ? *pipelinePool : getThreadPool();
+
+                        // the pipeline pool might be larger than the number of jobs, as copying files is limited by I/O
+                        // rather than the CPU, which doesn't apply to stripping them
+                        ConcurrencyLimit stripLimit(getThreadPool().jobs());
+
+                        // every worker processes the next pending file until there are none left, which limits the
+                        // number of files in flight to the number of workers
+                        std::atomic<size_t> nextPipeline(0);
+                        std::vector<std::function<void()>> workers(std::min(pool.jobs(), pipelines.size()), [&pipelines, &nextPipeline, &stripLimit]() {
+                            for (auto i = nextPipeline++; i < pipelines.size(); i = nextPipeline++)
+                                runFilePipeline(pipelines[i], stripLimit);
+                        });
+
+                        pool.run(workers);
+
+                        setRPaths(pipelines);
+
+                        std::vector<const FilePipeline*> failedPipelines;
+
+                        for (const auto& pipeline : pipelines) {
+                            for (const auto& message : pipeline.messages)
+                                ldLog() << message.first << message.second << std::endl;
+
+                            if (!pipeline.success)
+                                failedPipelines.emplace_back(&pipeline);
+                        }
+
+                        // all the files have been processed, the failed ones are listed again so they don't get lost in
+                        // the log
+                        if (!failedPipelines.empty()) {
+                            ldLog() << LD_ERROR << "Failed to process" << failedPipelines.size() << "of" << pipelines.size() << "files:" << std::endl;
+
+                            for (const auto* pipeline : failedPipelines)
+                                ldLog() << LD_ERROR << "  " << LD_NO_SPACE << pipeline->path << std::endl;
+
+                            return false;
+                        }
+
+                        return true;
                     }
 
                     // execute deferred copy operations registered with the deploy* functions
+                    // every file runs through its own pipeline, i.e., it is stripped and its rpath is set as soon as it
+                    // has been copied, while other files are still being copied
                     bool executeDeferredOperations() {
                         bool success = true;
 
-                        const auto copyOperations = copyOperationsStorage.getOperations();
-                        std::for_each(copyOperations.begin(), copyOperations.end(), [&success](const CopyOperation& operation) {
-                            if (!copyFile(operation.fromPath, operation.toPath, operation.addedPermissions)) {
+                        // the pipelines of the copied files, and the ones of files which exist in the AppDir already
+                        std::vector<FilePipeline> copiedFilesPipelines;
+                        std::vector<FilePipeline> existingFilesPipelines;
+
+                        std::map<bf::path, size_t> copiedFilesIndices;
+
+                        // the destinations are prepared sequentially, so that the workers don't race creating the same
+                        // directories
+                        for (const auto& operation : copyOperationsStorage.getOperations()) {
+                            FilePipeline pipeline;
+                            pipeline.path = operation.toPath;
+                            pipeline.fromPath = operation.fromPath;
+                            pipeline.addedPermissions = operation.addedPermissions;
+
+                            pipeline.log(LD_INFO, "Copying file " + operation.fromPath.string() + " to " + operation.toPath.string());
+
+                            try {
+                                if (!prepareCopy(operation.fromPath, pipeline.path)) {
+                                    success = false;
+                                    continue;
+                                }
+
+                                const auto normalizedPath = bf::absolute(pipeline.path).lexically_normal();
+
+                                // the file might be copied by another one of the operations, which has to finish
+                                // before it can be processed any further
+                                if (copiedFilesIndices.count(normalizedPath) > 0) {
+                                    copiedFilesPipelines[copiedFilesIndices[normalizedPath]].log(LD_DEBUG, "File exists, skipping: " + pipeline.path.string());
+                                    continue;
+                                }
+
+                                if (bf::exists(pipeline.path)) {
+                                    pipeline.log(LD_DEBUG, "File exists, skipping: " + pipeline.path.string());
+                                } else {
+                                    pipeline.copy = true;
+                                }
+
+                                copiedFilesIndices[normalizedPath] = copiedFilesPipelines.size();
+                            } catch (const bf::filesystem_error& e) {
+                                ldLog() << LD_ERROR << "Failed to copy file" << operation.fromPath << "to" << pipeline.path << LD_NO_SPACE << ":" << e.what() << std::endl;
                                 success = false;
+                                continue;
                             }
-                        });
+
+                            copiedFilesPipelines.emplace_back(std::move(pipeline));
+                        }
+
                         copyOperationsStorage.clear();
 
+                        // nothing may be modified if the files cannot be copied
                         if (!success)
                             return false;
 
+                        std::map<bf::path, size_t> existingFilesIndices;
+
+                        auto getPipeline = [&](const bf::path& path) -> FilePipeline& {
+                            const auto normalizedPath = bf::absolute(path).lexically_normal();
+
+                            const auto it = copiedFilesIndices.find(normalizedPath);
+
+                            if (it != copiedFilesIndices.end())
+                                return copiedFilesPipelines[it->second];
+
+                            const auto existingIt = existingFilesIndices.find(normalizedPath);
+
+                            if (existingIt != existingFilesIndices.end())
+                                return existingFilesPipelines[existingIt->second];
+
+                            FilePipeline pipeline;
+                            pipeline.path = path;
+
+                            existingFilesIndices[normalizedPath] = existingFilesPipelines.size();
+                            existingFilesPipelines.emplace_back(std::move(pipeline));
+                            return existingFilesPipelines.back();
+                        };
+
                         if (getenv("NO_STRIP") != nullptr) {
                             ldLog() << LD_WARNING << "$NO_STRIP environment variable detected, not stripping binaries" << std::endl;
-                            stripOperations.clear();
                         } else {
-                            const auto stripPath = getStripPath();
+                            for (const auto& filePath : stripOperations)
+                                getPipeline(filePath).strip = true;
+                        }
 
-                            while (!stripOperations.empty()) {
-                                const auto& filePath = *(stripOperations.begin());
+                        stripOperations.clear();
 
-                                if (util::stringStartsWith(elf_file::ElfFile(filePath).getRPath(), "$")) {
-                                    ldLog() << LD_WARNING << "Not calling strip on binary" << filePath << LD_NO_SPACE
-                                            << ": rpath starts with $" << std::endl;
-                                } else {
-                                    ldLog() << "Calling strip on library" << filePath << std::endl;
+                        for (const auto& operation : setElfRPathOperations) {
+                            auto& pipeline = getPipeline(operation.first);
+                            pipeline.setRPath = true;
+                            pipeline.rpath = operation.second;
+                        }
 
-                                    subprocess::subprocess_env_map_t env;
-                                    env.insert(std::make_pair(std::string("LC_ALL"), std::string("C")));
+                        setElfRPathOperations.clear();
 
-                                    subprocess::subprocess proc({stripPath, filePath.string()}, env);
+                        // make sure the modes are selected (and the messages are logged) before the workers start
+                        copy_engine::getCopyMode();
+                        elf_file::ElfFile::getStripper();
+                        elf_file::ElfFile::getRPathEditor();
 
-                                    const auto result = proc.run();
-                                    const auto& err = result.stderr_string();
+                        if (!runFilePipelines(copiedFilesPipelines))
+                            success = false;
 
-                                    if (result.exit_code() != 0 &&
-                                        !util::stringContains(err, "Not enough room for program headers")) {
-                                        ldLog() << LD_ERROR << "Strip call failed:" << err << std::endl;
-                                        success = false;
+                        // the existing files are processed once all copies have finished, in case they're referred to
+                        // with paths which differ from the copies' ones
+                        if (!runFilePipelines(existingFilesPipelines))
+                            success = false;
+
+                        for (const auto& operation : symlinkOperations) {
+                            try {
+                                bf::create_directories(operation.first.parent_path());
+                            } catch (const bf::filesystem_error& e) {
+                                ldLog() << LD_ERROR << "Failed to create directory for symlink" << operation.first << LD_NO_SPACE << ":" << e.what() << std::endl;
+                                success = false;
+                                continue;
+                            }
+
+                            if (!symlinkFile(operation.second, operation.first))
+                                success = false;
+                        }
+
+                        symlinkOperations.clear();
+
+                        for (const auto& file : visitedFiles.filesWithAliases()) {
+                            std::string aliases;
+
+                            for (auto it = file.paths.begin() + 1; it != file.paths.end(); ++it)
+                                aliases += " " + it->string();
+
+                            ldLog() << LD_DEBUG << "Visited file" << file.paths.front() << "through other paths as well:" << LD_NO_SPACE << aliases << std::endl;
+                        }
+
+                        ldLog() << LD_DEBUG << "Traced dependencies of" << dependencyGraph.closuresCount() << "ELF files, covering"
+                                << dependencyGraph.tracedFilesCount() << "files" << std::endl;
+
+                        ldLog() << LD_DEBUG << "ELF parse cache:" << elf_file::ElfFile::getParseCacheHits() << "hits,"
+                                << elf_file::ElfFile::getParseCacheMisses() << "misses" << std::endl;
+
+                        ldLog() << LD_DEBUG << "Copied files:"
+                                << copy_engine::getCopiedFilesCount(copy_engine::COPY_METHOD_REFLINK) << "reflinked,"
+                                << copy_engine::getCopiedFilesCount(copy_engine::COPY_METHOD_COPY_FILE_RANGE) << "using copy_file_range,"
+                                << copy_engine::getCopiedFilesCount(copy_engine::COPY_METHOD_SENDFILE) << "using sendfile,"
+                                << copy_engine::getCopiedFilesCount(copy_engine::COPY_METHOD_READ_WRITE) << "using read/write,"
+                                << copy_engine::getCopiedFilesCount(copy_engine::COPY_METHOD_HARDLINK) << "hardlinked" << std::endl;
+
+                        return success;
+                    }
+
+                    // list the regular files in the AppDir which are not empty
+                    // the directories are walked level by level, and all the directories of a level are listed in
+                    // parallel
+                    std::vector<DeduplicationCandidate> listDeduplicationCandidates() {
+                        std::vector<DeduplicationCandidate> candidates;
+                        std::vector<bf::path> directories{appDirPath};
+                        std::mutex mutex;
+
+                        while (!directories.empty()) {
+                            std::vector<bf::path> subdirectories;
+                            std::vector<std::function<void()>> tasks;
+
+                            for (const auto& directory : directories) {
+                                tasks.emplace_back([&candidates, &subdirectories, &mutex, directory]() {
+                                    std::vector<DeduplicationCandidate> files;
+                                    std::vector<bf::path> directories;
+
+                                    boost::system::error_code ec;
+
+                                    for (bf::directory_iterator it(directory, ec); !ec && it != bf::directory_iterator(); it.increment(ec)) {
+                                        const auto& path = it->path();
+                                        const auto status = it->symlink_status();
+
+                                        if (bf::is_directory(status)) {
+                                            directories.emplace_back(path);
+                                            continue;
+                                        }
+
+                                        struct stat st{};
+
+                                        // symlinks and special files are left alone
+                                        if (!bf::is_regular_file(status) || lstat(path.c_str(), &st) != 0 || st.st_size == 0)
+                                            continue;
+
+                                        DeduplicationCandidate candidate;
+                                        candidate.path = path;
+                                        candidate.size = static_cast<uint64_t>(st.st_size);
+                                        candidate.mode = st.st_mode & 07777;
+                                        candidate.device = st.st_dev;
+                                        candidate.inode = st.st_ino;
+                                        files.emplace_back(std::move(candidate));
                                     }
-                                }
 
-                                stripOperations.erase(stripOperations.begin());
+                                    std::lock_guard<std::mutex> lock(mutex);
+                                    std::move(files.begin(), files.end(), std::back_inserter(candidates));
+                                    subdirectories.insert(subdirectories.end(), directories.begin(), directories.end());
+                                });
                             }
+
+                            getThreadPool().run(tasks);
+                            directories.swap(subdirectories);
                         }
 
-                        if (!success)
+                        // the order in which the directories are listed depends on the scheduling, but the result
+                        // must be deterministic
+                        std::sort(candidates.begin(), candidates.end(), [](const DeduplicationCandidate& a, const DeduplicationCandidate& b) {
+                            return a.path < b.path;
+                        });
+
+                        return candidates;
+                    }
+
+                    // replace path with a hardlink or relative symlink to target
+                    // the link is created next to the file, and moved over it, so that the file is never missing
+                    static bool replaceWithLink(const bf::path& target, const bf::path& path, DEDUPLICATION_POLICY policy, std::string& error) {
+                        const auto tempPath = path.string() + ".linuxdeploy-dedup";
+                        unlink(tempPath.c_str());
+
+                        int rv;
+
+                        if (policy == DEDUPLICATE_WITH_HARDLINKS)
+                            rv = link(target.c_str(), tempPath.c_str());
+                        else
+                            rv = symlink(bf::relative(target, path.parent_path()).c_str(), tempPath.c_str());
+
+                        if (rv != 0) {
+                            error = "Failed to create link to " + target.string() + " for " + path.string() + ": " + strerror(errno);
                             return false;
+                        }
 
-                        while (!setElfRPathOperations.empty()) {
-                            const auto& currentEntry = *(setElfRPathOperations.begin());
-                            const auto& filePath = currentEntry.first;
-                            const auto& rpath = currentEntry.second;
+                        if (rename(tempPath.c_str(), path.c_str()) != 0) {
+                            error = "Failed to replace " + path.string() + ": " + strerror(errno);
+                            unlink(tempPath.c_str());
+                            return false;
+                        }
 
-                            elf_file::ElfFile elfFile(filePath);
+                        return true;
+                    }
 
-                            // no need to set rpath in debug symbols files
-                            // also, patchelf crashes on such symbols
-                            if (isInDebugSymbolsLocation(filePath) || elfFile.isDebugSymbolsFile()) {
-                                ldLog() << LD_WARNING << "Not setting rpath in debug symbols file:" << filePath
-                                        << std::endl;
-                            } else if (!elfFile.isDynamicallyLinked()) {
-                                ldLog() << LD_WARNING << "Not setting rpath in statically-linked file: " << filePath
-                                        << std::endl;
-                            } else {
-                                ldLog() << "Setting rpath in ELF file" << filePath << "to" << rpath << std::endl;
-                                if (!elf_file::ElfFile(filePath).setRPath(rpath)) {
-                                    ldLog() << LD_ERROR << "Failed to set rpath in ELF file:" << filePath << std::endl;
-                                    success = false;
-                                }
+                    bool deduplicateFiles(DEDUPLICATION_POLICY policy) {
+                        auto candidates = listDeduplicationCandidates();
+
+                        // files which are hardlinks of each other already are handled as one file
+                        // only files with the same size and permissions can be duplicates of each other
+                        std::set<std::pair<dev_t, ino_t>> inodes;
+                        std::map<std::pair<uint64_t, mode_t>, std::vector<size_t>> sameSizeGroups;
+
+                        for (size_t i = 0; i < candidates.size(); ++i) {
+                            const auto& candidate = candidates[i];
+
+                            if (inodes.insert(std::make_pair(candidate.device, candidate.inode)).second)
+                                sameSizeGroups[std::make_pair(candidate.size, candidate.mode)].emplace_back(i);
+                        }
+
+                        // only the files whose sizes collide have to be read
+                        std::vector<std::function<void()>> hashTasks;
+
+                        for (const auto& group : sameSizeGroups) {
+                            if (group.second.size() < 2)
+                                continue;
+
+                            for (const auto index : group.second)
+                                hashTasks.emplace_back([&candidates, index]() { hashFileContents(candidates[index]); });
+                        }
+
+                        ldLog() << "Deduplicating files in AppDir: hashing" << hashTasks.size() << "of" << candidates.size() << "files" << std::endl;
+
+                        getThreadPool().run(hashTasks);
+
+                        // the first file of every group of identical files is kept, the others are replaced with links
+                        // to it
+                        std::vector<std::vector<size_t>> identicalGroups;
+
+                        for (const auto& group : sameSizeGroups) {
+                            std::map<uint64_t, std::vector<size_t>> sameHashGroups;
+
+                            for (const auto index : group.second) {
+                                if (candidates[index].hashed)
+                                    sameHashGroups[candidates[index].hash].emplace_back(index);
                             }
 
-                            setElfRPathOperations.erase(setElfRPathOperations.begin());
+                            for (auto& sameHashGroup : sameHashGroups) {
+                                if (sameHashGroup.second.size() > 1)
+                                    identicalGroups.emplace_back(std::move(sameHashGroup.second));
+                            }
                         }
 
-                        return true;
+                        // the candidates are sorted by their paths, therefore sorting the groups by their first
+                        // indices orders them by the paths of the files which are kept
+                        std::sort(identicalGroups.begin(), identicalGroups.end(), [](const std::vector<size_t>& a, const std::vector<size_t>& b) {
+                            return a.front() < b.front();
+                        });
+
+                        // the groups are processed in parallel, the messages are collected per group and printed in
+                        // the groups' order afterwards so that the output is reproducible
+                        std::vector<std::vector<std::pair<LD_LOGLEVEL, std::string>>> messages(identicalGroups.size());
+
+                        std::mutex mutex;
+                        size_t replacedFilesCount = 0;
+                        uint64_t savedBytes = 0;
+                        bool success = true;
+
+                        std::vector<std::function<void()>> replaceTasks;
+
+                        for (size_t groupIndex = 0; groupIndex < identicalGroups.size(); ++groupIndex) {
+                            replaceTasks.emplace_back([&, groupIndex]() {
+                                const auto& group = identicalGroups[groupIndex];
+                                auto& groupMessages = messages[groupIndex];
+
+                                const auto& original = candidates[group.front()];
+
+                                for (auto it = group.begin() + 1; it != group.end(); ++it) {
+                                    const auto& duplicate = candidates[*it];
+
+                                    // the dynamic linker resolves $ORIGIN relative to the file a symlink points to,
+                                    // therefore ELF files are only symlinked within the same directory
+                                    if (policy == DEDUPLICATE_WITH_SYMLINKS && original.isElfFile &&
+                                        original.path.parent_path() != duplicate.path.parent_path())
+                                        continue;
+
+                                    // the hashes might collide
+                                    if (!haveSameContents(original.path, duplicate.path))
+                                        continue;
+
+                                    std::string error;
+
+                                    if (!replaceWithLink(original.path, duplicate.path, policy, error)) {
+                                        groupMessages.emplace_back(LD_WARNING, error);
+
+                                        std::lock_guard<std::mutex> lock(mutex);
+                                        success = false;
+                                        continue;
+                                    }
+
+                                    groupMessages.emplace_back(LD_DEBUG, "Replaced duplicate " + duplicate.path.string() + " with link to " + original.path.string());
+
+                                    std::lock_guard<std::mutex> lock(mutex);
+                                    ++replacedFilesCount;
+                                    savedBytes += duplicate.size;
+                                }
+                            });
+                        }
+
+                        getThreadPool().run(replaceTasks);
+
+                        for (const auto& groupMessages : messages) {
+                            for (const auto& message : groupMessages)
+                                ldLog() << message.first << message.second << std::endl;
+                        }
+
+                        ldLog() << "Replaced" << replacedFilesCount << "duplicate files with"
+                                << (policy == DEDUPLICATE_WITH_HARDLINKS ? "hardlinks" : "symlinks")
+                                << LD_NO_SPACE << ", saving" << std::to_string(savedBytes) << "bytes" << std::endl;
+
+                        return success;
                     }
 
                     // search for copyright file for file and deploy it to AppDir
@@ -345,10 +1277,27 @@ namespace linuxdeploy {
                         return to;
                     }
 
+                    util::thread_pool::ThreadPool& getThreadPool() {
+                        if (threadPool == nullptr)
+                            threadPool = std::make_shared<util::thread_pool::ThreadPool>(jobs);
+
+                        return *threadPool;
+                    }
+
                     bool deployElfDependencies(const bf::path& path) {
+                        // the file is part of a closure we deployed before, so are all its dependencies
+                        if (dependencyGraph.hasBeenTraced(path)) {
+                            ldLog() << LD_DEBUG << "Dependencies of ELF file have been deployed already:" << path << std::endl;
+                            return true;
+                        }
+
                         ldLog() << "Deploying dependencies for ELF file" << path << std::endl;
                         try {
-                            for (const auto &dependencyPath : elf_file::ElfFile(path).traceDynamicDependencies())
+                            const auto dependencies = elf_file::ElfFile(path).traceDynamicDependencies(getThreadPool());
+
+                            dependencyGraph.addClosure(path, dependencies);
+
+                            for (const auto &dependencyPath : dependencies)
                                 if (!deployLibrary(dependencyPath, false, false))
                                     return false;
                         } catch (const elf_file::DependencyNotFoundError& e) {
@@ -359,20 +1308,110 @@ namespace linuxdeploy {
                         return true;
                     }
 
-                    static std::string getStripPath() {
-                        // by default, try to use a strip next to the linuxdeploy binary
-                        // if that isn't available, fall back to searching for strip in the PATH
-                        std::string stripPath = "strip";
+                    // deploy the dependencies of multiple ELF files, tracing them with as few resolver calls as possible
+                    // returns the files whose dependencies could not be deployed, the errors are logged already
+                    std::set<bf::path> deployElfDependencies(const std::vector<bf::path>& paths) {
+                        std::set<bf::path> failedPaths;
+
+                        std::vector<bf::path> pathsToTrace;
+
+                        for (const auto& path : paths) {
+                            // see deployElfDependencies(path)
+                            if (dependencyGraph.hasBeenTraced(path)) {
+                                ldLog() << LD_DEBUG << "Dependencies of ELF file have been deployed already:" << path << std::endl;
+                                continue;
+                            }
+
+                            pathsToTrace.emplace_back(path);
+                        }
+
+                        if (pathsToTrace.empty())
+                            return failedPaths;
+
+                        ldLog() << "Tracing dependencies of" << pathsToTrace.size() << "ELF files" << std::endl;
+
+                        // the files are traced in parallel, but deployed sequentially in the order the files were
+                        // passed, which keeps the result deterministic and makes the log easier to follow
+                        const auto results = elf_file::ElfFile::traceDynamicDependencies(pathsToTrace, getThreadPool());
+
+                        for (const auto& path : pathsToTrace) {
+                            const auto& result = results.at(path);
+
+                            ldLog() << "Deploying dependencies for ELF file" << path << std::endl;
+
+                            if (!result.error.empty()) {
+                                ldLog() << LD_ERROR << result.error << std::endl;
+                                failedPaths.insert(path);
+                                continue;
+                            }
+
+                            dependencyGraph.addClosure(path, result.dependencies);
+
+                            for (const auto& dependencyPath : result.dependencies) {
+                                if (!deployLibrary(dependencyPath, false, false)) {
+                                    failedPaths.insert(path);
+                                    break;
+                                }
+                            }
+                        }
+
+                        return failedPaths;
+                    }
+
+                    bool isInExcludelist(const std::string& fileName) const {
+                        if (excludelist_matcher::ExcludelistMatcher::getGenerated().matches(fileName))
+                            return true;
+
+                        return userExcludelist != nullptr && userExcludelist->matches(fileName);
+                    }
+
+                    // resolve symlinks pointing to file one by one
+                    // returns the filenames of the symlinks, followed by the filename of the file they point to, e.g.,
+                    // libfoo.so.1 and libfoo.so.1.2.3
+                    // symlinks which don't change the filename, e.g., on merged-/usr systems, are skipped
+                    static std::vector<bf::path> resolveSymlinkChain(const bf::path& path) {
+                        std::vector<bf::path> chain{path.filename()};
+
+                        auto currentPath = path;
 
-                        auto binDirPath = bf::path(util::getOwnExecutablePath()).parent_path();
-                        auto localStripPath = binDirPath / "strip";
+                        // the limit is the same the kernel uses, and guards against symlink loops
+                        for (int i = 0; i < 40 && bf::is_symlink(currentPath); ++i) {
+                            auto target = bf::read_symlink(currentPath);
 
-                        if (bf::exists(localStripPath))
-                            stripPath = localStripPath.string();
+                            if (target.is_relative())
+                                target = currentPath.parent_path() / target;
 
-                        ldLog() << LD_DEBUG << "Using strip:" << stripPath << std::endl;
+                            currentPath = target;
+
+                            if (currentPath.filename() != chain.back())
+                                chain.emplace_back(currentPath.filename());
+                        }
 
-                        return stripPath;
+                        return chain;
+                    }
+
+                    // schedule creating the symlinks of a chain returned by resolveSymlinkChain() next to the file
+                    // they point to, which has been deployed to fileDestination
+                    // every symlink points to the next member of the chain, the last one to the deployed file
+                    // returns the number of symlinks which haven't been scheduled before
+                    size_t deploySymlinkChain(const std::vector<bf::path>& chain, const bf::path& fileDestination) {
+                        const auto directory = fileDestination.parent_path();
+
+                        size_t newSymlinksCount = 0;
+
+                        for (size_t i = 0; i + 1 < chain.size(); ++i) {
+                            if (chain[i] == fileDestination.filename())
+                                continue;
+
+                            const auto target = i + 2 == chain.size() ? fileDestination.filename() : chain[i + 1];
+
+                            if (symlinkOperations.count(directory / chain[i]) == 0)
+                                ++newSymlinksCount;
+
+                            symlinkOperations[directory / chain[i]] = directory / target;
+                        }
+
+                        return newSymlinksCount;
                     }
 
                     static std::string calculateRelativeRPath(const bf::path& originDir, const bf::path& dependencyLibrariesDir) {
@@ -392,28 +1431,7 @@ namespace linuxdeploy {
                             return false;
                         }
 
-                        static auto isInExcludelist = [](const bf::path& fileName) {
-                            for (const auto& excludePattern : generatedExcludelist) {
-                                // simple string match is faster than using fnmatch
-                                if (excludePattern == fileName)
-                                    return true;
-
-                                auto fnmatchResult = fnmatch(excludePattern.c_str(), fileName.string().c_str(), FNM_PATHNAME);
-                                switch (fnmatchResult) {
-                                    case 0:
-                                        return true;
-                                    case FNM_NOMATCH:
-                                        break;
-                                    default:
-                                        ldLog() << LD_ERROR << "fnmatch() reported error:" << fnmatchResult << std::endl;
-                                        return false;
-                                }
-                            }
-
-                            return false;
-                        };
-
-                        if (!forceDeploy && isInExcludelist(path.filename())) {
+                        if (!forceDeploy && isInExcludelist(path.filename().string())) {
                             ldLog() << "Skipping deployment of blacklisted library" << path << std::endl;
 
                             // mark file as visited
@@ -426,6 +1444,33 @@ namespace linuxdeploy {
                         // create a directory
                         bf::path libraryDir = appDirPath / "usr" / (getLibraryDirName(path) + "/");
 
+                        // libraries are usually referred to by symlinks, e.g., the soname link pointing to the real
+                        // file, which are recreated in the library directory, so that the file is copied once
+                        // libraries which are deployed to a specific destination are copied to that path, though
+                        const auto symlinkChain = destination.empty() ? resolveSymlinkChain(path) : std::vector<bf::path>{path.filename()};
+
+                        // the same file might have been deployed through another path already, e.g., another symlink
+                        // pointing to it, or the same path in /lib and /usr/lib on merged-/usr systems
+                        // if it has been deployed to the same directory, it is neither traced, copied nor stripped
+                        // again, only the symlinks are created
+                        VisitedFile visitedFile;
+
+                        if (!forceDeploy && destination.empty() && visitedFiles.findFile(path, visitedFile) &&
+                            !visitedFile.libraryDestination.empty()) {
+                            const auto& fileDestination = visitedFile.libraryDestination;
+
+                            if ((libraryDir / path.filename()).parent_path().lexically_normal() == fileDestination.parent_path().lexically_normal()) {
+                                visitedFiles.insert(path);
+
+                                if (deploySymlinkChain(symlinkChain, fileDestination) > 0)
+                                    ldLog() << "Deploying shared library" << path << "as symlink to" << fileDestination << std::endl;
+                                else
+                                    ldLog() << LD_DEBUG << "File has been deployed already through another path:" << path << std::endl;
+
+                                return true;
+                            }
+                        }
+
                         ldLog() << "Deploying shared library" << path;
                         if (!destination.empty())
                             ldLog() << " (destination:" << destination << LD_NO_SPACE << ")";
@@ -435,11 +1480,13 @@ namespace linuxdeploy {
 
                         // not sure whether this is 100% bullet proof, but it simulates the cp command behavior
                         if (actualDestination.string().back() == '/' || bf::is_directory(actualDestination)) {
-                            actualDestination /= path.filename();
+                            actualDestination /= symlinkChain.back();
                         }
 
                         // in case destinationPath is a directory, deployFile will give us the deployed file's path
                         actualDestination = deployFile(path, actualDestination, DEFAULT_PERMS);
+                        visitedFiles.insert(path, actualDestination);
+                        deploySymlinkChain(symlinkChain, actualDestination);
                         deployCopyrightFiles(path);
 
                         std::string rpath = "$ORIGIN";
@@ -815,25 +1862,35 @@ namespace linuxdeploy {
             }
 
             bool AppDir::deployDependenciesForExistingFiles() const {
+                std::vector<bf::path> executables;
+                std::vector<bf::path> sharedLibraries;
+
                 for (const auto& executable : listExecutables()) {
-                    if (bf::is_symlink(executable))
-                        continue;
+                    if (!bf::is_symlink(executable))
+                        executables.emplace_back(executable);
+                }
+
+                for (const auto& sharedLibrary : listSharedLibraries()) {
+                    if (!bf::is_symlink(sharedLibrary))
+                        sharedLibraries.emplace_back(sharedLibrary);
+                }
+
+                // tracing all files at once allows for batching the resolver calls
+                {
+                    auto elfFiles = executables;
+                    elfFiles.insert(elfFiles.end(), sharedLibraries.begin(), sharedLibraries.end());
 
-                    if (!d->deployElfDependencies(executable))
+                    if (!d->deployElfDependencies(elfFiles).empty())
                         return false;
+                }
 
+                for (const auto& executable : executables) {
                     std::string rpath = "$ORIGIN/../" + PrivateData::getLibraryDirName(executable);
 
                     d->setElfRPathOperations[executable] = rpath;
                 }
 
-                for (const auto& sharedLibrary : listSharedLibraries()) {
-                    if (bf::is_symlink(sharedLibrary))
-                        continue;
-
-                    if (!d->deployElfDependencies(sharedLibrary))
-                        return false;
-
+                for (const auto& sharedLibrary : sharedLibraries) {
                     const auto rpath = elf_file::ElfFile(sharedLibrary).getRPath();
                     auto rpathList = util::split(rpath, ':');
                     if (std::find(rpathList.begin(), rpathList.end(), "$ORIGIN") == rpathList.end()) {
@@ -903,62 +1960,122 @@ namespace linuxdeploy {
 
             // TODO: quite similar to deployDependenciesForExistingFiles... maybe they should be merged or use each other
             bool AppDir::deployDependenciesOnlyForElfFile(const boost::filesystem::path& elfFilePath, bool failSilentForNonElfFile) {
-                // preconditions: file must be an ELF one, and file must be contained in the AppDir
-                const auto canonicalElfFilePath = bf::canonical(elfFilePath);
+                return deployDependenciesOnlyForElfFiles({elfFilePath}, failSilentForNonElfFile);
+            }
 
-                // can't bundle directories
-                if (!bf::is_regular_file(canonicalElfFilePath)) {
-                    ldLog() << LD_DEBUG << "Skipping non-file directory entry:" << canonicalElfFilePath << std::endl;
-                    return false;
-                }
+            bool AppDir::deployDependenciesOnlyForElfFiles(const std::vector<boost::filesystem::path>& elfFilePaths, bool failSilentForNonElfFile) {
+                bool success = true;
 
                 // to do a proper prefix check, we need a proper absolute canonical path for the AppDir
                 const auto canonicalAppDirPath = bf::canonical(this->path());
                 ldLog() << LD_DEBUG << "absolute canonical AppDir path:" << canonicalAppDirPath << std::endl;
 
-                // a fancy way to check STL strings for prefixes is to "ab"use rfind
-                if (canonicalElfFilePath.string().rfind(canonicalAppDirPath.string()) != 0) {
-                    ldLog() << LD_ERROR << "File" << canonicalElfFilePath << "is not contained in AppDir, its dependencies cannot be deployed into the AppDir" << std::endl;
-                    return false;
-                }
+                // files which passed all the checks, mapped to the paths passed by the caller
+                std::vector<std::pair<bf::path, bf::path>> elfFiles;
 
-                // make sure we have an ELF file
-                try {
-                    elf_file::ElfFile(canonicalElfFilePath.string());
-                } catch (const elf_file::ElfFileParseError& e) {
-                    auto level = LD_ERROR;
+                for (const auto& elfFilePath : elfFilePaths) {
+                    // preconditions: file must be an ELF one, and file must be contained in the AppDir
+                    const auto canonicalElfFilePath = bf::canonical(elfFilePath);
 
-                    if (failSilentForNonElfFile) {
-                        level = LD_WARNING;
+                    // can't bundle directories
+                    if (!bf::is_regular_file(canonicalElfFilePath)) {
+                        ldLog() << LD_DEBUG << "Skipping non-file directory entry:" << canonicalElfFilePath << std::endl;
+                        success = false;
+                        continue;
+                    }
+
+                    // a fancy way to check STL strings for prefixes is to "ab"use rfind
+                    if (canonicalElfFilePath.string().rfind(canonicalAppDirPath.string()) != 0) {
+                        ldLog() << LD_ERROR << "File" << canonicalElfFilePath << "is not contained in AppDir, its dependencies cannot be deployed into the AppDir" << std::endl;
+                        success = false;
+                        continue;
                     }
 
-                    ldLog() << level << "Not an ELF file:" << canonicalElfFilePath << std::endl;
+                    // make sure we have an ELF file
+                    try {
+                        elf_file::ElfFile(canonicalElfFilePath.string());
+                    } catch (const elf_file::ElfFileParseError& e) {
+                        auto level = LD_ERROR;
+
+                        if (failSilentForNonElfFile) {
+                            level = LD_WARNING;
+                        }
+
+                        ldLog() << level << "Not an ELF file:" << canonicalElfFilePath << std::endl;
 
-                    return failSilentForNonElfFile;
+                        success = success && failSilentForNonElfFile;
+                        continue;
+                    }
+
+                    elfFiles.emplace_back(canonicalElfFilePath, elfFilePath);
                 }
 
-                // relative path makes for a nicer and more consistent log
-                ldLog() << "Deploying dependencies for ELF file in AppDir:" << elfFilePath << std::endl;
+                std::vector<bf::path> canonicalElfFilePaths;
+
+                for (const auto& elfFile : elfFiles)
+                    canonicalElfFilePaths.emplace_back(elfFile.first);
 
                 // bundle dependencies
-                if (!d->deployElfDependencies(canonicalElfFilePath))
-                    return false;
+                const auto failedPaths = d->deployElfDependencies(canonicalElfFilePaths);
 
-                // set rpath correctly
-                const auto rpathDestination = this->path() / "usr/lib";
-                ldLog() << LD_DEBUG << "rpath destination:" << rpathDestination << std::endl;
+                for (const auto& elfFile : elfFiles) {
+                    const auto& canonicalElfFilePath = elfFile.first;
+                    const auto& elfFilePath = elfFile.second;
 
-                const auto rpath = PrivateData::calculateRelativeRPath(elfFilePath.parent_path(), rpathDestination);
-                ldLog() << LD_DEBUG << "Calculated rpath:" << rpath << std::endl;
+                    if (failedPaths.find(canonicalElfFilePath) != failedPaths.end()) {
+                        ldLog() << LD_WARNING << "Failed to deploy dependencies for ELF file in AppDir:" << elfFilePath << std::endl;
+                        success = false;
+                        continue;
+                    }
 
-                d->setElfRPathOperations[canonicalElfFilePath] = rpath;
+                    // set rpath correctly
+                    const auto rpathDestination = this->path() / "usr/lib";
+                    ldLog() << LD_DEBUG << "rpath destination:" << rpathDestination << std::endl;
 
-                return true;
+                    const auto rpath = PrivateData::calculateRelativeRPath(elfFilePath.parent_path(), rpathDestination);
+                    ldLog() << LD_DEBUG << "Calculated rpath for" << elfFilePath << LD_NO_SPACE << ":" << rpath << std::endl;
+
+                    d->setElfRPathOperations[canonicalElfFilePath] = rpath;
+                }
+
+                return success;
             }
 
             void AppDir::setDisableCopyrightFilesDeployment(bool disable) {
                 d->disableCopyrightFilesDeployment = disable;
             }
+
+            void AppDir::setJobs(unsigned int jobs) {
+                d->jobs = jobs;
+                d->threadPool = nullptr;
+            }
+
+            void AppDir::setCopyQueueDepth(unsigned int depth) {
+                d->copyQueueDepth = depth;
+            }
+
+            bool AppDir::deduplicateFiles(DEDUPLICATION_POLICY policy) {
+                return d->deduplicateFiles(policy);
+            }
+
+            bool AppDir::addExcludelistFile(const bf::path& path) {
+                std::vector<std::string> entries;
+
+                try {
+                    entries = excludelist_matcher::ExcludelistMatcher::readEntries(path);
+                } catch (const excludelist_matcher::ExcludelistError& e) {
+                    ldLog() << LD_ERROR << e.what() << std::endl;
+                    return false;
+                }
+
+                ldLog() << "Adding" << entries.size() << "entries from excludelist file" << path << std::endl;
+
+                // all the user's entries are compiled into a single matcher
+                d->userExcludelistEntries.insert(d->userExcludelistEntries.end(), entries.begin(), entries.end());
+                d->userExcludelist = std::make_shared<excludelist_matcher::ExcludelistMatcher>(d->userExcludelistEntries);
+
+                return true;
+            }
         }
     }
 }
@@ -0,0 +1,296 @@
+// system includes
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// local headers
+#include "linuxdeploy/core/copy_engine.h"
+#include "linuxdeploy/core/log.h"
+
+using namespace linuxdeploy::core::log;
+
+namespace bf = boost::filesystem;
+
+// defined in linux/fs.h, which is not available on all the systems we support
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
+namespace linuxdeploy {
+    namespace core {
+        namespace copy_engine {
+            namespace {
+                // -1 means the mode has not been selected yet
+                int copyMode = -1;
+
+                std::atomic<size_t> copiedFilesCounts[COPY_METHODS_COUNT];
+
+                // closes the file descriptor when going out of scope
+                class FileDescriptor {
+                    public:
+                        int fd;
+
+                        explicit FileDescriptor(int fd) : fd(fd) {}
+
+                        ~FileDescriptor() {
+                            if (fd >= 0)
+                                ::close(fd);
+                        }
+
+                        FileDescriptor(const FileDescriptor&) = delete;
+                        FileDescriptor& operator=(const FileDescriptor&) = delete;
+                };
+
+                CopyError makeError(const std::string& message, const bf::path& path) {
+                    const auto error = errno;
+                    return CopyError(message + " " + path.string() + ": " + strerror(error));
+                }
+
+                // the call is not supported for this combination of files, and the next method has to be tried
+                bool isUnsupported(int error) {
+                    return error == ENOSYS || error == EXDEV || error == EINVAL || error == EOPNOTSUPP ||
+                           error == ENOTSUP || error == EBADF || error == EPERM;
+                }
+
+                ssize_t copyFileRange(int in, off_t* inOffset, int out, off_t* outOffset, size_t length) {
+                    // glibc provides a wrapper only since version 2.27, and emulates the call in some versions
+                    #ifdef SYS_copy_file_range
+                    return syscall(SYS_copy_file_range, in, inOffset, out, outOffset, length, 0u);
+                    #else
+                    errno = ENOSYS;
+                    return -1;
+                    #endif
+                }
+
+                // copy length bytes at offset, switching to the next method if the current one is not supported
+                void copyRange(int in, int out, off_t offset, off_t length, COPY_METHOD& method, const bf::path& from) {
+                    std::vector<char> buffer;
+
+                    while (length > 0) {
+                        ssize_t copied;
+
+                        switch (method) {
+                            case COPY_METHOD_COPY_FILE_RANGE: {
+                                off_t inOffset = offset;
+                                off_t outOffset = offset;
+                                copied = copyFileRange(in, &inOffset, out, &outOffset, static_cast<size_t>(length));
+
+                                if (copied < 0 && isUnsupported(errno)) {
+                                    method = COPY_METHOD_SENDFILE;
+                                    continue;
+                                }
+                                break;
+                            }
+                            case COPY_METHOD_SENDFILE: {
+                                // sendfile() writes at the current position of the output file
+                                if (lseek(out, offset, SEEK_SET) < 0)
+                                    throw makeError("Failed to seek in copy of", from);
+
+                                off_t inOffset = offset;
+                                copied = sendfile(out, in, &inOffset, static_cast<size_t>(length));
+
+                                if (copied < 0 && isUnsupported(errno)) {
+                                    method = COPY_METHOD_READ_WRITE;
+                                    continue;
+                                }
+                                break;
+                            }
+                            default: {
+                                buffer.resize(128 * 1024);
+
+                                const auto chunkSize = std::min(static_cast<size_t>(length), buffer.size());
+                                copied = pread(in, buffer.data(), chunkSize, offset);
+
+                                if (copied > 0) {
+                                    for (ssize_t written = 0; written < copied;) {
+                                        const auto rv = pwrite(out, buffer.data() + written, copied - written, offset + written);
+
+                                        if (rv < 0) {
+                                            if (errno == EINTR)
+                                                continue;
+
+                                            throw makeError("Failed to write copy of", from);
+                                        }
+
+                                        written += rv;
+                                    }
+                                }
+                                break;
+                            }
+                        }
+
+                        if (copied < 0) {
+                            if (errno == EINTR)
+                                continue;
+
+                            throw makeError("Failed to copy", from);
+                        }
+
+                        // the file has been truncated while copying it
+                        if (copied == 0)
+                            throw CopyError("Unexpected end of file: " + from.string());
+
+                        offset += copied;
+                        length -= copied;
+                    }
+                }
+
+                COPY_METHOD copyContents(int in, int out, off_t size, const bf::path& from) {
+                    if (ioctl(out, FICLONE, in) == 0)
+                        return COPY_METHOD_REFLINK;
+
+                    auto method = COPY_METHOD_COPY_FILE_RANGE;
+
+                    // only the data segments are copied, the holes are recreated by writing at the right offsets
+                    // and setting the size of the file in the end
+                    for (off_t offset = 0; offset < size;) {
+                        off_t dataBegin = lseek(in, offset, SEEK_DATA);
+                        off_t dataEnd;
+
+                        if (dataBegin < 0) {
+                            // there is no more data after the offset
+                            if (errno == ENXIO)
+                                break;
+
+                            // the filesystem doesn't support looking for holes
+                            dataBegin = offset;
+                            dataEnd = size;
+                        } else {
+                            dataEnd = lseek(in, dataBegin, SEEK_HOLE);
+
+                            if (dataEnd < 0 || dataEnd > size)
+                                dataEnd = size;
+                        }
+
+                        copyRange(in, out, dataBegin, dataEnd - dataBegin, method, from);
+                        offset = dataEnd;
+                    }
+
+                    if (ftruncate(out, size) != 0)
+                        throw makeError("Failed to set size of copy of", from);
+
+                    return method;
+                }
+
+                bool createHardlink(const bf::path& from, const bf::path& to) {
+                    if (unlink(to.c_str()) != 0 && errno != ENOENT)
+                        return false;
+
+                    // like copying, the file a symlink points to is linked rather than the symlink
+                    return linkat(AT_FDCWD, from.c_str(), AT_FDCWD, to.c_str(), AT_SYMLINK_FOLLOW) == 0;
+                }
+            }
+
+            void setCopyMode(COPY_MODE mode) {
+                copyMode = mode;
+            }
+
+            COPY_MODE getCopyMode() {
+                if (copyMode < 0) {
+                    if (getenv("USE_HARDLINKS") != nullptr) {
+                        ldLog() << LD_WARNING << "$USE_HARDLINKS environment variable detected, creating hardlinks instead of copying files where possible" << std::endl;
+                        copyMode = COPY_MODE_HARDLINK;
+                    } else {
+                        copyMode = COPY_MODE_COPY;
+                    }
+                }
+
+                return static_cast<COPY_MODE>(copyMode);
+            }
+
+            COPY_METHOD copyFile(const bf::path& from, const bf::path& to, bool allowHardlink) {
+                // if linking fails, e.g., because the files are located on different filesystems, the file is copied
+                if (allowHardlink && getCopyMode() == COPY_MODE_HARDLINK && createHardlink(from, to)) {
+                    ++copiedFilesCounts[COPY_METHOD_HARDLINK];
+                    return COPY_METHOD_HARDLINK;
+                }
+
+                FileDescriptor in(open(from.c_str(), O_RDONLY | O_CLOEXEC));
+
+                if (in.fd < 0)
+                    throw makeError("Failed to open", from);
+
+                struct stat st{};
+
+                if (fstat(in.fd, &st) != 0)
+                    throw makeError("Failed to stat", from);
+
+                if (!S_ISREG(st.st_mode))
+                    throw CopyError("Not a regular file: " + from.string());
+
+                // writing into a file which has more than one link would modify the other links, too, e.g., the
+                // source files of a hardlinked AppDir
+                struct stat toSt{};
+
+                if (lstat(to.c_str(), &toSt) == 0 && S_ISREG(toSt.st_mode) && toSt.st_nlink > 1) {
+                    if (unlink(to.c_str()) != 0)
+                        throw makeError("Failed to remove", to);
+                }
+
+                FileDescriptor out(open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 07777));
+
+                if (out.fd < 0)
+                    throw makeError("Failed to create", to);
+
+                if (fchmod(out.fd, st.st_mode & 07777) != 0)
+                    throw makeError("Failed to set permissions of", to);
+
+                const auto method = copyContents(in.fd, out.fd, st.st_size, from);
+
+                // errors writing the data might only be reported when closing the file
+                const auto outFd = out.fd;
+                out.fd = -1;
+
+                if (::close(outFd) != 0)
+                    throw makeError("Failed to write", to);
+
+                ++copiedFilesCounts[method];
+                return method;
+            }
+
+            void breakHardlink(const bf::path& path) {
+                struct stat st{};
+
+                if (lstat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) || st.st_nlink <= 1)
+                    return;
+
+                ldLog() << LD_DEBUG << "Replacing hardlink with copy:" << path << std::endl;
+
+                // the copy must be located on the same filesystem for rename() to work
+                std::string tempPath = path.string() + ".XXXXXX";
+                const int fd = mkostemp(&tempPath[0], O_CLOEXEC);
+
+                if (fd < 0)
+                    throw makeError("Failed to create temporary copy of", path);
+
+                ::close(fd);
+
+                try {
+                    copyFile(path, tempPath);
+                } catch (...) {
+                    unlink(tempPath.c_str());
+                    throw;
+                }
+
+                if (rename(tempPath.c_str(), path.c_str()) != 0) {
+                    const auto error = makeError("Failed to replace", path);
+                    unlink(tempPath.c_str());
+                    throw error;
+                }
+            }
+
+            size_t getCopiedFilesCount(COPY_METHOD method) {
+                return copiedFilesCounts[method];
+            }
+        }
+    }
+}
@@ -12,14 +12,23 @@ namespace linuxdeploy {
             std::vector<bf::path> DpkgQueryCopyrightFilesManager::getCopyrightFilesForPath(const bf::path& path) {
                 subprocess::subprocess proc{{"dpkg-query", "-S", path.c_str()}};
 
-                auto result = proc.run();
+                // only the first line of the output is of interest, the rest doesn't have to be stored
+                std::string firstLine;
+                bool firstLineRead = false;
+
+                const auto exitCode = proc.run_lines([&firstLine, &firstLineRead](boost::string_view line) {
+                    if (!firstLineRead) {
+                        firstLine = line.to_string();
+                        firstLineRead = true;
+                    }
+                }, nullptr);
 
-                if (result.exit_code() != 0 || result.stdout_contents().empty()) {
+                if (exitCode != 0 || !firstLineRead) {
                     ldLog() << LD_WARNING << "Could not find copyright files for file" << path << "using dpkg-query" << std::endl;
                     return {};
                 }
 
-                auto packageName = util::split(util::splitLines(result.stdout_string())[0], ':')[0];
+                auto packageName = firstLine.substr(0, firstLine.find(':'));
 
                 if (!packageName.empty()) {
                     auto copyrightFilePath = bf::path("/usr/share/doc") / packageName / "copyright";
@@ -0,0 +1,671 @@
+// system includes
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// local headers
+#include "linuxdeploy/core/dependency_cache.h"
+#include "linuxdeploy/core/log.h"
+
+using namespace linuxdeploy::core::log;
+
+namespace bf = boost::filesystem;
+
+namespace linuxdeploy {
+    namespace core {
+        namespace dependency_cache {
+            namespace {
+                // the file is only ever read by the machine which has written it, therefore all values are stored in
+                // host byte order
+                // a file written on a machine with another byte order or by another version is simply ignored
+                constexpr char MAGIC[8] = {'l', 'd', '-', 'd', 'e', 'p', 's', '\0'};
+                constexpr uint32_t FORMAT_VERSION = 1;
+
+                // set if the dependencies of the file have been traced
+                constexpr uint32_t FLAG_HAS_DEPENDENCIES = 0x1;
+
+                struct FileIdentity {
+                    uint64_t device;
+                    uint64_t inode;
+                    uint64_t size;
+                    int64_t mtimeSec;
+                    int64_t mtimeNsec;
+
+                    bool operator==(const FileIdentity& other) const {
+                        return device == other.device && inode == other.inode && size == other.size &&
+                               mtimeSec == other.mtimeSec && mtimeNsec == other.mtimeNsec;
+                    }
+
+                    bool operator!=(const FileIdentity& other) const {
+                        return !(*this == other);
+                    }
+                };
+
+                // the file consists of the header, followed by the entries sorted by path, the dependencies and the
+                // string table
+                // all strings are referenced by their offset within the string table, which ends with a null byte
+                struct FileHeader {
+                    char magic[sizeof(MAGIC)];
+                    uint32_t version;
+                    uint32_t entriesCount;
+                    uint64_t environmentHash;
+                    uint32_t dependenciesCount;
+                    uint32_t stringsSize;
+                };
+
+                struct FileEntry {
+                    FileIdentity identity;
+                    uint32_t path;
+                    uint32_t rpath;
+                    uint32_t flags;
+                    uint32_t firstDependency;
+                    uint32_t dependenciesCount;
+                    uint32_t padding;
+                };
+
+                struct FileDependency {
+                    FileIdentity identity;
+                    uint32_t path;
+                    uint32_t padding;
+                };
+
+                // entry as kept in memory until it's written to disk
+                struct Record {
+                    FileIdentity identity;
+                    uint32_t flags;
+                    std::string rpath;
+                    std::vector<std::pair<std::string, FileIdentity>> dependencies;
+                };
+
+                bool getIdentity(const std::string& path, FileIdentity& identity) {
+                    struct stat st{};
+
+                    if (stat(path.c_str(), &st) != 0)
+                        return false;
+
+                    identity.device = static_cast<uint64_t>(st.st_dev);
+                    identity.inode = static_cast<uint64_t>(st.st_ino);
+                    identity.size = static_cast<uint64_t>(st.st_size);
+                    identity.mtimeSec = static_cast<int64_t>(st.st_mtim.tv_sec);
+                    identity.mtimeNsec = static_cast<int64_t>(st.st_mtim.tv_nsec);
+
+                    return true;
+                }
+
+                std::string canonicalPath(const bf::path& path) {
+                    boost::system::error_code ec;
+                    const auto canonicalPath = bf::canonical(path, ec);
+
+                    if (ec)
+                        return bf::absolute(path).string();
+
+                    return canonicalPath.string();
+                }
+
+                // FNV-1a
+                uint64_t hashData(uint64_t hash, const void* data, size_t size) {
+                    const auto* bytes = static_cast<const uint8_t*>(data);
+
+                    for (size_t i = 0; i < size; ++i) {
+                        hash ^= bytes[i];
+                        hash *= 0x100000001b3ull;
+                    }
+
+                    return hash;
+                }
+
+                // the results of tracing depend on the linker's configuration, the library search path and the settings
+                // described by environmentKey, the entries of a file written in another environment cannot be used
+                uint64_t getEnvironmentHash(const std::string& environmentKey) {
+                    uint64_t hash = 0xcbf29ce484222325ull;
+
+                    // ldconfig replaces the file, therefore its identity changes whenever the configuration changes
+                    FileIdentity ldSoCacheIdentity{};
+                    getIdentity("/etc/ld.so.cache", ldSoCacheIdentity);
+                    hash = hashData(hash, &ldSoCacheIdentity, sizeof(ldSoCacheIdentity));
+
+                    // distinguish an empty from an unset variable
+                    const auto* ldLibraryPath = getenv("LD_LIBRARY_PATH");
+
+                    if (ldLibraryPath != nullptr) {
+                        hash = hashData(hash, "1", 1);
+                        hash = hashData(hash, ldLibraryPath, strlen(ldLibraryPath));
+                    } else {
+                        hash = hashData(hash, "0", 1);
+                    }
+
+                    hash = hashData(hash, environmentKey.data(), environmentKey.size());
+
+                    return hash;
+                }
+
+                // builds the string table, storing every string only once
+                class StringTable {
+                    private:
+                        std::string _data;
+                        std::map<std::string, uint32_t> _offsets;
+
+                    public:
+                        StringTable() : _data(1, '\0') {
+                            // the empty string is always located at the beginning
+                            _offsets[""] = 0;
+                        }
+
+                        uint32_t add(const std::string& string) {
+                            const auto it = _offsets.find(string);
+
+                            if (it != _offsets.end())
+                                return it->second;
+
+                            const auto offset = static_cast<uint32_t>(_data.size());
+                            _data.append(string);
+                            _data.push_back('\0');
+
+                            _offsets[string] = offset;
+                            return offset;
+                        }
+
+                        const std::string& data() const {
+                            return _data;
+                        }
+                };
+
+                bool writeAll(int fd, const void* data, size_t size) {
+                    const auto* bytes = static_cast<const char*>(data);
+
+                    while (size > 0) {
+                        const auto rv = ::write(fd, bytes, size);
+
+                        if (rv < 0) {
+                            if (errno == EINTR)
+                                continue;
+
+                            return false;
+                        }
+
+                        bytes += rv;
+                        size -= static_cast<size_t>(rv);
+                    }
+
+                    return true;
+                }
+            }
+
+            class DependencyCache::PrivateData {
+                public:
+                    bf::path path;
+                    uint64_t environmentHash;
+
+                    // currently mapped cache file
+                    const uint8_t* data = nullptr;
+                    size_t dataSize = 0;
+                    const FileHeader* header = nullptr;
+                    const FileEntry* entries = nullptr;
+                    const FileDependency* dependencies = nullptr;
+                    const char* strings = nullptr;
+
+                    // guards all the following members as well as the mapping
+                    mutable std::mutex mutex;
+
+                    // entries added in this process, which haven't been saved yet
+                    std::map<std::string, Record> pendingRecords;
+
+                    mutable size_t hits = 0;
+                    mutable size_t misses = 0;
+
+                public:
+                    PrivateData(const bf::path& path, const std::string& environmentKey) : path(path), environmentHash(getEnvironmentHash(environmentKey)) {
+                        map();
+                    }
+
+                    ~PrivateData() {
+                        unmap();
+                    }
+
+                public:
+                    // map the cache file, if it exists and can be used in the current environment
+                    void map() {
+                        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+                        if (fd < 0)
+                            return;
+
+                        struct stat st{};
+
+                        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(FileHeader)) {
+                            ::close(fd);
+                            return;
+                        }
+
+                        dataSize = static_cast<size_t>(st.st_size);
+
+                        void* mapping = mmap(nullptr, dataSize, PROT_READ, MAP_PRIVATE, fd, 0);
+                        ::close(fd);
+
+                        if (mapping == MAP_FAILED) {
+                            ldLog() << LD_DEBUG << "Failed to map dependency cache:" << path << std::endl;
+                            dataSize = 0;
+                            return;
+                        }
+
+                        data = static_cast<const uint8_t*>(mapping);
+
+                        if (!parseHeader()) {
+                            ldLog() << LD_DEBUG << "Ignoring outdated or invalid dependency cache:" << path << std::endl;
+                            unmap();
+                        }
+                    }
+
+                    void unmap() {
+                        if (data != nullptr)
+                            munmap(const_cast<uint8_t*>(data), dataSize);
+
+                        data = nullptr;
+                        dataSize = 0;
+                        header = nullptr;
+                        entries = nullptr;
+                        dependencies = nullptr;
+                        strings = nullptr;
+                    }
+
+                private:
+                    bool parseHeader() {
+                        header = reinterpret_cast<const FileHeader*>(data);
+
+                        if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != FORMAT_VERSION)
+                            return false;
+
+                        if (header->environmentHash != environmentHash)
+                            return false;
+
+                        const auto entriesOffset = sizeof(FileHeader);
+                        const auto dependenciesOffset = entriesOffset + header->entriesCount * sizeof(FileEntry);
+                        const auto stringsOffset = dependenciesOffset + header->dependenciesCount * sizeof(FileDependency);
+
+                        if (stringsOffset + header->stringsSize != dataSize || header->stringsSize == 0)
+                            return false;
+
+                        entries = reinterpret_cast<const FileEntry*>(data + entriesOffset);
+                        dependencies = reinterpret_cast<const FileDependency*>(data + dependenciesOffset);
+                        strings = reinterpret_cast<const char*>(data + stringsOffset);
+
+                        // makes sure every string is terminated within the file
+                        if (strings[header->stringsSize - 1] != '\0')
+                            return false;
+
+                        return true;
+                    }
+
+                    const char* getString(uint32_t offset) const {
+                        if (offset >= header->stringsSize)
+                            return nullptr;
+
+                        return strings + offset;
+                    }
+
+                    // binary search for the entry of the given path in the mapped file
+                    const FileEntry* findEntry(const std::string& canonicalPath) const {
+                        if (header == nullptr)
+                            return nullptr;
+
+                        uint32_t left = 0;
+                        uint32_t right = header->entriesCount;
+
+                        while (left < right) {
+                            const auto middle = left + (right - left) / 2;
+                            const auto* entryPath = getString(entries[middle].path);
+
+                            if (entryPath == nullptr)
+                                return nullptr;
+
+                            const auto result = strcmp(canonicalPath.c_str(), entryPath);
+
+                            if (result == 0)
+                                return &entries[middle];
+
+                            if (result < 0)
+                                right = middle;
+                            else
+                                left = middle + 1;
+                        }
+
+                        return nullptr;
+                    }
+
+                    bool readRecord(const FileEntry& entry, Record& record) const {
+                        const auto* rpath = getString(entry.rpath);
+
+                        if (rpath == nullptr)
+                            return false;
+
+                        if (entry.firstDependency > header->dependenciesCount ||
+                            entry.dependenciesCount > header->dependenciesCount - entry.firstDependency)
+                            return false;
+
+                        record.identity = entry.identity;
+                        record.flags = entry.flags;
+                        record.rpath = rpath;
+                        record.dependencies.clear();
+
+                        for (uint32_t i = 0; i < entry.dependenciesCount; ++i) {
+                            const auto& dependency = dependencies[entry.firstDependency + i];
+                            const auto* dependencyPath = getString(dependency.path);
+
+                            if (dependencyPath == nullptr)
+                                return false;
+
+                            record.dependencies.emplace_back(dependencyPath, dependency.identity);
+                        }
+
+                        return true;
+                    }
+
+                public:
+                    // look up record in the pending records first, then in the mapped file
+                    // must be called with the mutex locked
+                    bool findRecord(const std::string& canonicalPath, Record& record) const {
+                        const auto it = pendingRecords.find(canonicalPath);
+
+                        if (it != pendingRecords.end()) {
+                            record = it->second;
+                            return true;
+                        }
+
+                        const auto* entry = findEntry(canonicalPath);
+                        return entry != nullptr && readRecord(*entry, record);
+                    }
+
+                    // return all records stored in the mapped file
+                    // must be called with the mutex locked
+                    std::map<std::string, Record> readAllRecords() const {
+                        std::map<std::string, Record> records;
+
+                        if (header == nullptr)
+                            return records;
+
+                        for (uint32_t i = 0; i < header->entriesCount; ++i) {
+                            const auto* entryPath = getString(entries[i].path);
+                            Record record;
+
+                            if (entryPath != nullptr && readRecord(entries[i], record))
+                                records[entryPath] = std::move(record);
+                        }
+
+                        return records;
+                    }
+
+                    // write records to a temporary file, and replace the cache file with it
+                    // readers which have mapped the old file can continue to use it
+                    bool writeRecords(const std::map<std::string, Record>& records) const {
+                        StringTable stringTable;
+                        std::vector<FileEntry> fileEntries;
+                        std::vector<FileDependency> fileDependencies;
+
+                        // std::map is sorted already, which is what the binary search requires
+                        for (const auto& pair : records) {
+                            const auto& record = pair.second;
+
+                            FileEntry entry{};
+                            entry.identity = record.identity;
+                            entry.path = stringTable.add(pair.first);
+                            entry.rpath = stringTable.add(record.rpath);
+                            entry.flags = record.flags;
+                            entry.firstDependency = static_cast<uint32_t>(fileDependencies.size());
+                            entry.dependenciesCount = static_cast<uint32_t>(record.dependencies.size());
+                            fileEntries.push_back(entry);
+
+                            for (const auto& dependency : record.dependencies) {
+                                FileDependency fileDependency{};
+                                fileDependency.identity = dependency.second;
+                                fileDependency.path = stringTable.add(dependency.first);
+                                fileDependencies.push_back(fileDependency);
+                            }
+                        }
+
+                        FileHeader fileHeader{};
+                        memcpy(fileHeader.magic, MAGIC, sizeof(MAGIC));
+                        fileHeader.version = FORMAT_VERSION;
+                        fileHeader.entriesCount = static_cast<uint32_t>(fileEntries.size());
+                        fileHeader.environmentHash = environmentHash;
+                        fileHeader.dependenciesCount = static_cast<uint32_t>(fileDependencies.size());
+                        fileHeader.stringsSize = static_cast<uint32_t>(stringTable.data().size());
+
+                        // the temporary file must be located in the same directory for rename() to be atomic
+                        std::string tempPath = path.string() + ".XXXXXX";
+                        const int fd = mkostemp(&tempPath[0], O_CLOEXEC);
+
+                        if (fd < 0)
+                            return false;
+
+                        const auto success = fchmod(fd, 0644) == 0 &&
+                            writeAll(fd, &fileHeader, sizeof(fileHeader)) &&
+                            writeAll(fd, fileEntries.data(), fileEntries.size() * sizeof(FileEntry)) &&
+                            writeAll(fd, fileDependencies.data(), fileDependencies.size() * sizeof(FileDependency)) &&
+                            writeAll(fd, stringTable.data().data(), stringTable.data().size());
+
+                        if (::close(fd) != 0 || !success || rename(tempPath.c_str(), path.c_str()) != 0) {
+                            unlink(tempPath.c_str());
+                            return false;
+                        }
+
+                        return true;
+                    }
+            };
+
+            DependencyCache::DependencyCache(const bf::path& path, const std::string& environmentKey) {
+                d = new PrivateData(path, environmentKey);
+            }
+
+            DependencyCache::~DependencyCache() {
+                delete d;
+            }
+
+            bf::path DependencyCache::getDefaultPath() {
+                bf::path cacheDir;
+
+                const auto* xdgCacheHome = getenv("XDG_CACHE_HOME");
+                const auto* home = getenv("HOME");
+
+                if (xdgCacheHome != nullptr && xdgCacheHome[0] != '\0') {
+                    cacheDir = xdgCacheHome;
+                } else if (home != nullptr && home[0] != '\0') {
+                    cacheDir = bf::path(home) / ".cache";
+                } else {
+                    return {};
+                }
+
+                return cacheDir / "linuxdeploy" / "dependencies.cache";
+            }
+
+            bool DependencyCache::lookup(const bf::path& path, CachedFile& cachedFile) const {
+                const auto canonicalPath = dependency_cache::canonicalPath(path);
+
+                Record record;
+                bool found;
+
+                {
+                    std::lock_guard<std::mutex> lock(d->mutex);
+                    found = d->findRecord(canonicalPath, record);
+                }
+
+                // the files are checked without holding the lock, which allows other threads to use the cache
+                // in the meantime
+                auto isUpToDate = [&canonicalPath, &record]() {
+                    FileIdentity identity{};
+
+                    if (!getIdentity(canonicalPath, identity) || identity != record.identity)
+                        return false;
+
+                    for (const auto& dependency : record.dependencies) {
+                        if (!getIdentity(dependency.first, identity) || identity != dependency.second)
+                            return false;
+                    }
+
+                    return true;
+                };
+
+                found = found && isUpToDate();
+
+                {
+                    std::lock_guard<std::mutex> lock(d->mutex);
+
+                    if (found)
+                        ++d->hits;
+                    else
+                        ++d->misses;
+                }
+
+                if (!found)
+                    return false;
+
+                cachedFile.rpath = record.rpath;
+                cachedFile.hasDependencies = (record.flags & FLAG_HAS_DEPENDENCIES) != 0;
+                cachedFile.dependencies.clear();
+
+                for (const auto& dependency : record.dependencies)
+                    cachedFile.dependencies.emplace_back(dependency.first);
+
+                return true;
+            }
+
+            void DependencyCache::insert(const bf::path& path, const CachedFile& cachedFile) {
+                const auto canonicalPath = dependency_cache::canonicalPath(path);
+
+                Record record;
+
+                if (!getIdentity(canonicalPath, record.identity))
+                    return;
+
+                record.flags = cachedFile.hasDependencies ? FLAG_HAS_DEPENDENCIES : 0;
+                record.rpath = cachedFile.rpath;
+
+                for (const auto& dependency : cachedFile.dependencies) {
+                    FileIdentity identity{};
+
+                    if (!getIdentity(dependency.string(), identity))
+                        return;
+
+                    record.dependencies.emplace_back(dependency.string(), identity);
+                }
+
+                std::lock_guard<std::mutex> lock(d->mutex);
+
+                // don't lose the dependencies of an existing entry when only the rpath is stored
+                if (!cachedFile.hasDependencies) {
+                    Record existingRecord;
+
+                    if (d->findRecord(canonicalPath, existingRecord) && existingRecord.identity == record.identity &&
+                        (existingRecord.flags & FLAG_HAS_DEPENDENCIES) != 0) {
+                        record.flags = existingRecord.flags;
+                        record.dependencies = existingRecord.dependencies;
+                    }
+                }
+
+                d->pendingRecords[canonicalPath] = std::move(record);
+            }
+
+            bool DependencyCache::save() {
+                std::lock_guard<std::mutex> lock(d->mutex);
+
+                if (d->pendingRecords.empty())
+                    return true;
+
+                boost::system::error_code ec;
+                bf::create_directories(d->path.parent_path(), ec);
+
+                if (ec) {
+                    ldLog() << LD_DEBUG << "Could not create dependency cache directory:" << d->path.parent_path() << std::endl;
+                    return false;
+                }
+
+                // other processes might be saving their entries at the same time, the lock ensures that none of them
+                // are lost
+                const auto lockPath = d->path.string() + ".lock";
+                const int lockFd = open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+                if (lockFd < 0) {
+                    ldLog() << LD_DEBUG << "Could not open dependency cache lock file:" << lockPath << std::endl;
+                    return false;
+                }
+
+                while (flock(lockFd, LOCK_EX) != 0) {
+                    if (errno != EINTR) {
+                        ::close(lockFd);
+                        ldLog() << LD_DEBUG << "Could not lock dependency cache:" << lockPath << std::endl;
+                        return false;
+                    }
+                }
+
+                // the file might have been replaced by another process since it has been mapped
+                d->unmap();
+                d->map();
+
+                auto records = d->readAllRecords();
+
+                for (const auto& pair : d->pendingRecords)
+                    records[pair.first] = pair.second;
+
+                // drop the entries of files which have been changed or removed, otherwise the cache would grow forever
+                for (auto it = records.begin(); it != records.end();) {
+                    FileIdentity identity{};
+
+                    if (!getIdentity(it->first, identity) || identity != it->second.identity)
+                        it = records.erase(it);
+                    else
+                        ++it;
+                }
+
+                const auto success = d->writeRecords(records);
+
+                if (success) {
+                    d->pendingRecords.clear();
+                    d->unmap();
+                    d->map();
+                } else {
+                    ldLog() << LD_DEBUG << "Could not write dependency cache:" << d->path << std::endl;
+                }
+
+                flock(lockFd, LOCK_UN);
+                ::close(lockFd);
+
+                return success;
+            }
+
+            size_t DependencyCache::size() const {
+                std::lock_guard<std::mutex> lock(d->mutex);
+
+                size_t size = d->pendingRecords.size();
+
+                if (d->header != nullptr) {
+                    for (uint32_t i = 0; i < d->header->entriesCount; ++i) {
+                        if (d->entries[i].path >= d->header->stringsSize)
+                            continue;
+
+                        // entries which have been replaced must not be counted twice
+                        if (d->pendingRecords.count(d->strings + d->entries[i].path) == 0)
+                            ++size;
+                    }
+                }
+
+                return size;
+            }
+
+            size_t DependencyCache::getHits() const {
+                std::lock_guard<std::mutex> lock(d->mutex);
+                return d->hits;
+            }
+
+            size_t DependencyCache::getMisses() const {
+                std::lock_guard<std::mutex> lock(d->mutex);
+                return d->misses;
+            }
+        }
+    }
+}
@@ -1,15 +1,31 @@
 // system includes
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
 #include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <utility>
 #include <fcntl.h>
+#include <fnmatch.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // library includes
 #include <boost/regex.hpp>
+#include <boost/utility/string_ref.hpp>
 #include <sys/mman.h>
 
 // local headers
+#include "linuxdeploy/core/dependency_cache.h"
 #include "linuxdeploy/core/elf_file.h"
+#include "linuxdeploy/core/ld_so_cache.h"
 #include "linuxdeploy/core/log.h"
 #include "linuxdeploy/util/util.h"
 #include "linuxdeploy/subprocess/subprocess.h"
@@ -21,142 +37,2358 @@ namespace bf = boost::filesystem;
 namespace linuxdeploy {
     namespace core {
         namespace elf_file {
-            class ElfFile::PrivateData {
-                public:
-                    const bf::path path;
+            namespace {
+                // everything we read from the file while parsing it
+                // kept separate from the path so that it can be shared between all paths pointing to the same file
+                struct ParsedElfData {
                     uint8_t elfClass = ELFCLASSNONE;
                     uint8_t elfABI = 0;
+                    uint8_t elfData = ELFDATANONE;
+                    uint16_t elfMachine = EM_NONE;
                     bool isDebugSymbolsFile = false;
                     bool isDynamicallyLinked = false;
 
-                public:
-                    explicit PrivateData(bf::path path) : path(std::move(path)) {}
+                    // read from the program headers
+                    std::string interpreter;
+
+                    // contents of the dynamic section, read on demand by readDynamicSection()
+                    // used by the native dependency resolver and the rpath editor
+                    bool dynamicSectionRead = false;
+                    std::string soname;
+                    std::vector<std::string> neededLibraries;
+                    std::string rpath;
+                    std::string runpath;
+                    bool hasRunpath = false;
+                };
+
+                // process-wide cache of parsed ELF files
+                // files are identified by device and inode number, modification time and size, therefore all paths
+                // (including symlinks) resolving to the same file share an entry, and modified files are parsed again
+                class ParseCache {
+                    private:
+                        struct Entry {
+                            struct timespec mtime;
+                            off_t size;
+                            ParsedElfData data;
+                        };
+
+                        std::mutex mutex;
+                        std::map<std::pair<dev_t, ino_t>, Entry> entries;
+                        size_t hits = 0;
+                        size_t misses = 0;
+
+                        static bool stat(const bf::path& path, struct stat& st) {
+                            return ::stat(path.c_str(), &st) == 0;
+                        }
+
+                    public:
+                        static ParseCache& getInstance() {
+                            static ParseCache instance;
+                            return instance;
+                        }
+
+                        // copies cached data into target if the file has been parsed before and has not been modified since
+                        bool lookup(const struct stat& st, ParsedElfData& target) {
+                            std::lock_guard<std::mutex> lock(mutex);
+
+                            const auto it = entries.find(std::make_pair(st.st_dev, st.st_ino));
+
+                            if (it != entries.end() &&
+                                it->second.mtime.tv_sec == st.st_mtim.tv_sec &&
+                                it->second.mtime.tv_nsec == st.st_mtim.tv_nsec &&
+                                it->second.size == st.st_size) {
+                                target = it->second.data;
+                                ++hits;
+                                return true;
+                            }
+
+                            ++misses;
+                            return false;
+                        }
+
+                        void insert(const struct stat& st, const ParsedElfData& data) {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            entries[std::make_pair(st.st_dev, st.st_ino)] = Entry{st.st_mtim, st.st_size, data};
+                        }
+
+                        void insert(const bf::path& path, const ParsedElfData& data) {
+                            struct stat st{};
+
+                            if (stat(path, st))
+                                insert(st, data);
+                        }
+
+                        void invalidate(const bf::path& path) {
+                            struct stat st{};
+
+                            if (!stat(path, st))
+                                return;
+
+                            std::lock_guard<std::mutex> lock(mutex);
+                            entries.erase(std::make_pair(st.st_dev, st.st_ino));
+                        }
+
+                        void clear() {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            entries.clear();
+                            hits = 0;
+                            misses = 0;
+                        }
+
+                        size_t getHits() {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            return hits;
+                        }
+
+                        size_t getMisses() {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            return misses;
+                        }
+                };
+
+                // ELF files are stored in the byte order of their target architecture
+                // we read the structures as they are, and convert them to the host's byte order afterwards
+                // for files in the host's byte order, the conversion is a no-op and is optimized away completely
+                struct HostByteOrder {
+                    template<typename T>
+                    static void toHost(T&) {}
+
+                    template<typename T>
+                    static void toFile(T&) {}
+                };
+
+                // used for files in the other byte order, e.g., big endian files on little endian hosts
+                struct ForeignByteOrder {
+                    private:
+                        template<typename T>
+                        static void swap(T& value) {
+                            auto* bytes = reinterpret_cast<uint8_t*>(&value);
+                            std::reverse(bytes, bytes + sizeof(T));
+                        }
+
+                        template<typename Ehdr_T>
+                        static void swapEhdr(Ehdr_T& ehdr) {
+                            swap(ehdr.e_type);
+                            swap(ehdr.e_machine);
+                            swap(ehdr.e_version);
+                            swap(ehdr.e_entry);
+                            swap(ehdr.e_phoff);
+                            swap(ehdr.e_shoff);
+                            swap(ehdr.e_flags);
+                            swap(ehdr.e_ehsize);
+                            swap(ehdr.e_phentsize);
+                            swap(ehdr.e_phnum);
+                            swap(ehdr.e_shentsize);
+                            swap(ehdr.e_shnum);
+                            swap(ehdr.e_shstrndx);
+                        }
+
+                        template<typename Phdr_T>
+                        static void swapPhdr(Phdr_T& phdr) {
+                            swap(phdr.p_type);
+                            swap(phdr.p_flags);
+                            swap(phdr.p_offset);
+                            swap(phdr.p_vaddr);
+                            swap(phdr.p_paddr);
+                            swap(phdr.p_filesz);
+                            swap(phdr.p_memsz);
+                            swap(phdr.p_align);
+                        }
+
+                        template<typename Shdr_T>
+                        static void swapShdr(Shdr_T& shdr) {
+                            swap(shdr.sh_name);
+                            swap(shdr.sh_type);
+                            swap(shdr.sh_flags);
+                            swap(shdr.sh_addr);
+                            swap(shdr.sh_offset);
+                            swap(shdr.sh_size);
+                            swap(shdr.sh_link);
+                            swap(shdr.sh_info);
+                            swap(shdr.sh_addralign);
+                            swap(shdr.sh_entsize);
+                        }
+
+                        template<typename Dyn_T>
+                        static void swapDyn(Dyn_T& dyn) {
+                            swap(dyn.d_tag);
+                            swap(dyn.d_un.d_val);
+                        }
+
+                    public:
+                        static void toHost(Elf32_Ehdr& ehdr) { swapEhdr(ehdr); }
+                        static void toHost(Elf64_Ehdr& ehdr) { swapEhdr(ehdr); }
+                        static void toHost(Elf32_Phdr& phdr) { swapPhdr(phdr); }
+                        static void toHost(Elf64_Phdr& phdr) { swapPhdr(phdr); }
+                        static void toHost(Elf32_Shdr& shdr) { swapShdr(shdr); }
+                        static void toHost(Elf64_Shdr& shdr) { swapShdr(shdr); }
+                        static void toHost(Elf32_Dyn& dyn) { swapDyn(dyn); }
+                        static void toHost(Elf64_Dyn& dyn) { swapDyn(dyn); }
+
+                        // swapping is symmetric
+                        template<typename T>
+                        static void toFile(T& value) {
+                            toHost(value);
+                        }
+                };
+
+                // reads parts of a file at arbitrary offsets using pread()
+                // this way, we only have to read the few bytes we're interested in, which makes a big difference
+                // when probing large libraries
+                class ElfFileReader {
+                    private:
+                        const bf::path& path;
+                        int fd;
+                        struct stat st{};
+
+                    public:
+                        explicit ElfFileReader(const bf::path& path) : path(path), fd(open(path.c_str(), O_RDONLY | O_CLOEXEC)) {
+                            if (fd < 0)
+                                throw ElfFileParseError("Could not open file: " + path.string());
+
+                            if (fstat(fd, &st) != 0) {
+                                close(fd);
+                                throw ElfFileParseError("Could not stat file: " + path.string());
+                            }
+                        }
+
+                        ~ElfFileReader() {
+                            close(fd);
+                        }
+
+                        ElfFileReader(const ElfFileReader&) = delete;
+                        ElfFileReader& operator=(const ElfFileReader&) = delete;
+
+                    public:
+                        const struct stat& stat() const {
+                            return st;
+                        }
+
+                        uint64_t size() const {
+                            return static_cast<uint64_t>(st.st_size);
+                        }
+
+                        // read up to size bytes, returns the amount of bytes actually read
+                        size_t readSome(uint64_t offset, void* buffer, size_t size) const {
+                            size_t bytesRead = 0;
+
+                            while (bytesRead < size) {
+                                const auto result = pread(fd, static_cast<char*>(buffer) + bytesRead, size - bytesRead, offset + bytesRead);
+
+                                if (result < 0 && errno == EINTR)
+                                    continue;
+
+                                if (result <= 0)
+                                    break;
+
+                                bytesRead += result;
+                            }
+
+                            return bytesRead;
+                        }
+
+                        void read(uint64_t offset, void* buffer, size_t size) const {
+                            if (readSome(offset, buffer, size) != size)
+                                throw ElfFileParseError("Unexpected end of file: " + path.string());
+                        }
+
+                        // read a null-terminated string of at most maxSize bytes
+                        std::string readString(uint64_t offset, uint64_t maxSize) const {
+                            std::string result;
+                            char buffer[256];
+
+                            while (maxSize > 0) {
+                                const auto bytesRead = readSome(offset, buffer, std::min<uint64_t>(maxSize, sizeof(buffer)));
+
+                                if (bytesRead == 0)
+                                    break;
+
+                                const auto length = strnlen(buffer, bytesRead);
+                                result.append(buffer, length);
+
+                                if (length < bytesRead)
+                                    break;
+
+                                offset += bytesRead;
+                                maxSize -= bytesRead;
+                            }
+
+                            return result;
+                        }
+
+                        // read an ELF structure and convert it to the host's byte order
+                        template<typename ByteOrder_T, typename T>
+                        void readStruct(uint64_t offset, T& value) const {
+                            read(offset, &value, sizeof(T));
+                            ByteOrder_T::toHost(value);
+                        }
+
+                        // call callback for every entry of a table of count entries of type T
+                        // the entries are read in batches into a buffer on the stack
+                        // iteration stops as soon as callback returns false
+                        template<typename ByteOrder_T, typename T, typename Callback>
+                        void forEachTableEntry(uint64_t offset, uint64_t count, Callback callback) const {
+                            T buffer[32];
+
+                            for (uint64_t i = 0; i < count; i += 32) {
+                                const auto batchSize = std::min<uint64_t>(count - i, 32);
+
+                                read(offset + i * sizeof(T), buffer, batchSize * sizeof(T));
+
+                                for (uint64_t j = 0; j < batchSize; ++j) {
+                                    ByteOrder_T::toHost(buffer[j]);
+
+                                    if (!callback(buffer[j]))
+                                        return;
+                                }
+                            }
+                        }
+                };
+            }
+
+            class ElfFile::PrivateData : public ParsedElfData {
+                public:
+                    const bf::path path;
+
+                public:
+                    explicit PrivateData(bf::path path) : path(std::move(path)) {}
+
+                public:
+                    static std::string getPatchelfPath() {
+                        // by default, try to use a patchelf next to the linuxdeploy binary
+                        // if that isn't available, fall back to searching for patchelf in the PATH
+                        std::string patchelfPath;
+
+                        const auto envPatchelf = getenv("PATCHELF");
+
+                        // allows users to use a custom patchelf instead of the bundled one
+                        if (envPatchelf != nullptr) {
+                            ldLog() << LD_DEBUG << "Using patchelf specified in $PATCHELF:" << envPatchelf << std::endl;
+                            patchelfPath = envPatchelf;
+                        } else {
+                            auto binDirPath = bf::path(util::getOwnExecutablePath());
+                            auto localPatchelfPath = binDirPath.parent_path() / "patchelf";
+
+                            if (bf::exists(localPatchelfPath)) {
+                                patchelfPath = localPatchelfPath.string();
+                            } else {
+                                for (const bf::path directory : util::split(getenv("PATH"), ':')) {
+                                    if (!bf::is_directory(directory))
+                                        continue;
+
+                                    auto path = directory / "patchelf";
+
+                                    if (bf::is_regular_file(path)) {
+                                        patchelfPath = path.string();
+                                        break;
+                                    }
+                                }
+                            }
+                        }
+
+                        if (!bf::is_regular_file(patchelfPath)) {
+                            ldLog() << LD_ERROR << "Could not find patchelf: no such file:" << patchelfPath << std::endl;
+                            throw std::runtime_error("Could not find patchelf");
+                        }
+
+                        ldLog() << LD_DEBUG << "Using patchelf:" << patchelfPath << std::endl;
+                        return patchelfPath;
+                    }
+
+                private:
+                    template<typename Ehdr_T, typename Shdr_T, typename Phdr_T, typename ByteOrder_T>
+                    void probeElfHeader(const ElfFileReader& reader) {
+                        Ehdr_T ehdr{};
+                        reader.readStruct<ByteOrder_T>(0, ehdr);
+
+                        elfABI = ehdr.e_ident[EI_OSABI];
+                        elfMachine = ehdr.e_machine;
+
+                        // https://stackoverflow.com/a/7298931
+                        reader.template forEachTableEntry<ByteOrder_T, Phdr_T>(ehdr.e_phoff, ehdr.e_phnum, [this, &reader](const Phdr_T& phdr) {
+                            switch (phdr.p_type) {
+                                case PT_DYNAMIC:
+                                    isDynamicallyLinked = true;
+                                    break;
+                                case PT_INTERP:
+                                    isDynamicallyLinked = true;
+                                    interpreter = reader.readString(phdr.p_offset, phdr.p_filesz);
+                                    break;
+                            }
+
+                            return true;
+                        });
+
+                        if (ehdr.e_shstrndx == SHN_UNDEF || ehdr.e_shstrndx >= ehdr.e_shnum)
+                            return;
+
+                        Shdr_T stringTableSection{};
+                        reader.readStruct<ByteOrder_T>(ehdr.e_shoff + ehdr.e_shstrndx * sizeof(Shdr_T), stringTableSection);
+
+                        // the section names table is usually small enough to be read at once, otherwise we have to look
+                        // up the names one by one
+                        // we're only interested in short names, so we can safely truncate them
+                        char names[4096];
+                        const bool allNamesRead = stringTableSection.sh_size <= sizeof(names);
+
+                        if (allNamesRead)
+                            reader.read(stringTableSection.sh_offset, names, stringTableSection.sh_size);
+
+                        auto getSectionName = [&](const Shdr_T& shdr) {
+                            if (allNamesRead) {
+                                if (shdr.sh_name >= stringTableSection.sh_size)
+                                    return boost::string_ref{};
+
+                                const auto* name = names + shdr.sh_name;
+                                return boost::string_ref(name, strnlen(name, stringTableSection.sh_size - shdr.sh_name));
+                            }
+
+                            const auto bytesRead = reader.readSome(stringTableSection.sh_offset + shdr.sh_name, names, 64);
+                            return boost::string_ref(names, strnlen(names, bytesRead));
+                        };
+
+                        // this function is based on observations of the behavior of:
+                        // - strip --only-keep-debug
+                        // - objcopy --only-keep-debug
+                        reader.template forEachTableEntry<ByteOrder_T, Shdr_T>(ehdr.e_shoff, ehdr.e_shnum, [this, &getSectionName](const Shdr_T& shdr) {
+                            if (getSectionName(shdr) != ".text")
+                                return true;
+
+                            isDebugSymbolsFile = (shdr.sh_type == SHT_NOBITS);
+                            return false;
+                        });
+                    }
+
+                    template<typename Ehdr_T, typename Phdr_T, typename Dyn_T, typename ByteOrder_T>
+                    void parseDynamicSection(const ElfFileReader& reader) {
+                        Ehdr_T ehdr{};
+                        reader.readStruct<ByteOrder_T>(0, ehdr);
+
+                        Phdr_T dynamicSegment{};
+
+                        reader.template forEachTableEntry<ByteOrder_T, Phdr_T>(ehdr.e_phoff, ehdr.e_phnum, [&dynamicSegment](const Phdr_T& phdr) {
+                            if (phdr.p_type != PT_DYNAMIC)
+                                return true;
+
+                            dynamicSegment = phdr;
+                            return false;
+                        });
+
+                        if (dynamicSegment.p_offset + dynamicSegment.p_filesz > reader.size())
+                            return;
+
+                        uint64_t stringTableAddress = 0;
+                        uint64_t stringTableSize = 0;
+                        std::vector<uint64_t> neededOffsets;
+                        int64_t sonameOffset = -1, rpathOffset = -1, runpathOffset = -1;
+
+                        reader.template forEachTableEntry<ByteOrder_T, Dyn_T>(dynamicSegment.p_offset, dynamicSegment.p_filesz / sizeof(Dyn_T), [&](const Dyn_T& entry) {
+                            switch (entry.d_tag) {
+                                case DT_NULL:
+                                    return false;
+                                case DT_STRTAB:
+                                    stringTableAddress = entry.d_un.d_ptr;
+                                    break;
+                                case DT_STRSZ:
+                                    stringTableSize = entry.d_un.d_val;
+                                    break;
+                                case DT_NEEDED:
+                                    neededOffsets.emplace_back(entry.d_un.d_val);
+                                    break;
+                                case DT_SONAME:
+                                    sonameOffset = entry.d_un.d_val;
+                                    break;
+                                case DT_RPATH:
+                                    rpathOffset = entry.d_un.d_val;
+                                    break;
+                                case DT_RUNPATH:
+                                    runpathOffset = entry.d_un.d_val;
+                                    break;
+                            }
+
+                            return true;
+                        });
+
+                        if (stringTableAddress == 0)
+                            return;
+
+                        // the dynamic section references its string table by virtual address, which we need to translate
+                        // into a file offset using the loadable segments, just like the linker would map them
+                        int64_t stringTableOffset = -1;
+
+                        reader.template forEachTableEntry<ByteOrder_T, Phdr_T>(ehdr.e_phoff, ehdr.e_phnum, [&](const Phdr_T& phdr) {
+                            if (phdr.p_type != PT_LOAD || stringTableAddress < phdr.p_vaddr || stringTableAddress >= phdr.p_vaddr + phdr.p_filesz)
+                                return true;
+
+                            stringTableOffset = stringTableAddress - phdr.p_vaddr + phdr.p_offset;
+                            return false;
+                        });
+
+                        if (stringTableOffset < 0)
+                            throw ElfFileParseError("Could not map virtual address to file offset: " + std::to_string(stringTableAddress));
+
+                        if (stringTableOffset + stringTableSize > reader.size())
+                            throw ElfFileParseError("Dynamic string table exceeds file size");
+
+                        // the string table can be quite large, therefore we read only the strings we need
+                        auto getDynamicString = [&reader, stringTableOffset, stringTableSize](uint64_t offset) {
+                            if (offset >= stringTableSize)
+                                throw ElfFileParseError("Invalid offset in dynamic string table: " + std::to_string(offset));
+
+                            return reader.readString(stringTableOffset + offset, stringTableSize - offset);
+                        };
+
+                        for (const auto offset : neededOffsets)
+                            neededLibraries.emplace_back(getDynamicString(offset));
+
+                        if (sonameOffset >= 0)
+                            soname = getDynamicString(sonameOffset);
+
+                        // like the linker, we ignore DT_RPATH if DT_RUNPATH is set
+                        if (runpathOffset >= 0) {
+                            hasRunpath = true;
+                            runpath = getDynamicString(runpathOffset);
+                        } else if (rpathOffset >= 0) {
+                            rpath = getDynamicString(rpathOffset);
+                        }
+                    }
+
+                public:
+                    // read the information required to classify the file from the ELF header, the program headers and
+                    // the section headers
+                    void probe(const ElfFileReader& reader) {
+                        unsigned char ident[EI_NIDENT];
+                        const auto identSize = reader.readSome(0, ident, EI_NIDENT);
+
+                        if (identSize < SELFMAG || memcmp(ident, ELFMAG, SELFMAG) != 0)
+                            throw ElfFileParseError("Invalid magic bytes in file header");
+
+                        if (identSize < EI_NIDENT)
+                            throw ElfFileParseError("File too small to be an ELF file: " + path.string());
+
+                        // check which ELF "class" (32-bit or 64-bit) and byte order to use
+                        elfClass = ident[EI_CLASS];
+                        elfData = ident[EI_DATA];
+
+                        if (elfData != ELFDATA2LSB && elfData != ELFDATA2MSB)
+                            throw ElfFileParseError("Unknown ELF data encoding: " + std::to_string(elfData));
+
+                        const bool isHostByteOrder = elfData == ElfFile::getSystemElfEndianness();
+
+                        switch (elfClass) {
+                            case ELFCLASS32:
+                                if (isHostByteOrder)
+                                    probeElfHeader<Elf32_Ehdr, Elf32_Shdr, Elf32_Phdr, HostByteOrder>(reader);
+                                else
+                                    probeElfHeader<Elf32_Ehdr, Elf32_Shdr, Elf32_Phdr, ForeignByteOrder>(reader);
+                                break;
+                            case ELFCLASS64:
+                                if (isHostByteOrder)
+                                    probeElfHeader<Elf64_Ehdr, Elf64_Shdr, Elf64_Phdr, HostByteOrder>(reader);
+                                else
+                                    probeElfHeader<Elf64_Ehdr, Elf64_Shdr, Elf64_Phdr, ForeignByteOrder>(reader);
+                                break;
+                            default:
+                                throw ElfFileParseError("Unknown ELF class: " + std::to_string(elfClass));
+                        }
+                    }
+
+                    // the contents of the dynamic section are needed only by a few operations, therefore they are read
+                    // on demand
+                    void readDynamicSection() {
+                        if (dynamicSectionRead)
+                            return;
+
+                        // debug symbols files contain a dynamic segment, but its contents have been stripped
+                        if (!isDynamicallyLinked || isDebugSymbolsFile) {
+                            dynamicSectionRead = true;
+                            return;
+                        }
+
+                        ElfFileReader reader(path);
+
+                        const bool isHostByteOrder = elfData == ElfFile::getSystemElfEndianness();
+
+                        switch (elfClass) {
+                            case ELFCLASS32:
+                                if (isHostByteOrder)
+                                    parseDynamicSection<Elf32_Ehdr, Elf32_Phdr, Elf32_Dyn, HostByteOrder>(reader);
+                                else
+                                    parseDynamicSection<Elf32_Ehdr, Elf32_Phdr, Elf32_Dyn, ForeignByteOrder>(reader);
+                                break;
+                            case ELFCLASS64:
+                                if (isHostByteOrder)
+                                    parseDynamicSection<Elf64_Ehdr, Elf64_Phdr, Elf64_Dyn, HostByteOrder>(reader);
+                                else
+                                    parseDynamicSection<Elf64_Ehdr, Elf64_Phdr, Elf64_Dyn, ForeignByteOrder>(reader);
+                                break;
+                        }
+
+                        dynamicSectionRead = true;
+
+                        ParseCache::getInstance().insert(reader.stat(), *this);
+                    }
+
+                public:
+                    static std::vector<std::string> splitSearchPath(const std::string& searchPath) {
+                        // the linker accepts both colons and semicolons as separators
+                        std::vector<std::string> directories;
+
+                        std::string::size_type begin = 0;
+
+                        for (;;) {
+                            const auto end = searchPath.find_first_of(":;", begin);
+
+                            directories.emplace_back(searchPath.substr(begin, end - begin));
+
+                            if (end == std::string::npos)
+                                break;
+
+                            begin = end + 1;
+                        }
+
+                        return directories;
+                    }
+
+                    static std::string expandOrigin(std::string directory, const std::string& origin) {
+                        // the linker supports both $ORIGIN and ${ORIGIN}
+                        static const std::vector<std::string> tokens = {"${ORIGIN}", "$ORIGIN"};
+
+                        for (const auto& token : tokens) {
+                            for (auto pos = directory.find(token); pos != std::string::npos; pos = directory.find(token, pos + origin.size()))
+                                directory.replace(pos, token.size(), origin);
+                        }
+
+                        // empty entries refer to the current working directory
+                        if (directory.empty())
+                            directory = ".";
+
+                        // like the linker, we strip trailing slashes and append exactly one
+                        while (directory.size() > 1 && directory.back() == '/')
+                            directory.pop_back();
+
+                        if (directory.back() != '/')
+                            directory.push_back('/');
+
+                        return directory;
+                    }
+
+                    static std::vector<std::string> getDefaultLibraryDirectories(uint8_t elfClass, uint16_t elfMachine) {
+                        std::vector<std::string> directories;
+
+                        // Debian and derivatives use multiarch directories
+                        std::string multiarchTriplet;
+
+                        switch (elfMachine) {
+                            case EM_X86_64:
+                                multiarchTriplet = (elfClass == ELFCLASS64) ? "x86_64-linux-gnu" : "x86_64-linux-gnux32";
+                                break;
+                            case EM_386:
+                                multiarchTriplet = "i386-linux-gnu";
+                                break;
+                            case EM_AARCH64:
+                                multiarchTriplet = "aarch64-linux-gnu";
+                                break;
+                            case EM_ARM:
+                                multiarchTriplet = "arm-linux-gnueabihf";
+                                break;
+                        }
+
+                        if (!multiarchTriplet.empty()) {
+                            directories.emplace_back("/lib/" + multiarchTriplet + "/");
+                            directories.emplace_back("/usr/lib/" + multiarchTriplet + "/");
+                        }
+
+                        // RPM based distributions store 64-bit libraries in separate directories
+                        if (elfClass == ELFCLASS64) {
+                            directories.emplace_back("/lib64/");
+                            directories.emplace_back("/usr/lib64/");
+                        }
+
+                        directories.emplace_back("/lib/");
+                        directories.emplace_back("/usr/lib/");
+
+                        return directories;
+                    }
+
+                    // checks whether a library could be loaded into the same process as the requesting file
+                    // the linker skips incompatible files while searching, e.g., 32-bit libraries in a 64-bit process
+                    bool isCompatibleLibrary(const bf::path& libraryPath) const {
+                        const int fd = open(libraryPath.c_str(), O_RDONLY | O_CLOEXEC);
+
+                        if (fd < 0)
+                            return false;
+
+                        // the fields we're interested in are at the same offsets in both 32-bit and 64-bit headers
+                        Elf32_Ehdr ehdr{};
+                        const auto bytesRead = pread(fd, &ehdr, sizeof(ehdr), 0);
+                        close(fd);
+
+                        if (bytesRead != sizeof(ehdr) || strncmp(reinterpret_cast<char*>(ehdr.e_ident), ELFMAG, SELFMAG) != 0)
+                            return false;
+
+                        if (ehdr.e_ident[EI_CLASS] != elfClass || ehdr.e_ident[EI_DATA] != elfData)
+                            return false;
+
+                        if (elfData != ElfFile::getSystemElfEndianness())
+                            ForeignByteOrder::toHost(ehdr);
+
+                        return ehdr.e_machine == elfMachine && ehdr.e_type == ET_DYN;
+                    }
+
+                    static bool isDynamicLoader(const std::string& name, const std::string& interpreter) {
+                        // the interpreter is loaded before any of the libraries, and therefore never shows up as a
+                        // dependency in ldd's output
+                        // when tracing libraries, there's no PT_INTERP, so we have to recognize the common loaders by
+                        // their names
+                        if (!interpreter.empty() && bf::path(interpreter).filename().string() == name)
+                            return true;
+
+                        for (const auto& pattern : {"ld-linux*.so*", "ld64.so.*", "ld.so.*", "ld-musl-*.so*"}) {
+                            if (fnmatch(pattern, name.c_str(), 0) == 0)
+                                return true;
+                        }
+
+                        return false;
+                    }
+
+                    // resolves the dependencies of this file the way the linker does
+                    // the result is the transitive closure in breadth first order, just like ldd would print it
+                    // if a pool is passed, the libraries are searched and parsed in parallel
+                    std::vector<bf::path> traceDynamicDependenciesNatively(util::thread_pool::ThreadPool* pool = nullptr) {
+                        if (!isDynamicallyLinked) {
+                            ldLog() << LD_WARNING << path << "is not linked dynamically" << std::endl;
+                            return {};
+                        }
+
+                        // like the linker, we keep a list of the objects in the order they're loaded
+                        // every object references the object which caused it to be loaded first, which is required
+                        // to implement DT_RPATH inheritance
+                        struct LoadedObject {
+                            std::string path;
+                            std::shared_ptr<ElfFile> elfFile;
+                            int loader;
+                        };
+
+                        std::vector<LoadedObject> loadedObjects;
+
+                        // names under which objects can be referenced (paths, DT_NEEDED names and sonames)
+                        std::set<std::string> loadedNames;
+                        // files can be referenced under different names, we identify them by their inode, too
+                        std::set<std::pair<dev_t, ino_t>> loadedFiles;
+
+                        auto markAsLoaded = [&loadedFiles](const std::string& path) {
+                            struct stat st{};
+
+                            if (stat(path.c_str(), &st) != 0)
+                                return true;
+
+                            return loadedFiles.emplace(st.st_dev, st.st_ino).second;
+                        };
+
+                        // work around the same ldd bug we work around in traceDynamicDependenciesUsingLdd(), i.e.,
+                        // make sure $ORIGIN is expanded consistently
+                        const auto resolvedPath = bf::canonical(path).string();
+                        const auto rootOrigin = bf::path(resolvedPath).parent_path().string();
+
+                        markAsLoaded(resolvedPath);
+                        loadedNames.insert(resolvedPath);
+
+                        // we can't use our own instance in the list, therefore we need to parse the file once more
+                        loadedObjects.push_back({resolvedPath, std::make_shared<ElfFile>(resolvedPath), -1});
+                        loadedObjects.back().elfFile->d->readDynamicSection();
+
+                        std::vector<std::string> libraryPathDirectories;
+                        {
+                            const auto* ldLibraryPath = getenv("LD_LIBRARY_PATH");
+
+                            if (ldLibraryPath != nullptr && ldLibraryPath[0] != '\0') {
+                                for (const auto& directory : splitSearchPath(ldLibraryPath))
+                                    libraryPathDirectories.emplace_back(expandOrigin(directory, rootOrigin));
+                            }
+                        }
+
+                        const auto ldSoCache = ld_so_cache::LdSoCache::getInstance();
+                        const auto defaultDirectories = getDefaultLibraryDirectories(elfClass, elfMachine);
+
+                        // since glibc 2.33, the linker searches the glibc-hwcaps subdirectories supported by the host
+                        // in order of priority before every directory in the search path itself
+                        const auto hwcapsSubdirectories = ld_so_cache::getGlibcHwcapsSubdirectories(elfClass, elfMachine);
+
+                        auto searchInDirectories = [this, &hwcapsSubdirectories](const std::vector<std::string>& directories, const std::string& name) {
+                            for (const auto& directory : directories) {
+                                for (const auto& subdirectory : hwcapsSubdirectories) {
+                                    const auto candidate = directory + "glibc-hwcaps/" + subdirectory + "/" + name;
+
+                                    if (isCompatibleLibrary(candidate))
+                                        return candidate;
+                                }
+
+                                const auto candidate = directory + name;
+
+                                if (isCompatibleLibrary(candidate))
+                                    return candidate;
+                            }
+
+                            return std::string{};
+                        };
+
+                        auto originOf = [](const std::string& objectPath) {
+                            return bf::path(objectPath).parent_path().string();
+                        };
+
+                        auto expandSearchPath = [](const std::string& searchPath, const std::string& origin) {
+                            std::vector<std::string> directories;
+
+                            for (const auto& directory : splitSearchPath(searchPath))
+                                directories.emplace_back(expandOrigin(directory, origin));
+
+                            return directories;
+                        };
+
+                        auto findLibrary = [&](const std::string& name, int loaderIndex) -> std::string {
+                            // names containing a slash are used as paths
+                            if (name.find('/') != std::string::npos)
+                                return isCompatibleLibrary(name) ? name : std::string{};
+
+                            const auto& loader = loadedObjects[loaderIndex];
+                            const auto* loaderData = loader.elfFile->d;
+
+                            std::string result;
+
+                            // the DT_RPATH of the loader, the loader's loader etc. is searched unless the loader has a
+                            // DT_RUNPATH
+                            if (!loaderData->hasRunpath) {
+                                for (int i = loaderIndex; i >= 0 && result.empty(); i = loadedObjects[i].loader) {
+                                    const auto* objectData = loadedObjects[i].elfFile->d;
+
+                                    if (objectData->hasRunpath || objectData->rpath.empty())
+                                        continue;
+
+                                    result = searchInDirectories(expandSearchPath(objectData->rpath, originOf(loadedObjects[i].path)), name);
+                                }
+                            }
+
+                            if (result.empty())
+                                result = searchInDirectories(libraryPathDirectories, name);
+
+                            if (result.empty() && loaderData->hasRunpath)
+                                result = searchInDirectories(expandSearchPath(loaderData->runpath, originOf(loader.path)), name);
+
+                            // the linker's cache is consulted before falling back to the default directories
+                            if (result.empty() && ldSoCache != nullptr) {
+                                const auto* cachedPath = ldSoCache->lookup(name.c_str(), elfClass, elfMachine);
+
+                                if (cachedPath != nullptr && isCompatibleLibrary(cachedPath))
+                                    result = cachedPath;
+                            }
+
+                            if (result.empty())
+                                result = searchInDirectories(defaultDirectories, name);
+
+                            return result;
+                        };
+
+                        std::vector<bf::path> paths;
+
+                        // libraries found for a DT_NEEDED entry
+                        struct Candidate {
+                            std::string path;
+                            std::shared_ptr<ElfFile> elfFile;
+                            std::exception_ptr error;
+                        };
+
+                        // breadth first search, like the linker
+                        // the objects are processed level by level: first, the libraries needed by all objects on the
+                        // current level are searched and parsed, which can be done in parallel, then they are added to
+                        // the list in the same order the linker would load them
+                        for (size_t levelBegin = 0; levelBegin < loadedObjects.size();) {
+                            const auto levelEnd = loadedObjects.size();
+
+                            std::vector<std::vector<Candidate>> candidates(levelEnd - levelBegin);
+                            std::vector<std::function<void()>> tasks;
+
+                            for (size_t i = levelBegin; i < levelEnd; ++i) {
+                                const auto& neededLibraries = loadedObjects[i].elfFile->d->neededLibraries;
+                                auto& objectCandidates = candidates[i - levelBegin];
+                                objectCandidates.resize(neededLibraries.size());
+
+                                for (size_t j = 0; j < neededLibraries.size(); ++j) {
+                                    const auto& neededLibrary = neededLibraries[j];
+
+                                    // there's no need to search for libraries which have been loaded on previous levels
+                                    if (loadedNames.find(neededLibrary) != loadedNames.end() || isDynamicLoader(neededLibrary, interpreter))
+                                        continue;
+
+                                    auto& candidate = objectCandidates[j];
+
+                                    tasks.emplace_back([&candidate, &neededLibrary, &findLibrary, i]() {
+                                        try {
+                                            candidate.path = findLibrary(neededLibrary, static_cast<int>(i));
+
+                                            if (!candidate.path.empty()) {
+                                                candidate.elfFile = std::make_shared<ElfFile>(candidate.path);
+                                                candidate.elfFile->d->readDynamicSection();
+                                            }
+                                        } catch (...) {
+                                            // the error is relevant only if the library is actually loaded
+                                            candidate.error = std::current_exception();
+                                        }
+                                    });
+                                }
+                            }
+
+                            if (pool != nullptr) {
+                                pool->run(tasks);
+                            } else {
+                                for (const auto& task : tasks)
+                                    task();
+                            }
+
+                            for (size_t i = levelBegin; i < levelEnd; ++i) {
+                                const auto& neededLibraries = loadedObjects[i].elfFile->d->neededLibraries;
+
+                                for (size_t j = 0; j < neededLibraries.size(); ++j) {
+                                    const auto& neededLibrary = neededLibraries[j];
+
+                                    if (loadedNames.find(neededLibrary) != loadedNames.end())
+                                        continue;
+
+                                    if (isDynamicLoader(neededLibrary, interpreter))
+                                        continue;
+
+                                    const auto& candidate = candidates[i - levelBegin][j];
+
+                                    if (candidate.error)
+                                        std::rethrow_exception(candidate.error);
+
+                                    const auto& libraryPath = candidate.path;
+
+                                    if (libraryPath.empty())
+                                        throw DependencyNotFoundError("Could not find dependency: " + neededLibrary);
+
+                                    loadedNames.insert(neededLibrary);
+
+                                    if (loadedNames.find(libraryPath) != loadedNames.end() || !markAsLoaded(libraryPath))
+                                        continue;
+
+                                    loadedNames.insert(libraryPath);
+
+                                    if (!candidate.elfFile->d->soname.empty())
+                                        loadedNames.insert(candidate.elfFile->d->soname);
+
+                                    loadedObjects.push_back({libraryPath, candidate.elfFile, static_cast<int>(i)});
+                                    paths.emplace_back(bf::absolute(libraryPath));
+                                }
+                            }
+
+                            levelBegin = levelEnd;
+                        }
+
+                        return paths;
+                    }
+
+                    std::vector<bf::path> traceDynamicDependencies(util::thread_pool::ThreadPool& pool) {
+                        // this method's purpose is to abstract this process
+                        // the caller doesn't care _how_ it's done, after all
+
+                        if (getDependencyResolver() == LDD_RESOLVER)
+                            return traceDynamicDependenciesUsingLdd();
+
+                        // the native resolver does not know every single configuration option the system's linker
+                        // supports
+                        // therefore, if it can't find a library, we let ldd have a go before giving up
+                        try {
+                            return traceDynamicDependenciesNatively(&pool);
+                        } catch (const DependencyNotFoundError& e) {
+                            ldLog() << LD_DEBUG << e.what() << LD_NO_SPACE << ", falling back to ldd" << std::endl;
+                        }
+
+                        return traceDynamicDependenciesUsingLdd();
+                    }
+
+                    // the persistent cache is keyed by path, therefore the files don't have to be parsed to look
+                    // them up
+                    static bool lookUpDependenciesInCache(const bf::path& path, std::vector<bf::path>& dependencies) {
+                        const auto dependencyCache = getDependencyCache();
+                        dependency_cache::CachedFile cachedFile;
+
+                        if (dependencyCache == nullptr || !dependencyCache->lookup(path, cachedFile) || !cachedFile.hasDependencies)
+                            return false;
+
+                        dependencies = std::move(cachedFile.dependencies);
+                        return true;
+                    }
+
+                    static void storeDependenciesInCache(const bf::path& path, const std::vector<bf::path>& dependencies) {
+                        const auto dependencyCache = getDependencyCache();
+
+                        if (dependencyCache == nullptr)
+                            return;
+
+                        dependency_cache::CachedFile cachedFile;
+                        cachedFile.hasDependencies = true;
+                        cachedFile.dependencies = dependencies;
+
+                        try {
+                            cachedFile.rpath = ElfFile(path).d->getRPathNatively();
+                        } catch (const ElfFileParseError&) {
+                            // ldd may have been used for files we can't parse
+                            return;
+                        }
+
+                        dependencyCache->insert(path, cachedFile);
+                    }
+
+                    std::vector<bf::path> traceDynamicDependenciesUsingLdd() {
+                        const auto result = traceDynamicDependenciesUsingLdd({path})[path];
+
+                        if (!result.error.empty())
+                            throw DependencyNotFoundError(result.error);
+
+                        return result.dependencies;
+                    }
+
+                    // this is the same ldd based method linuxdeployqt uses
+                    // ldd accepts multiple files, and prints a section for each of them, therefore we can trace many
+                    // files with a few calls
+                    static std::map<bf::path, DependencyTraceResult> traceDynamicDependenciesUsingLdd(const std::vector<bf::path>& paths) {
+                        std::map<bf::path, DependencyTraceResult> results;
+
+                        // workaround for https://sourceware.org/bugzilla/show_bug.cgi?id=25263
+                        // when you pass an absolute path to ldd, it can find libraries referenced in the rpath properly
+                        // this bug was first found when trying to find a library next to the binary which contained $ORIGIN
+                        // note that this is just a bug in ldd, the linker has always worked as intended
+                        // ldd prints the paths we pass in the section headers, so we need to map them back to the
+                        // callers' paths
+                        std::map<std::string, std::vector<bf::path>> pathsByResolvedPath;
+
+                        for (const auto& path : paths) {
+                            boost::system::error_code ec;
+                            const auto resolvedPath = bf::canonical(path, ec);
+
+                            // ldd would fail on such files anyway
+                            if (ec) {
+                                results[path].error = "Failed to resolve path " + path.string() + ": " + ec.message();
+                                continue;
+                            }
+
+                            results[path];
+                            pathsByResolvedPath[resolvedPath.string()].emplace_back(path);
+                        }
+
+                        std::vector<std::string> resolvedPaths;
+
+                        for (const auto& entry : pathsByResolvedPath)
+                            resolvedPaths.emplace_back(entry.first);
+
+                        for (const auto& chunk : splitArguments(resolvedPaths)) {
+                            for (const auto& chunkResult : runLdd(chunk)) {
+                                for (const auto& path : pathsByResolvedPath[chunkResult.first])
+                                    results[path] = chunkResult.second;
+                            }
+                        }
+
+                        return results;
+                    }
+
+                    // splits arguments into chunks which can be passed to a single process
+                    // the arguments must fit into the kernel's limit, which also includes the environment, so we just
+                    // use half of it
+                    static std::vector<std::vector<std::string>> splitArguments(const std::vector<std::string>& arguments) {
+                        const auto argMax = sysconf(_SC_ARG_MAX);
+                        const size_t maxArgsSize = (argMax > 0 ? static_cast<size_t>(argMax) : 131072) / 2;
+
+                        std::vector<std::vector<std::string>> chunks;
+                        size_t chunkSize = 0;
+
+                        for (const auto& argument : arguments) {
+                            const auto argSize = argument.size() + 1 + sizeof(char*);
+
+                            if (chunks.empty() || (chunkSize + argSize > maxArgsSize && !chunks.back().empty())) {
+                                chunks.emplace_back();
+                                chunkSize = 0;
+                            }
+
+                            chunks.back().emplace_back(argument);
+                            chunkSize += argSize;
+                        }
+
+                        return chunks;
+                    }
+
+                    // runs ldd on the given files and parses the per-file sections of its output
+                    static std::map<std::string, DependencyTraceResult> runLdd(const std::vector<std::string>& files) {
+                        std::map<std::string, DependencyTraceResult> results;
+
+                        subprocess::subprocess_env_map_t env;
+                        env["LC_ALL"] = "C";
+
+                        std::vector<std::string> args{"ldd"};
+                        args.insert(args.end(), files.begin(), files.end());
+
+                        subprocess::subprocess lddProc(args, env);
+
+                        // ldd prints a header line containing the path for every file if called with multiple files
+                        std::set<std::string> headers;
+
+                        if (files.size() > 1) {
+                            for (const auto& file : files)
+                                headers.insert(file + ":");
+                        }
+
+                        const boost::regex expr(R"(\s*(.+)\s+\=>\s+(.+)\s+\((.+)\)\s*)");
+                        boost::cmatch what;
+
+                        const std::string* currentFile = (files.size() == 1) ? &files.front() : nullptr;
+
+                        // files ldd printed at least one line for in their section
+                        std::set<std::string> tracedFiles;
+                        // files ldd reported not to be linked dynamically
+                        std::set<std::string> notDynamicFiles;
+                        // ldd prints "not a dynamic executable" on stderr without the path, so we can only count them
+                        size_t notDynamicMessagesCount = 0;
+                        // messages about a specific file ldd prints on stderr, e.g., "ldd: <path>: not regular file"
+                        std::map<std::string, std::vector<std::string>> fileMessages;
+                        std::vector<std::string> otherMessages;
+                        bool stdoutEmpty = true;
+
+                        // the output is parsed while ldd is still running, line by line
+                        auto parseLine = [&](boost::string_view lineView) {
+                            stdoutEmpty = false;
+
+                            if (!headers.empty() && !lineView.empty() && lineView.back() == ':') {
+                                const auto header = headers.find(lineView.to_string());
+
+                                if (header != headers.end()) {
+                                    currentFile = &*std::find(files.begin(), files.end(), header->substr(0, header->size() - 1));
+                                    return;
+                                }
+                            }
+
+                            if (currentFile == nullptr) {
+                                ldLog() << LD_DEBUG << "Invalid ldd output: " << lineView.to_string() << std::endl;
+                                return;
+                            }
+
+                            tracedFiles.insert(*currentFile);
+
+                            auto& fileResult = results[*currentFile];
+
+                            if (boost::regex_search(lineView.begin(), lineView.end(), what, expr)) {
+                                auto libraryPath = what[2].str();
+                                util::trim(libraryPath);
+                                fileResult.dependencies.push_back(bf::absolute(libraryPath));
+                                return;
+                            }
+
+                            // the less common cases are handled on a copy
+                            const auto line = lineView.to_string();
+
+                            if (util::stringContains(line, "=> not found")) {
+                                auto missingLib = line;
+                                static const std::string pattern = "=> not found";
+                                missingLib.erase(missingLib.find(pattern), pattern.size());
+                                util::trim(missingLib);
+                                util::trim(missingLib, '\t');
+
+                                // like before, we report the first missing library only
+                                if (fileResult.error.empty())
+                                    fileResult.error = "Could not find dependency: " + missingLib;
+                            } else if (util::stringContains(line, "not a dynamic executable")) {
+                                notDynamicFiles.insert(*currentFile);
+                            } else {
+                                ldLog() << LD_DEBUG << "Invalid ldd output: " << line << std::endl;
+                            }
+                        };
+
+                        auto parseErrorLine = [&](boost::string_view lineView) {
+                            if (lineView.find("not a dynamic executable") != boost::string_view::npos) {
+                                ++notDynamicMessagesCount;
+                                return;
+                            }
+
+                            auto line = lineView.to_string();
+                            util::trim(line);
+
+                            if (line.empty())
+                                return;
+
+                            // messages about a file look like "ldd: <path>: <message>", paths may contain colons, too
+                            static const std::string prefix = "ldd: ";
+
+                            if (line.compare(0, prefix.size(), prefix) == 0) {
+                                for (auto pos = line.find(':', prefix.size()); pos != std::string::npos; pos = line.find(':', pos + 1)) {
+                                    const auto file = line.substr(prefix.size(), pos - prefix.size());
+
+                                    if (std::find(files.begin(), files.end(), file) != files.end()) {
+                                        fileMessages[file].emplace_back(line);
+                                        return;
+                                    }
+                                }
+                            }
+
+                            otherMessages.emplace_back(line);
+                        };
+
+                        const auto exitCode = lddProc.run_lines(parseLine, parseErrorLine);
+
+                        // ldd failed before it could look at any of the files (e.g., it could not be run at all), so
+                        // none of the files could be traced
+                        if (exitCode != 0 && stdoutEmpty && notDynamicMessagesCount == 0 && fileMessages.empty()) {
+                            auto error = "Failed to run ldd: exited with code " + std::to_string(exitCode);
+
+                            for (const auto& message : otherMessages)
+                                error += "\n" + message;
+
+                            for (const auto& file : files) {
+                                results[file].dependencies.clear();
+                                results[file].error = error;
+                            }
+
+                            return results;
+                        }
+
+                        for (const auto& message : otherMessages)
+                            ldLog() << LD_DEBUG << "ldd:" << message << std::endl;
+
+                        // files which are not linked dynamically get an empty section, and a message on stderr we can't
+                        // attribute to them
+                        // if there are as many of these messages as there are files with empty sections, all of them
+                        // are fine, otherwise we can't tell which of them ldd failed to trace, and have to assume all of
+                        // them have failed
+                        std::vector<std::string> untracedFiles;
+
+                        for (const auto& file : files) {
+                            if (tracedFiles.find(file) == tracedFiles.end() && fileMessages.find(file) == fileMessages.end())
+                                untracedFiles.emplace_back(file);
+                        }
+
+                        if (untracedFiles.size() <= notDynamicMessagesCount)
+                            notDynamicFiles.insert(untracedFiles.begin(), untracedFiles.end());
+
+                        for (const auto& file : files) {
+                            auto& fileResult = results[file];
+
+                            const auto messages = fileMessages.find(file);
+
+                            if (notDynamicFiles.find(file) != notDynamicFiles.end()) {
+                                ldLog() << LD_WARNING << file << "is not linked dynamically" << std::endl;
+                            } else if (tracedFiles.find(file) == tracedFiles.end()) {
+                                // files with a missing section could not be traced by ldd, the reason is printed on stderr
+                                if (messages != fileMessages.end()) {
+                                    fileResult.error = util::join(messages->second, "; ");
+                                } else {
+                                    fileResult.error = "ldd failed to trace dependencies of " + file +
+                                                       " (exited with code " + std::to_string(exitCode) + ")";
+                                }
+                            } else if (messages != fileMessages.end()) {
+                                for (const auto& message : messages->second)
+                                    ldLog() << LD_WARNING << message << std::endl;
+                            }
+
+                            // files with a missing dependency don't have a valid list of dependencies
+                            if (!fileResult.error.empty())
+                                fileResult.dependencies.clear();
+                        }
+
+                        return results;
+                    }
+
+                private:
+                    // helpers to read and write ELF structures in the mapped file, converting their byte order
+                    template<typename ByteOrder_T, typename T>
+                    static T readStruct(const uint8_t* data, uint64_t offset) {
+                        T value;
+                        memcpy(&value, data + offset, sizeof(T));
+                        ByteOrder_T::toHost(value);
+                        return value;
+                    }
+
+                    template<typename ByteOrder_T, typename T>
+                    static void writeStruct(uint8_t* data, uint64_t offset, T value) {
+                        ByteOrder_T::toFile(value);
+                        memcpy(data + offset, &value, sizeof(T));
+                    }
+
+                    // appends data to the end of the file, returns false if it cannot be written
+                    typedef std::function<bool(const std::vector<uint8_t>&)> AppendCallback;
+
+                    template<typename T>
+                    static T alignUp(T value, T alignment) {
+                        return (value + alignment - 1) / alignment * alignment;
+                    }
+
+                    // moves the dynamic string table, extended by the new value unless it contains it already, into a
+                    // new PT_LOAD segment at the end of the file, like patchelf does
+                    // if the dynamic section has no spare entry for the value, it is moved there as well and extended by
+                    // one entry
+                    // the segment needs a program header, unless there is an unused (PT_NULL) one, the program header
+                    // table is extended, for which the sections following it are moved into the new segment, too
+                    // the table itself stays where it is, as tools like strip rely on its location, and kernels before
+                    // Linux 5.18 compute its address in executables from the first segment
+                    // the new segment is written before any existing structure is modified, so the file is left
+                    // unchanged if that fails
+                    template<typename Ehdr_T, typename Shdr_T, typename Phdr_T, typename Dyn_T, typename ByteOrder_T>
+                    static bool relocateDynamicStringTable(uint8_t* data, size_t dataSize, Ehdr_T ehdr, std::vector<Phdr_T> phdrs,
+                                                           size_t dynamicSegmentIndex, std::vector<Dyn_T> dynamicEntries,
+                                                           int64_t stringTableEntry, int64_t stringTableSizeEntry,
+                                                           int64_t rpathEntry, int64_t newValueOffset,
+                                                           const std::string& stringTable, const std::string& value,
+                                                           const AppendCallback& appendToFile) {
+                        // the old locations are needed to write back the structures which aren't moved
+                        const uint64_t dynamicOffset = phdrs[dynamicSegmentIndex].p_offset;
+                        const uint64_t dynamicSize = phdrs[dynamicSegmentIndex].p_filesz;
+                        const uint64_t dynamicEntriesCount = dynamicEntries.size();
+                        const uint64_t oldStringTableAddress = dynamicEntries[stringTableEntry].d_un.d_ptr;
+
+                        std::string newStringTable = stringTable;
+
+                        if (newValueOffset < 0) {
+                            newValueOffset = static_cast<int64_t>(newStringTable.size());
+                            newStringTable.append(value.c_str(), value.size() + 1);
+                        }
+
+                        const bool moveDynamicSection = rpathEntry < 0;
+
+                        if (moveDynamicSection) {
+                            // the new entry is inserted in front of the terminating DT_NULL entry
+                            const auto nullEntry = std::find_if(dynamicEntries.begin(), dynamicEntries.end(), [](const Dyn_T& entry) {
+                                return entry.d_tag == DT_NULL;
+                            });
+
+                            rpathEntry = nullEntry - dynamicEntries.begin();
+
+                            Dyn_T entry{};
+                            entry.d_tag = DT_RUNPATH;
+                            dynamicEntries.insert(nullEntry, entry);
+
+                            if (dynamicEntries.back().d_tag != DT_NULL)
+                                dynamicEntries.emplace_back(Dyn_T{});
+                        }
+
+                        if (ehdr.e_shoff + ehdr.e_shnum * sizeof(Shdr_T) > dataSize)
+                            throw ElfFileParseError("Section header table exceeds file size");
+
+                        std::vector<Shdr_T> shdrs;
+
+                        for (uint64_t i = 0; i < ehdr.e_shnum; ++i)
+                            shdrs.emplace_back(readStruct<ByteOrder_T, Shdr_T>(data, ehdr.e_shoff + i * sizeof(Shdr_T)));
+
+                        uint64_t loadsEnd = 0;
+                        uint64_t maxAlignment = 1;
+
+                        for (const auto& phdr : phdrs) {
+                            if (phdr.p_type == PT_LOAD) {
+                                loadsEnd = std::max<uint64_t>(loadsEnd, phdr.p_vaddr + phdr.p_memsz);
+                                maxAlignment = std::max<uint64_t>(maxAlignment, phdr.p_align);
+                            }
+                        }
+
+                        if (loadsEnd == 0)
+                            throw ElfFileParseError("File does not contain any loadable segments");
+
+                        const auto unusedPhdr = std::find_if(phdrs.begin(), phdrs.end(), [](const Phdr_T& phdr) {
+                            return phdr.p_type == PT_NULL;
+                        });
+                        const bool extendProgramHeaders = unusedPhdr == phdrs.end();
+
+                        // e_phnum cannot hold more entries, larger tables are stored elsewhere
+                        if (extendProgramHeaders && phdrs.size() + 1 >= PN_XNUM)
+                            return false;
+
+                        // the range following the program header table which is moved to make room for another entry
+                        // everything overlapping with it, i.e., sections and the segments describing them, has to be
+                        // moved as a whole, which keeps the distances between them
+                        const uint64_t blockBegin = ehdr.e_phoff + phdrs.size() * sizeof(Phdr_T);
+                        uint64_t blockEnd = blockBegin;
+                        uint64_t blockAlignment = 1;
+                        uint64_t blockAddress = 0;
+
+                        if (extendProgramHeaders) {
+                            blockEnd += sizeof(Phdr_T);
+
+                            bool movable = true;
+
+                            auto extendBlock = [&](uint64_t begin, uint64_t size, uint64_t alignment) {
+                                if (size == 0 || begin + size <= blockBegin || begin >= blockEnd)
+                                    return false;
+
+                                if (begin < blockBegin)
+                                    movable = false;
+
+                                blockAlignment = std::max<uint64_t>(blockAlignment, alignment);
+
+                                if (begin + size <= blockEnd)
+                                    return false;
+
+                                blockEnd = begin + size;
+                                return true;
+                            };
+
+                            for (bool extended = true; extended && movable;) {
+                                extended = false;
+
+                                for (const auto& shdr : shdrs) {
+                                    if (shdr.sh_type != SHT_NOBITS)
+                                        extended |= extendBlock(shdr.sh_offset, shdr.sh_size, shdr.sh_addralign);
+                                }
+
+                                for (const auto& phdr : phdrs) {
+                                    if (phdr.p_type != PT_LOAD && phdr.p_type != PT_PHDR)
+                                        extended |= extendBlock(phdr.p_offset, phdr.p_filesz, phdr.p_align);
+                                }
+                            }
+
+                            // the sections we're about to change can't be moved along with the others, and the block must
+                            // be mapped by the same segment as the program header table
+                            auto overlapsBlock = [blockBegin, blockEnd](uint64_t begin, uint64_t size) {
+                                return size > 0 && begin < blockEnd && blockBegin < begin + size;
+                            };
+
+                            const auto stringTableSegment = std::find_if(phdrs.begin(), phdrs.end(), [oldStringTableAddress](const Phdr_T& phdr) {
+                                return phdr.p_type == PT_LOAD && oldStringTableAddress >= phdr.p_vaddr &&
+                                       oldStringTableAddress < phdr.p_vaddr + phdr.p_filesz;
+                            });
+
+                            if (!movable || stringTableSegment == phdrs.end() ||
+                                overlapsBlock(oldStringTableAddress - stringTableSegment->p_vaddr + stringTableSegment->p_offset, stringTable.size()) ||
+                                overlapsBlock(dynamicOffset, dynamicSize) ||
+                                overlapsBlock(ehdr.e_shoff, ehdr.e_shnum * sizeof(Shdr_T)) ||
+                                blockAlignment > maxAlignment)
+                                return false;
+
+                            const auto headersSegment = std::find_if(phdrs.begin(), phdrs.end(), [&ehdr, blockEnd](const Phdr_T& phdr) {
+                                return phdr.p_type == PT_LOAD && phdr.p_offset <= ehdr.e_phoff && blockEnd <= phdr.p_offset + phdr.p_filesz;
+                            });
+
+                            if (headersSegment == phdrs.end())
+                                return false;
+
+                            blockAddress = blockBegin - headersSegment->p_offset + headersSegment->p_vaddr;
+                        }
+
+                        // the segment must not share a page with the other segments, which would be overwritten when it's
+                        // mapped
+                        // we don't know the page size of the target system, but it does not exceed the alignment of the
+                        // segments, and no system supported by Linux uses pages larger than 64 KiB
+                        const uint64_t pageSize = std::min<uint64_t>(maxAlignment, 0x10000);
+
+                        const uint64_t segmentOffset = alignUp<uint64_t>(dataSize, std::max<uint64_t>(16, blockAlignment));
+                        const uint64_t segmentAddress = alignUp(loadsEnd, maxAlignment) + segmentOffset % maxAlignment;
+
+                        // the moved block keeps its alignment
+                        uint64_t segmentSize = 0;
+
+                        const auto blockPosition = blockBegin % blockAlignment;
+                        if (blockEnd > blockBegin)
+                            segmentSize = blockPosition + (blockEnd - blockBegin);
+
+                        const auto dynamicSectionPosition = alignUp<uint64_t>(segmentSize, 8);
+                        if (moveDynamicSection)
+                            segmentSize = dynamicSectionPosition + dynamicEntries.size() * sizeof(Dyn_T);
+
+                        const auto stringTablePosition = segmentSize;
+                        segmentSize += newStringTable.size();
+
+                        // 32-bit files cannot grow beyond 4 GiB
+                        if (segmentAddress + segmentSize > std::numeric_limits<decltype(ehdr.e_entry)>::max() ||
+                            segmentOffset + segmentSize > std::numeric_limits<decltype(ehdr.e_shoff)>::max())
+                            return false;
+
+                        auto isInBlock = [blockBegin, blockEnd](uint64_t begin, uint64_t size) {
+                            return begin >= blockBegin && begin + size <= blockEnd && blockEnd > blockBegin;
+                        };
+
+                        auto isAddressInBlock = [blockAddress, blockBegin, blockEnd](uint64_t address) {
+                            return address >= blockAddress && address < blockAddress + (blockEnd - blockBegin);
+                        };
+
+                        auto moveOffset = [&](uint64_t offset) {
+                            return offset - blockBegin + segmentOffset + blockPosition;
+                        };
+
+                        auto moveAddress = [&](uint64_t address) {
+                            return address - blockAddress + segmentAddress + blockPosition;
+                        };
+
+                        for (auto& phdr : phdrs) {
+                            if (phdr.p_type != PT_LOAD && phdr.p_type != PT_PHDR && isInBlock(phdr.p_offset, phdr.p_filesz)) {
+                                phdr.p_offset = moveOffset(phdr.p_offset);
+                                phdr.p_vaddr = moveAddress(phdr.p_vaddr);
+                                phdr.p_paddr = moveAddress(phdr.p_paddr);
+                            }
+                        }
+
+                        if (moveDynamicSection) {
+                            auto& phdr = phdrs[dynamicSegmentIndex];
+                            phdr.p_offset = segmentOffset + dynamicSectionPosition;
+                            phdr.p_vaddr = phdr.p_paddr = segmentAddress + dynamicSectionPosition;
+                            phdr.p_filesz = phdr.p_memsz = dynamicEntries.size() * sizeof(Dyn_T);
+                        }
+
+                        Phdr_T segment{};
+                        segment.p_type = PT_LOAD;
+                        // the linker writes to the dynamic section, e.g., to store DT_DEBUG
+                        segment.p_flags = PF_R | (moveDynamicSection ? PF_W : 0);
+                        segment.p_offset = segmentOffset;
+                        segment.p_vaddr = segment.p_paddr = segmentAddress;
+                        segment.p_filesz = segment.p_memsz = segmentSize;
+                        segment.p_align = pageSize;
+
+                        // the PT_LOAD entries must be sorted by their addresses, the new one has the highest one
+                        if (!extendProgramHeaders)
+                            phdrs.erase(unusedPhdr);
+
+                        const auto lastLoad = std::find_if(phdrs.rbegin(), phdrs.rend(), [](const Phdr_T& phdr) {
+                            return phdr.p_type == PT_LOAD;
+                        });
+
+                        phdrs.insert(lastLoad.base(), segment);
+
+                        if (extendProgramHeaders) {
+                            for (auto& phdr : phdrs) {
+                                if (phdr.p_type == PT_PHDR)
+                                    phdr.p_filesz = phdr.p_memsz = phdrs.size() * sizeof(Phdr_T);
+                            }
+
+                            ehdr.e_phnum = phdrs.size();
+                        }
+
+                        // the dynamic section references some of the sections which might have been moved
+                        static const std::set<int64_t> addressTags = {
+                            DT_HASH, DT_GNU_HASH, DT_SYMTAB, DT_VERSYM, DT_VERDEF, DT_VERNEED, DT_REL, DT_RELA, DT_JMPREL,
+#ifdef DT_RELR
+                            DT_RELR,
+#endif
+                        };
+
+                        for (auto& entry : dynamicEntries) {
+                            if (addressTags.find(entry.d_tag) != addressTags.end() && isAddressInBlock(entry.d_un.d_ptr))
+                                entry.d_un.d_ptr = moveAddress(entry.d_un.d_ptr);
+                        }
+
+                        dynamicEntries[stringTableEntry].d_un.d_ptr = segmentAddress + stringTablePosition;
+                        dynamicEntries[stringTableSizeEntry].d_un.d_val = newStringTable.size();
+                        dynamicEntries[rpathEntry].d_tag = DT_RUNPATH;
+                        dynamicEntries[rpathEntry].d_un.d_val = static_cast<uint64_t>(newValueOffset);
+
+                        // the sections must describe the new locations, too, otherwise tools which work on the sections,
+                        // e.g., strip or patchelf, would use the old ones
+                        for (auto& shdr : shdrs) {
+                            if (shdr.sh_type == SHT_STRTAB && (shdr.sh_flags & SHF_ALLOC) != 0 && shdr.sh_addr == oldStringTableAddress) {
+                                shdr.sh_offset = segmentOffset + stringTablePosition;
+                                shdr.sh_addr = segmentAddress + stringTablePosition;
+                                shdr.sh_size = newStringTable.size();
+                            } else if (shdr.sh_type == SHT_DYNAMIC && moveDynamicSection) {
+                                shdr.sh_offset = segmentOffset + dynamicSectionPosition;
+                                shdr.sh_addr = segmentAddress + dynamicSectionPosition;
+                                shdr.sh_size = dynamicEntries.size() * sizeof(Dyn_T);
+                            } else if (shdr.sh_type != SHT_NOBITS && isInBlock(shdr.sh_offset, shdr.sh_size)) {
+                                shdr.sh_offset = moveOffset(shdr.sh_offset);
+
+                                if ((shdr.sh_flags & SHF_ALLOC) != 0)
+                                    shdr.sh_addr = moveAddress(shdr.sh_addr);
+                            }
+                        }
+
+                        std::vector<uint8_t> appendedData(segmentOffset + segmentSize - dataSize, 0);
+                        auto* segmentData = appendedData.data() + (segmentOffset - dataSize);
+
+                        if (blockEnd > blockBegin)
+                            memcpy(segmentData + blockPosition, data + blockBegin, blockEnd - blockBegin);
+
+                        if (moveDynamicSection) {
+                            for (size_t i = 0; i < dynamicEntries.size(); ++i)
+                                writeStruct<ByteOrder_T>(segmentData, dynamicSectionPosition + i * sizeof(Dyn_T), dynamicEntries[i]);
+                        }
+
+                        memcpy(segmentData + stringTablePosition, newStringTable.data(), newStringTable.size());
+
+                        if (!appendToFile(appendedData))
+                            return false;
+
+                        writeStruct<ByteOrder_T>(data, 0, ehdr);
+
+                        for (size_t i = 0; i < phdrs.size(); ++i)
+                            writeStruct<ByteOrder_T>(data, ehdr.e_phoff + i * sizeof(Phdr_T), phdrs[i]);
+
+                        if (!moveDynamicSection) {
+                            for (size_t i = 0; i < dynamicEntriesCount; ++i)
+                                writeStruct<ByteOrder_T>(data, dynamicOffset + i * sizeof(Dyn_T), dynamicEntries[i]);
+                        }
+
+                        for (size_t i = 0; i < shdrs.size(); ++i)
+                            writeStruct<ByteOrder_T>(data, ehdr.e_shoff + i * sizeof(Shdr_T), shdrs[i]);
+
+                        return true;
+                    }
+
+                    // rewrites DT_RUNPATH (or DT_RPATH, which is converted to DT_RUNPATH like patchelf does) in the mapped
+                    // file
+                    // if the new value is longer than the old one, it is appended to the segment containing the
+                    // dynamic string table, which works if the string table is the last section in the segment, and the
+                    // (usually zero filled) space up to the next segment or the end of the file is large enough
+                    // otherwise, the string table is moved to a new segment at the end of the file
+                    // new data is passed to appendToFile, the mapping is not resized
+                    // false is returned if the file cannot be edited, in which case it is left unmodified
+                    template<typename Ehdr_T, typename Shdr_T, typename Phdr_T, typename Dyn_T, typename ByteOrder_T>
+                    static bool rewriteRPath(uint8_t* data, size_t dataSize, const std::string& value, const AppendCallback& appendToFile) {
+                        // we work on copies of the structures converted to the host's byte order, and write back the
+                        // modified ones
+                        const auto ehdr = readStruct<ByteOrder_T, Ehdr_T>(data, 0);
+
+                        if (ehdr.e_phoff + ehdr.e_phnum * sizeof(Phdr_T) > dataSize)
+                            throw ElfFileParseError("Program header table exceeds file size");
+
+                        std::vector<Phdr_T> phdrs;
+
+                        for (uint64_t i = 0; i < ehdr.e_phnum; ++i)
+                            phdrs.emplace_back(readStruct<ByteOrder_T, Phdr_T>(data, ehdr.e_phoff + i * sizeof(Phdr_T)));
+
+                        auto isDynamicSegment = [](const Phdr_T& phdr) { return phdr.p_type == PT_DYNAMIC; };
+                        const auto dynamicSegment = std::find_if(phdrs.begin(), phdrs.end(), isDynamicSegment);
+
+                        if (dynamicSegment == phdrs.end())
+                            throw ElfFileParseError("File does not contain a dynamic section");
+
+                        if (dynamicSegment->p_offset + dynamicSegment->p_filesz > dataSize)
+                            throw ElfFileParseError("Dynamic section exceeds file size");
+
+                        std::vector<Dyn_T> dynamicEntries;
+
+                        for (uint64_t i = 0; i < dynamicSegment->p_filesz / sizeof(Dyn_T); ++i)
+                            dynamicEntries.emplace_back(readStruct<ByteOrder_T, Dyn_T>(data, dynamicSegment->p_offset + i * sizeof(Dyn_T)));
+
+                        // indices of the entries we're interested in
+                        int64_t stringTableEntry = -1;
+                        int64_t stringTableSizeEntry = -1;
+                        int64_t rpathEntry = -1;
+                        int64_t runpathEntry = -1;
+                        int64_t firstNullEntry = -1;
+
+                        for (size_t i = 0; i < dynamicEntries.size(); ++i) {
+                            const auto& entry = dynamicEntries[i];
+
+                            if (entry.d_tag == DT_NULL) {
+                                // we need at least one more DT_NULL entry following this one if we want to add an entry
+                                if (i + 1 < dynamicEntries.size())
+                                    firstNullEntry = i;
+                                break;
+                            }
+
+                            switch (entry.d_tag) {
+                                case DT_STRTAB:
+                                    stringTableEntry = i;
+                                    break;
+                                case DT_STRSZ:
+                                    stringTableSizeEntry = i;
+                                    break;
+                                case DT_RPATH:
+                                    rpathEntry = i;
+                                    break;
+                                case DT_RUNPATH:
+                                    runpathEntry = i;
+                                    break;
+                            }
+                        }
+
+                        if (stringTableEntry < 0 || stringTableSizeEntry < 0)
+                            throw ElfFileParseError("Dynamic section does not reference a string table");
+
+                        const auto stringTableAddress = dynamicEntries[stringTableEntry].d_un.d_ptr;
+                        const auto stringTableSize = dynamicEntries[stringTableSizeEntry].d_un.d_val;
+
+                        auto containsStringTable = [stringTableAddress](const Phdr_T& phdr) {
+                            return phdr.p_type == PT_LOAD && stringTableAddress >= phdr.p_vaddr &&
+                                   stringTableAddress < phdr.p_vaddr + phdr.p_filesz;
+                        };
+                        const auto stringTableSegment = std::find_if(phdrs.begin(), phdrs.end(), containsStringTable);
+
+                        if (stringTableSegment == phdrs.end())
+                            throw ElfFileParseError("Could not find segment containing the dynamic string table");
+
+                        const auto stringTableOffset = stringTableAddress - stringTableSegment->p_vaddr + stringTableSegment->p_offset;
+
+                        if (stringTableOffset + stringTableSize > dataSize)
+                            throw ElfFileParseError("Dynamic string table exceeds file size");
+
+                        auto* stringTable = reinterpret_cast<char*>(data + stringTableOffset);
+
+                        auto writeDynamicEntry = [data, &dynamicEntries, &dynamicSegment](int64_t index) {
+                            writeStruct<ByteOrder_T>(data, dynamicSegment->p_offset + index * sizeof(Dyn_T), dynamicEntries[index]);
+                        };
+
+                        // prefer DT_RUNPATH, like the linker does
+                        const auto existingEntry = (runpathEntry >= 0) ? runpathEntry : rpathEntry;
+
+                        // simplest case: the new value fits into the space of the old one
+                        if (existingEntry >= 0 && dynamicEntries[existingEntry].d_un.d_val < stringTableSize) {
+                            const auto oldValueOffset = dynamicEntries[existingEntry].d_un.d_val;
+                            auto* oldValue = stringTable + oldValueOffset;
+                            const auto oldLength = strnlen(oldValue, stringTableSize - oldValueOffset);
+
+                            if (value.size() <= oldLength && oldValueOffset + oldLength < stringTableSize) {
+                                memcpy(oldValue, value.c_str(), value.size());
+                                memset(oldValue + value.size(), '\0', oldLength - value.size() + 1);
+                                dynamicEntries[existingEntry].d_tag = DT_RUNPATH;
+                                writeDynamicEntry(existingEntry);
+                                return true;
+                            }
+                        }
+
+                        // adding a new entry requires a spare DT_NULL entry, otherwise the dynamic section has to be
+                        // moved
+                        const auto entry = (existingEntry >= 0) ? existingEntry : firstNullEntry;
+
+                        const auto requiredSize = value.size() + 1;
+
+                        // the string table might contain the value already, e.g., as the suffix of another string
+                        int64_t newValueOffset = -1;
+
+                        {
+                            const std::string needle(value.c_str(), requiredSize);
+                            const std::string haystack(stringTable, stringTableSize);
+
+                            const auto pos = haystack.find(needle);
+
+                            if (pos != std::string::npos)
+                                newValueOffset = static_cast<int64_t>(pos);
+                        }
+
+                        // appends the value to the string table if there's space behind it, returns false if there isn't
+                        auto appendToStringTable = [&]() {
+                            // to be able to grow the segment, it must not contain any uninitialized data
+                            if (stringTableSegment->p_filesz != stringTableSegment->p_memsz)
+                                return false;
+
+                            const uint64_t appendOffset = stringTableSegment->p_offset + stringTableSegment->p_filesz;
+                            const uint64_t appendAddress = stringTableSegment->p_vaddr + stringTableSegment->p_filesz;
+
+                            // the value may extend beyond the end of the file, the remainder is appended to it
+                            if (appendOffset > dataSize)
+                                return false;
+
+                            const auto sizeInFile = std::min<uint64_t>(requiredSize, dataSize - appendOffset);
+
+                            auto overlaps = [requiredSize](uint64_t begin, uint64_t size, uint64_t otherBegin) {
+                                return size > 0 && begin < otherBegin + requiredSize && otherBegin < begin + size;
+                            };
+
+                            // the space must not be used by any other segment, in the file and in memory
+                            for (auto phdr = phdrs.begin(); phdr != phdrs.end(); ++phdr) {
+                                if (phdr == stringTableSegment)
+                                    continue;
+
+                                if (overlaps(phdr->p_offset, phdr->p_filesz, appendOffset))
+                                    return false;
+
+                                if (phdr->p_type == PT_LOAD && overlaps(phdr->p_vaddr, phdr->p_memsz, appendAddress))
+                                    return false;
+                            }
+
+                            // the same applies to the sections and the section header table
+                            if (ehdr.e_shoff + ehdr.e_shnum * sizeof(Shdr_T) > dataSize)
+                                throw ElfFileParseError("Section header table exceeds file size");
+
+                            if (overlaps(ehdr.e_shoff, ehdr.e_shnum * sizeof(Shdr_T), appendOffset))
+                                return false;
+
+                            // the section of the string table must cover the appended value, too, otherwise tools which
+                            // work on the sections, e.g., strip or patchelf, would not see it, or even drop it
+                            // it can only be extended if nothing follows it in the segment
+                            int64_t stringTableSection = -1;
+
+                            for (uint64_t i = 0; i < ehdr.e_shnum; ++i) {
+                                const auto shdr = readStruct<ByteOrder_T, Shdr_T>(data, ehdr.e_shoff + i * sizeof(Shdr_T));
+
+                                if (shdr.sh_type != SHT_NOBITS && overlaps(shdr.sh_offset, shdr.sh_size, appendOffset))
+                                    return false;
+
+                                if (shdr.sh_type == SHT_STRTAB && (shdr.sh_flags & SHF_ALLOC) != 0 && shdr.sh_addr == stringTableAddress) {
+                                    if (shdr.sh_offset + shdr.sh_size != appendOffset)
+                                        return false;
+
+                                    stringTableSection = static_cast<int64_t>(i);
+                                }
+                            }
+
+                            // finally, to be on the safe side, we expect padding to be zero filled
+                            if (std::any_of(data + appendOffset, data + appendOffset + sizeInFile, [](uint8_t c) { return c != 0; }))
+                                return false;
+
+                            if (sizeInFile < requiredSize) {
+                                const auto* remainder = reinterpret_cast<const uint8_t*>(value.c_str()) + sizeInFile;
+
+                                if (!appendToFile(std::vector<uint8_t>(remainder, remainder + (requiredSize - sizeInFile))))
+                                    return false;
+                            }
+
+                            memcpy(data + appendOffset, value.c_str(), sizeInFile);
+
+                            stringTableSegment->p_filesz += requiredSize;
+                            stringTableSegment->p_memsz += requiredSize;
+                            writeStruct<ByteOrder_T>(data, ehdr.e_phoff + (stringTableSegment - phdrs.begin()) * sizeof(Phdr_T), *stringTableSegment);
+
+                            newValueOffset = static_cast<int64_t>(appendAddress - stringTableAddress);
+
+                            dynamicEntries[stringTableSizeEntry].d_un.d_val = newValueOffset + requiredSize;
+                            writeDynamicEntry(stringTableSizeEntry);
+
+                            if (stringTableSection >= 0) {
+                                const auto shdrOffset = ehdr.e_shoff + stringTableSection * sizeof(Shdr_T);
+                                auto shdr = readStruct<ByteOrder_T, Shdr_T>(data, shdrOffset);
+                                shdr.sh_size = dynamicEntries[stringTableSizeEntry].d_un.d_val;
+                                writeStruct<ByteOrder_T>(data, shdrOffset, shdr);
+                            }
+
+                            return true;
+                        };
+
+                        if (entry < 0 || (newValueOffset < 0 && !appendToStringTable())) {
+                            return relocateDynamicStringTable<Ehdr_T, Shdr_T, Phdr_T, Dyn_T, ByteOrder_T>(
+                                data, dataSize, ehdr, phdrs, dynamicSegment - phdrs.begin(), dynamicEntries,
+                                stringTableEntry, stringTableSizeEntry, entry, newValueOffset,
+                                std::string(stringTable, stringTableSize), value, appendToFile
+                            );
+                        }
+
+                        dynamicEntries[entry].d_tag = DT_RUNPATH;
+                        dynamicEntries[entry].d_un.d_val = static_cast<uint64_t>(newValueOffset);
+                        writeDynamicEntry(entry);
+
+                        return true;
+                    }
+
+                public:
+                    bool setRPathNatively(const std::string& value) {
+                        if (!isDynamicallyLinked || isDebugSymbolsFile)
+                            throw ElfFileParseError("Cannot set rpath in file without dynamic section: " + path.string());
+
+                        // make sure the other values are read before the file is modified
+                        readDynamicSection();
+
+                        const int fd = open(path.c_str(), O_RDWR);
+
+                        if (fd < 0)
+                            throw ElfFileParseError("Could not open file for writing: " + path.string());
+
+                        const auto mapSize = static_cast<size_t>(lseek(fd, 0, SEEK_END));
+
+                        // the file is kept open, as data might have to be appended to it
+                        std::shared_ptr<void> file(nullptr, [fd](void*) {
+                            close(fd);
+                        });
+
+                        auto* data = static_cast<uint8_t*>(mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+
+                        if (data == MAP_FAILED)
+                            throw ElfFileParseError("Failed to map file: " + path.string());
+
+                        // make sure the mapping is released in any case
+                        std::shared_ptr<uint8_t> mapping(data, [mapSize](uint8_t* p) {
+                            munmap(p, mapSize);
+                        });
+
+                        // the mapping keeps its size, the appended data is only accessed through the file descriptor
+                        const AppendCallback appendToFile = [this, fd, mapSize](const std::vector<uint8_t>& appendedData) {
+                            for (size_t written = 0; written < appendedData.size();) {
+                                const auto rv = pwrite(fd, appendedData.data() + written, appendedData.size() - written, mapSize + written);
+
+                                if (rv < 0 && errno == EINTR)
+                                    continue;
+
+                                if (rv <= 0) {
+                                    ldLog() << LD_WARNING << "Failed to append data to file" << path << LD_NO_SPACE << ":" << strerror(errno) << std::endl;
+
+                                    // don't leave partially written data behind
+                                    if (ftruncate(fd, static_cast<off_t>(mapSize)) != 0)
+                                        ldLog() << LD_WARNING << "Failed to truncate file" << path << std::endl;
+
+                                    return false;
+                                }
+
+                                written += static_cast<size_t>(rv);
+                            }
+
+                            return true;
+                        };
+
+                        bool success;
+
+                        const bool isHostByteOrder = elfData == ElfFile::getSystemElfEndianness();
+
+                        switch (elfClass) {
+                            case ELFCLASS32:
+                                if (isHostByteOrder)
+                                    success = rewriteRPath<Elf32_Ehdr, Elf32_Shdr, Elf32_Phdr, Elf32_Dyn, HostByteOrder>(data, mapSize, value, appendToFile);
+                                else
+                                    success = rewriteRPath<Elf32_Ehdr, Elf32_Shdr, Elf32_Phdr, Elf32_Dyn, ForeignByteOrder>(data, mapSize, value, appendToFile);
+                                break;
+                            case ELFCLASS64:
+                                if (isHostByteOrder)
+                                    success = rewriteRPath<Elf64_Ehdr, Elf64_Shdr, Elf64_Phdr, Elf64_Dyn, HostByteOrder>(data, mapSize, value, appendToFile);
+                                else
+                                    success = rewriteRPath<Elf64_Ehdr, Elf64_Shdr, Elf64_Phdr, Elf64_Dyn, ForeignByteOrder>(data, mapSize, value, appendToFile);
+                                break;
+                            default:
+                                throw ElfFileParseError("Unknown ELF class: " + std::to_string(elfClass));
+                        }
+
+                        if (success) {
+                            rpath.clear();
+                            runpath = value;
+                            hasRunpath = true;
+                        }
+
+                        return success;
+                    }
+
+                    std::string getRPathNatively() {
+                        readDynamicSection();
+
+                        // like patchelf, we return DT_RUNPATH if available, and DT_RPATH otherwise
+                        if (hasRunpath)
+                            return runpath;
+
+                        return rpath;
+                    }
+
+                    std::string getRPathUsingPatchelf() {
+                        // don't try to fetch patchelf path in a catchall to make sure the process exists when the tool cannot be found
+                        const auto patchelfPath = PrivateData::getPatchelfPath();
+
+                        try {
+                            subprocess::subprocess patchelfProc({patchelfPath, "--print-rpath", path.string()});
+
+                            const auto result = patchelfProc.run();
+
+                            if (result.exit_code() != 0) {
+                                // if file is not an ELF executable, there is no need for a detailed error message
+                                if (result.exit_code() == 1 && result.stderr_string().find("not an ELF executable") != std::string::npos) {
+                                    return "";
+                                } else {
+                                    ldLog() << LD_ERROR << "Call to patchelf failed:" << std::endl << result.stderr_string();
+                                    return "";
+                                }
+                            }
+
+                            auto stdoutContents = result.stdout_string();
+
+                            util::trim(stdoutContents, '\n');
+                            util::trim(stdoutContents);
+
+                            return stdoutContents;
+                        } catch (const std::exception&) {
+                            return "";
+                        }
+                    }
+
+                    bool setRPathUsingPatchelf(const std::string& value) {
+                        // don't try to fetch patchelf path in a catchall to make sure the process exists when the tool cannot be found
+                        const auto patchelfPath = PrivateData::getPatchelfPath();
+
+                        const auto error = runPatchelfSetRPath(patchelfPath, value, {path.string()});
+
+                        if (!error.empty()) {
+                            ldLog() << LD_ERROR << "Call to patchelf failed:" << std::endl << error << std::endl;
+                            return false;
+                        }
+
+                        return true;
+                    }
+
+                    // patchelf accepts multiple files, but stops at the first one it fails to edit
+                    // returns patchelf's error message, or an empty string on success
+                    static std::string runPatchelfSetRPath(const std::string& patchelfPath, const std::string& value, const std::vector<std::string>& files) {
+                        std::vector<std::string> args = {patchelfPath, "--set-rpath", value};
+                        args.insert(args.end(), files.begin(), files.end());
+
+                        try {
+                            subprocess::subprocess patchelfProc(args);
+
+                            const auto result = patchelfProc.run();
+
+                            if (result.exit_code() != 0) {
+                                auto error = result.stderr_string();
+                                util::trim(error, '\n');
+
+                                // make sure failures are never reported as successes
+                                return error.empty() ? "patchelf exited with code " + std::to_string(result.exit_code()) : error;
+                            }
+                        } catch (const std::exception& e) {
+                            return e.what();
+                        }
+
+                        return {};
+                    }
+
+                private:
+                    // sections removed by strip(), which are never needed at runtime
+                    static bool isStrippedSectionName(const boost::string_ref& name) {
+                        return name == ".symtab" || name == ".strtab" || name == ".symtab_shndx" || name == ".comment" ||
+                               name.starts_with(".debug") || name.starts_with(".zdebug");
+                    }
+
+                    // writes a copy of the mapped file without the symbol tables, debug information and comments to fd
+                    // everything up to the end of the last segment is copied as it is, therefore the program headers and
+                    // the loaded data keep their offsets, and, unlike strip, we never need to make room for them
+                    // the remaining sections are appended, followed by the new section header table
+                    // returns false if the file cannot be stripped this way, nothing has been written to fd then
+                    template<typename Ehdr_T, typename Shdr_T, typename Phdr_T, typename ByteOrder_T>
+                    static bool writeStrippedCopy(const uint8_t* data, size_t dataSize, int fd) {
+                        if (dataSize < sizeof(Ehdr_T))
+                            throw ElfFileParseError("File too small to be an ELF file");
+
+                        auto ehdr = readStruct<ByteOrder_T, Ehdr_T>(data, 0);
+
+                        // object files need their symbols, and are not loaded anyway
+                        if (ehdr.e_type != ET_EXEC && ehdr.e_type != ET_DYN)
+                            return false;
+
+                        // files with more sections than fit into the ELF header are rare enough to leave them to strip
+                        if ((ehdr.e_shnum == 0 && ehdr.e_shoff != 0) || ehdr.e_shstrndx == SHN_XINDEX)
+                            return false;
+
+                        if (ehdr.e_phnum > 0 && ehdr.e_phentsize != sizeof(Phdr_T))
+                            throw ElfFileParseError("Invalid program header size: " + std::to_string(ehdr.e_phentsize));
+
+                        if (ehdr.e_shnum > 0 && ehdr.e_shentsize != sizeof(Shdr_T))
+                            throw ElfFileParseError("Invalid section header size: " + std::to_string(ehdr.e_shentsize));
+
+                        if (ehdr.e_phoff + ehdr.e_phnum * sizeof(Phdr_T) > dataSize)
+                            throw ElfFileParseError("Program header table exceeds file size");
+
+                        if (ehdr.e_shoff + ehdr.e_shnum * sizeof(Shdr_T) > dataSize)
+                            throw ElfFileParseError("Section header table exceeds file size");
+
+                        if (ehdr.e_shnum > 0 && ehdr.e_shstrndx >= ehdr.e_shnum)
+                            throw ElfFileParseError("Invalid section names table index: " + std::to_string(ehdr.e_shstrndx));
+
+                        // the part of the file which must not be changed
+                        uint64_t segmentsEnd = std::max<uint64_t>(sizeof(Ehdr_T), ehdr.e_phoff + ehdr.e_phnum * sizeof(Phdr_T));
+
+                        for (uint64_t i = 0; i < ehdr.e_phnum; ++i) {
+                            const auto phdr = readStruct<ByteOrder_T, Phdr_T>(data, ehdr.e_phoff + i * sizeof(Phdr_T));
+
+                            if (phdr.p_offset + phdr.p_filesz > dataSize)
+                                throw ElfFileParseError("Segment exceeds file size");
+
+                            segmentsEnd = std::max<uint64_t>(segmentsEnd, phdr.p_offset + phdr.p_filesz);
+                        }
+
+                        std::vector<Shdr_T> shdrs;
+
+                        for (uint64_t i = 0; i < ehdr.e_shnum; ++i)
+                            shdrs.emplace_back(readStruct<ByteOrder_T, Shdr_T>(data, ehdr.e_shoff + i * sizeof(Shdr_T)));
+
+                        std::vector<bool> removed(shdrs.size(), false);
+
+                        if (!shdrs.empty()) {
+                            const auto& namesSection = shdrs[ehdr.e_shstrndx];
+
+                            if (namesSection.sh_offset + namesSection.sh_size > dataSize)
+                                throw ElfFileParseError("Section names table exceeds file size");
+
+                            const auto* names = reinterpret_cast<const char*>(data + namesSection.sh_offset);
+
+                            for (size_t i = 1; i < shdrs.size(); ++i) {
+                                if (shdrs[i].sh_name >= namesSection.sh_size || i == ehdr.e_shstrndx)
+                                    continue;
+
+                                const auto* name = names + shdrs[i].sh_name;
+                                const boost::string_ref nameRef(name, strnlen(name, namesSection.sh_size - shdrs[i].sh_name));
+
+                                // sections which are loaded at runtime are kept, whatever their name is
+                                removed[i] = !(shdrs[i].sh_flags & SHF_ALLOC) && isStrippedSectionName(nameRef);
+                            }
 
-                public:
-                    static std::string getPatchelfPath() {
-                        // by default, try to use a patchelf next to the linuxdeploy binary
-                        // if that isn't available, fall back to searching for patchelf in the PATH
-                        std::string patchelfPath;
+                            // sections referring to a removed section, e.g., relocations for debug information, are
+                            // removed as well, unless they're needed at runtime
+                            for (bool changed = true; changed;) {
+                                changed = false;
 
-                        const auto envPatchelf = getenv("PATCHELF");
+                                for (size_t i = 1; i < shdrs.size(); ++i) {
+                                    const auto& shdr = shdrs[i];
 
-                        // allows users to use a custom patchelf instead of the bundled one
-                        if (envPatchelf != nullptr) {
-                            ldLog() << LD_DEBUG << "Using patchelf specified in $PATCHELF:" << envPatchelf << std::endl;
-                            patchelfPath = envPatchelf;
-                        } else {
-                            auto binDirPath = bf::path(util::getOwnExecutablePath());
-                            auto localPatchelfPath = binDirPath.parent_path() / "patchelf";
+                                    if (removed[i])
+                                        continue;
 
-                            if (bf::exists(localPatchelfPath)) {
-                                patchelfPath = localPatchelfPath.string();
-                            } else {
-                                for (const bf::path directory : util::split(getenv("PATH"), ':')) {
-                                    if (!bf::is_directory(directory))
+                                    const bool infoIsSection = shdr.sh_type == SHT_REL || shdr.sh_type == SHT_RELA || (shdr.sh_flags & SHF_INFO_LINK);
+
+                                    const bool refersToRemovedSection =
+                                        (shdr.sh_link < shdrs.size() && removed[shdr.sh_link]) ||
+                                        (infoIsSection && shdr.sh_info < shdrs.size() && removed[shdr.sh_info]);
+
+                                    if (!refersToRemovedSection)
                                         continue;
 
-                                    auto path = directory / "patchelf";
+                                    if ((shdr.sh_flags & SHF_ALLOC) || i == ehdr.e_shstrndx)
+                                        return false;
 
-                                    if (bf::is_regular_file(path)) {
-                                        patchelfPath = path.string();
-                                        break;
-                                    }
+                                    removed[i] = true;
+                                    changed = true;
                                 }
                             }
                         }
 
-                        if (!bf::is_regular_file(patchelfPath)) {
-                            ldLog() << LD_ERROR << "Could not find patchelf: no such file:" << patchelfPath << std::endl;
-                            throw std::runtime_error("Could not find patchelf");
+                        // calculate new layout, the remaining sections are appended in the order of their offsets
+                        std::vector<size_t> appendedSections;
+                        uint64_t offset = segmentsEnd;
+
+                        for (size_t i = 1; i < shdrs.size(); ++i) {
+                            const auto& shdr = shdrs[i];
+
+                            if (removed[i] || shdr.sh_type == SHT_NOBITS || shdr.sh_size == 0 || shdr.sh_offset + shdr.sh_size <= segmentsEnd)
+                                continue;
+
+                            // sections which are loaded must be part of a segment, and sections must not span across
+                            // the end of the segments
+                            if ((shdr.sh_flags & SHF_ALLOC) || shdr.sh_offset < segmentsEnd)
+                                return false;
+
+                            if (shdr.sh_offset + shdr.sh_size > dataSize)
+                                throw ElfFileParseError("Section exceeds file size");
+
+                            appendedSections.emplace_back(i);
                         }
 
-                        ldLog() << LD_DEBUG << "Using patchelf:" << patchelfPath << std::endl;
-                        return patchelfPath;
-                    }
+                        std::sort(appendedSections.begin(), appendedSections.end(), [&shdrs](size_t a, size_t b) {
+                            return shdrs[a].sh_offset < shdrs[b].sh_offset;
+                        });
 
-                private:
-                    template<typename Ehdr_T, typename Shdr_T, typename Phdr_T>
-                    void parseElfHeader(std::shared_ptr<uint8_t> data) {
-                        // TODO: the following code will _only_ work if the native byte order equals the program's
-                        // this should not be a big problem as we don't offer ARM builds yet, and require the user to
-                        // use a matching binary for the target binaries
+                        auto alignOffset = [](uint64_t value, uint64_t alignment) {
+                            if (alignment <= 1)
+                                return value;
+
+                            return (value + alignment - 1) / alignment * alignment;
+                        };
+
+                        std::vector<Shdr_T> newShdrs = shdrs;
+
+                        for (const auto i : appendedSections) {
+                            offset = alignOffset(offset, newShdrs[i].sh_addralign);
+                            newShdrs[i].sh_offset = offset;
+                            offset += newShdrs[i].sh_size;
+                        }
+
+                        // empty sections and sections without data in the file must not point past the end of it
+                        for (size_t i = 1; i < newShdrs.size(); ++i) {
+                            if (!removed[i] && (newShdrs[i].sh_type == SHT_NOBITS || newShdrs[i].sh_size == 0) && newShdrs[i].sh_offset > segmentsEnd)
+                                newShdrs[i].sh_offset = offset;
+                        }
+
+                        // map old section indices to new ones
+                        std::vector<uint64_t> newIndices(shdrs.size(), SHN_UNDEF);
+                        std::vector<Shdr_T> keptShdrs;
+
+                        for (size_t i = 0; i < shdrs.size(); ++i) {
+                            if (removed[i])
+                                continue;
+
+                            newIndices[i] = keptShdrs.size();
+                            keptShdrs.emplace_back(newShdrs[i]);
+                        }
 
-                        auto* ehdr = reinterpret_cast<Ehdr_T*>(data.get());
+                        for (auto& shdr : keptShdrs) {
+                            if (shdr.sh_link < newIndices.size())
+                                shdr.sh_link = newIndices[shdr.sh_link];
 
-                        elfABI = ehdr->e_ident[EI_OSABI];
+                            const bool infoIsSection = shdr.sh_type == SHT_REL || shdr.sh_type == SHT_RELA || (shdr.sh_flags & SHF_INFO_LINK);
 
-                        std::vector<Shdr_T> sections;
+                            if (infoIsSection && shdr.sh_info < newIndices.size())
+                                shdr.sh_info = newIndices[shdr.sh_info];
+                        }
 
-                        // parse section header table
-                        // first, we collect all entries in a vector so we can conveniently iterate over it
-                        for (uint64_t i = 0; i < ehdr->e_shnum; ++i) {
-                            auto* nextShdr = reinterpret_cast<Shdr_T*>(data.get() + ehdr->e_shoff + i * sizeof(Shdr_T));
-                            sections.emplace_back(*nextShdr);
+                        if (!shdrs.empty()) {
+                            ehdr.e_shoff = alignOffset(offset, alignof(Shdr_T));
+                            ehdr.e_shnum = keptShdrs.size();
+                            ehdr.e_shstrndx = newIndices[ehdr.e_shstrndx];
                         }
 
-                        auto getString = [data, &sections, ehdr](uint64_t offset) {
-                            assert(ehdr->e_shstrndx != SHN_UNDEF);
-                            const auto& stringTableSection = sections[ehdr->e_shstrndx];
-                            return std::string{reinterpret_cast<char*>(data.get() + stringTableSection.sh_offset + offset)};
+                        // write the new file sequentially, filling the gaps with zeroes
+                        uint64_t written = 0;
+
+                        auto write = [fd, &written](const void* buffer, size_t size) {
+                            for (size_t done = 0; done < size;) {
+                                const auto result = ::write(fd, static_cast<const char*>(buffer) + done, size - done);
+
+                                if (result < 0) {
+                                    if (errno == EINTR)
+                                        continue;
+
+                                    throw ElfFileParseError(std::string("Failed to write stripped copy: ") + strerror(errno));
+                                }
+
+                                done += result;
+                            }
+
+                            written += size;
                         };
 
-                        // now that we can look up texts, we can create a map to easily access the sections by name
-                        std::unordered_map<std::string, Shdr_T> sectionsMap;
-                        std::for_each(sections.begin(), sections.end(), [&sectionsMap, &getString](const Shdr_T& shdr) {
-                            const auto headerName = getString(shdr.sh_name);
-                            sectionsMap.insert(std::make_pair(headerName, shdr));
-                        });
+                        auto pad = [&write, &written](uint64_t target) {
+                            static const char zeroes[4096] = {};
 
-                        // this function is based on observations of the behavior of:
-                        // - strip --only-keep-debug
-                        // - objcopy --only-keep-debug
-                        isDebugSymbolsFile = (sectionsMap[".text"].sh_type == SHT_NOBITS);
+                            while (written < target)
+                                write(zeroes, std::min<uint64_t>(target - written, sizeof(zeroes)));
+                        };
 
-                        // https://stackoverflow.com/a/7298931
-                        for (uint64_t i = 0; i < ehdr->e_phnum && !isDynamicallyLinked; ++i) {
-                            auto* nextPhdr = reinterpret_cast<Phdr_T*>(data.get() + ehdr->e_phoff + i * sizeof(Phdr_T));
-                            switch (nextPhdr->p_type) {
-                                case PT_DYNAMIC:
-                                case PT_INTERP:
-                                    isDynamicallyLinked = true;
-                                    break;
+                        Ehdr_T fileEhdr = ehdr;
+                        ByteOrder_T::toFile(fileEhdr);
+
+                        write(&fileEhdr, sizeof(fileEhdr));
+                        write(data + sizeof(Ehdr_T), segmentsEnd - sizeof(Ehdr_T));
+
+                        for (const auto i : appendedSections) {
+                            pad(newShdrs[i].sh_offset);
+                            write(data + shdrs[i].sh_offset, shdrs[i].sh_size);
+                        }
+
+                        if (!shdrs.empty()) {
+                            pad(ehdr.e_shoff);
+
+                            for (auto shdr : keptShdrs) {
+                                ByteOrder_T::toFile(shdr);
+                                write(&shdr, sizeof(shdr));
                             }
                         }
+
+                        return true;
                     }
 
                 public:
-                    void readDataUsingElfAPI() {
-                        int fd = open(path.c_str(), O_RDONLY);
-                        auto map_size = static_cast<size_t>(lseek(fd, 0, SEEK_END));
-
-                        std::shared_ptr<uint8_t> data(
-                            static_cast<uint8_t*>(mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, 0)),
-                            [map_size](uint8_t* p) {
-                                if (munmap(static_cast<void*>(p), map_size) != 0) {
-                                    int error = errno;
-                                    throw ElfFileParseError(std::string("Failed to call munmap(): ") + strerror(error));
-                                }
-                                p = nullptr;
-                            }
-                        );
+                    // returns false if the file cannot be stripped in-process, destination is not modified then
+                    bool stripNatively(const bf::path& destination) {
+                        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+                        if (fd < 0)
+                            throw ElfFileParseError("Could not open file: " + path.string());
+
+                        struct stat st{};
+
+                        if (fstat(fd, &st) != 0) {
+                            close(fd);
+                            throw ElfFileParseError("Could not stat file: " + path.string());
+                        }
+
+                        const auto mapSize = static_cast<size_t>(st.st_size);
+
+                        auto* data = static_cast<uint8_t*>(mmap(nullptr, mapSize, PROT_READ, MAP_PRIVATE, fd, 0));
                         close(fd);
 
-                        // check which ELF "class" (32-bit or 64-bit) to use
-                        // the "class" is available at a specific constant offset in the section e_ident, which
-                        // happens to be the first section, so just reading one byte at EI_CLASS yields the data we're
-                        // looking for
-                        elfClass = data.get()[EI_CLASS];
+                        if (data == MAP_FAILED)
+                            throw ElfFileParseError("Failed to map file: " + path.string());
 
-                        switch (elfClass) {
-                            case ELFCLASS32:
-                                parseElfHeader<Elf32_Ehdr, Elf32_Shdr, Elf32_Phdr>(data);
-                                break;
-                            case ELFCLASS64:
-                                parseElfHeader<Elf64_Ehdr, Elf64_Shdr, Elf64_Phdr>(data);
-                                break;
-                            default:
-                                throw ElfFileParseError("Unknown ELF class: " + std::to_string(elfClass));
+                        // make sure the mapping is released in any case
+                        std::shared_ptr<uint8_t> mapping(data, [mapSize](uint8_t* p) {
+                            munmap(p, mapSize);
+                        });
+
+                        // the copy is written next to the destination, and replaces it once it's complete, which also
+                        // works if the destination is the file itself
+                        std::string tempPath = destination.string() + ".XXXXXX";
+                        const int tempFd = mkostemp(&tempPath[0], O_CLOEXEC);
+
+                        if (tempFd < 0)
+                            throw ElfFileParseError("Could not create temporary file for: " + destination.string());
+
+                        bool success;
+
+                        try {
+                            if (fchmod(tempFd, st.st_mode & 07777) != 0)
+                                throw ElfFileParseError("Could not set permissions of: " + tempPath);
+
+                            const bool isHostByteOrder = elfData == ElfFile::getSystemElfEndianness();
+
+                            switch (elfClass) {
+                                case ELFCLASS32:
+                                    if (isHostByteOrder)
+                                        success = writeStrippedCopy<Elf32_Ehdr, Elf32_Shdr, Elf32_Phdr, HostByteOrder>(data, mapSize, tempFd);
+                                    else
+                                        success = writeStrippedCopy<Elf32_Ehdr, Elf32_Shdr, Elf32_Phdr, ForeignByteOrder>(data, mapSize, tempFd);
+                                    break;
+                                case ELFCLASS64:
+                                    if (isHostByteOrder)
+                                        success = writeStrippedCopy<Elf64_Ehdr, Elf64_Shdr, Elf64_Phdr, HostByteOrder>(data, mapSize, tempFd);
+                                    else
+                                        success = writeStrippedCopy<Elf64_Ehdr, Elf64_Shdr, Elf64_Phdr, ForeignByteOrder>(data, mapSize, tempFd);
+                                    break;
+                                default:
+                                    throw ElfFileParseError("Unknown ELF class: " + std::to_string(elfClass));
+                            }
+
+                            // errors writing the data might only be reported when closing the file
+                            if (close(tempFd) != 0)
+                                throw ElfFileParseError("Failed to write stripped copy: " + tempPath);
+                        } catch (...) {
+                            close(tempFd);
+                            unlink(tempPath.c_str());
+                            throw;
+                        }
+
+                        if (!success) {
+                            unlink(tempPath.c_str());
+                            return false;
+                        }
+
+                        if (rename(tempPath.c_str(), destination.c_str()) != 0) {
+                            unlink(tempPath.c_str());
+                            throw ElfFileParseError("Could not replace file: " + destination.string());
+                        }
+
+                        return true;
+                    }
+
+                    static std::string getStripPath() {
+                        // by default, try to use a strip next to the linuxdeploy binary
+                        // if that isn't available, fall back to searching for strip in the PATH
+                        // the path is looked up once, as strip might be called for many files in parallel
+                        static const std::string stripPath = []() {
+                            std::string stripPath = "strip";
+
+                            auto binDirPath = bf::path(util::getOwnExecutablePath()).parent_path();
+                            auto localStripPath = binDirPath / "strip";
+
+                            if (bf::exists(localStripPath))
+                                stripPath = localStripPath.string();
+
+                            ldLog() << LD_DEBUG << "Using strip:" << stripPath << std::endl;
+
+                            return stripPath;
+                        }();
+
+                        return stripPath;
+                    }
+
+                    bool stripUsingBinutils(const bf::path& destination) {
+                        std::vector<std::string> args = {getStripPath()};
+
+                        if (destination != path) {
+                            args.emplace_back("-o");
+                            args.emplace_back(destination.string());
                         }
+
+                        args.emplace_back(path.string());
+
+                        subprocess::subprocess_env_map_t env;
+                        env.insert(std::make_pair(std::string("LC_ALL"), std::string("C")));
+
+                        try {
+                            subprocess::subprocess stripProc(args, env);
+
+                            const auto result = stripProc.run();
+                            const auto& err = result.stderr_string();
+
+                            // strip fails to add program headers to some files, which leaves them intact, though
+                            if (result.exit_code() != 0 && !util::stringContains(err, "Not enough room for program headers")) {
+                                ldLog() << LD_ERROR << "Strip call failed:" << err << std::endl;
+                                return false;
+                            }
+                        } catch (const std::exception&) {
+                            return false;
+                        }
+
+                        return true;
                     }
             };
 
@@ -165,128 +2397,298 @@ namespace linuxdeploy {
                 if (!bf::exists(path))
                     throw ElfFileParseError("No such file or directory: " + path.string());
 
-                // check magic bytes
-                std::ifstream ifs(path.string());
-                if (!ifs)
-                    throw ElfFileParseError("Could not open file: " + path.string());
+                ElfFileReader reader(path);
+
+                std::unique_ptr<PrivateData> data(new PrivateData(path));
 
-                std::vector<char> magicBytes(4);
-                ifs.read(magicBytes.data(), 4);
+                // files which have been parsed before don't need to be read again
+                auto& parseCache = ParseCache::getInstance();
 
-                if (strncmp(magicBytes.data(), "\177ELF", 4) != 0)
-                    throw ElfFileParseError("Invalid magic bytes in file header");
+                if (!parseCache.lookup(reader.stat(), *data)) {
+                    data->probe(reader);
+                    parseCache.insert(reader.stat(), *data);
+                }
 
-                d = new PrivateData(path);
-                d->readDataUsingElfAPI();
+                d = data.release();
             }
 
             ElfFile::~ElfFile() {
                 delete d;
             }
 
-            std::vector<bf::path> ElfFile::traceDynamicDependencies() {
-                // this method's purpose is to abstract this process
-                // the caller doesn't care _how_ it's done, after all
+            std::map<bf::path, DependencyTraceResult> ElfFile::traceDynamicDependencies(const std::vector<bf::path>& paths) {
+                util::thread_pool::ThreadPool pool(1);
+                return traceDynamicDependencies(paths, pool);
+            }
 
-                // for now, we use the same ldd based method linuxdeployqt uses
+            std::map<bf::path, DependencyTraceResult> ElfFile::traceDynamicDependencies(const std::vector<bf::path>& paths, util::thread_pool::ThreadPool& pool) {
+                // the results are collected per path, the order in which the tasks finish doesn't matter
+                std::vector<DependencyTraceResult> results(paths.size());
 
-                std::vector<bf::path> paths;
+                const auto resolver = getDependencyResolver();
 
-                subprocess::subprocess_env_map_t env;
-                env["LC_ALL"] = "C";
+                // whether the native resolver failed to find a dependency, or hasn't been used
+                std::unique_ptr<bool[]> needsLdd(new bool[paths.size()]());
 
-                // workaround for https://sourceware.org/bugzilla/show_bug.cgi?id=25263
-                // when you pass an absolute path to ldd, it can find libraries referenced in the rpath properly
-                // this bug was first found when trying to find a library next to the binary which contained $ORIGIN
-                // note that this is just a bug in ldd, the linker has always worked as intended
-                const auto resolvedPath = bf::canonical(d->path);
+                std::vector<std::function<void()>> tasks;
 
-                subprocess::subprocess lddProc({"ldd", resolvedPath.string()}, env);
+                for (size_t i = 0; i < paths.size(); ++i) {
+                    tasks.emplace_back([&paths, &results, &needsLdd, &pool, resolver, i]() {
+                        try {
+                            if (PrivateData::lookUpDependenciesInCache(paths[i], results[i].dependencies))
+                                return;
 
-                const auto result = lddProc.run();
+                            if (resolver == LDD_RESOLVER) {
+                                needsLdd[i] = true;
+                                return;
+                            }
 
-                if (result.exit_code() != 0) {
-                    if (result.stdout_string().find("not a dynamic executable") != std::string::npos || result.stderr_string().find("not a dynamic executable") != std::string::npos) {
-                        ldLog() << LD_WARNING << this->d->path << "is not linked dynamically" << std::endl;
-                        return {};
-                    }
+                            results[i].dependencies = ElfFile(paths[i]).d->traceDynamicDependenciesNatively(&pool);
+                            PrivateData::storeDependenciesInCache(paths[i], results[i].dependencies);
+                        } catch (const DependencyNotFoundError& e) {
+                            // see traceDynamicDependencies()
+                            results[i].error = e.what();
+                            needsLdd[i] = true;
+                        } catch (const ElfFileParseError& e) {
+                            results[i].error = e.what();
+                        } catch (const std::exception& e) {
+                            // like the other errors, this affects the current file only
+                            results[i].error = e.what();
+                        }
+                    });
+                }
+
+                pool.run(tasks);
+
+                std::vector<bf::path> lddPaths;
 
-                    throw std::runtime_error{"Failed to run ldd: exited with code " + std::to_string(result.exit_code())};
+                for (size_t i = 0; i < paths.size(); ++i) {
+                    if (needsLdd[i]) {
+                        if (!results[i].error.empty())
+                            ldLog() << LD_DEBUG << results[i].error << LD_NO_SPACE << ", falling back to ldd" << std::endl;
+
+                        lddPaths.emplace_back(paths[i]);
+                    }
                 }
 
-                const boost::regex expr(R"(\s*(.+)\s+\=>\s+(.+)\s+\((.+)\)\s*)");
-                boost::smatch what;
+                std::map<bf::path, DependencyTraceResult> mergedResults;
 
-                for (const auto& line : util::splitLines(result.stdout_string())) {
-                    if (boost::regex_search(line, what, expr)) {
-                        auto libraryPath = what[2].str();
-                        util::trim(libraryPath);
-                        paths.push_back(bf::absolute(libraryPath));
-                    } else {
-                        if (util::stringContains(line, "=> not found")) {
-                            auto missingLib = line;
-                            static const std::string pattern = "=> not found";
-                            missingLib.erase(missingLib.find(pattern), pattern.size());
-                            util::trim(missingLib);
-                            util::trim(missingLib, '\t');
-                            throw DependencyNotFoundError("Could not find dependency: " + missingLib);
-                        } else {
-                            ldLog() << LD_DEBUG << "Invalid ldd output: " << line << std::endl;
-                        }
+                for (size_t i = 0; i < paths.size(); ++i)
+                    mergedResults[paths[i]] = results[i];
+
+                if (!lddPaths.empty()) {
+                    for (const auto& result : PrivateData::traceDynamicDependenciesUsingLdd(lddPaths)) {
+                        mergedResults[result.first] = result.second;
+
+                        if (result.second.error.empty())
+                            PrivateData::storeDependenciesInCache(result.first, result.second.dependencies);
                     }
                 }
 
-                return paths;
+                return mergedResults;
+            }
+
+            std::vector<bf::path> ElfFile::traceDynamicDependencies() {
+                util::thread_pool::ThreadPool pool(1);
+                return traceDynamicDependencies(pool);
+            }
+
+            std::vector<bf::path> ElfFile::traceDynamicDependencies(util::thread_pool::ThreadPool& pool) {
+                std::vector<bf::path> dependencies;
+
+                if (PrivateData::lookUpDependenciesInCache(d->path, dependencies))
+                    return dependencies;
+
+                dependencies = d->traceDynamicDependencies(pool);
+                PrivateData::storeDependenciesInCache(d->path, dependencies);
+
+                return dependencies;
             }
 
             std::string ElfFile::getRPath() {
-                // don't try to fetch patchelf path in a catchall to make sure the process exists when the tool cannot be found
-                const auto patchelfPath = PrivateData::getPatchelfPath();
+                if (getRPathEditor() == NATIVE_EDITOR)
+                    return d->getRPathNatively();
 
-                try {
-                    subprocess::subprocess patchelfProc({patchelfPath, "--print-rpath", d->path.string()});
+                // reading the value natively is about as fast as validating a cache entry, but running patchelf is not
+                const auto dependencyCache = getDependencyCache();
+                dependency_cache::CachedFile cachedFile;
 
-                    const auto result = patchelfProc.run();
+                if (dependencyCache != nullptr && dependencyCache->lookup(d->path, cachedFile))
+                    return cachedFile.rpath;
 
-                    if (result.exit_code() != 0) {
-                        // if file is not an ELF executable, there is no need for a detailed error message
-                        if (result.exit_code() == 1 && result.stderr_string().find("not an ELF executable") != std::string::npos) {
-                            return "";
-                        } else {
-                            ldLog() << LD_ERROR << "Call to patchelf failed:" << std::endl << result.stderr_string();
-                            return "";
+                cachedFile.rpath = d->getRPathUsingPatchelf();
+
+                if (dependencyCache != nullptr)
+                    dependencyCache->insert(d->path, cachedFile);
+
+                return cachedFile.rpath;
+            }
+
+            bool ElfFile::setRPath(const std::string& value) {
+                auto& parseCache = ParseCache::getInstance();
+
+                if (getRPathEditor() == NATIVE_EDITOR) {
+                    try {
+                        if (d->setRPathNatively(value)) {
+                            // the data has been updated already, no need to parse the file again
+                            parseCache.insert(d->path, *d);
+                            return true;
                         }
+                    } catch (const ElfFileParseError& e) {
+                        ldLog() << LD_WARNING << "Failed to set rpath natively:" << e.what() << std::endl;
                     }
 
-                    auto stdoutContents = result.stdout_string();
+                    ldLog() << LD_DEBUG << "Cannot set rpath in place, falling back to patchelf:" << d->path << std::endl;
+                }
+
+                const auto success = d->setRPathUsingPatchelf(value);
+
+                // patchelf might have restructured the file
+                parseCache.invalidate(d->path);
 
-                    util::trim(stdoutContents, '\n');
-                    util::trim(stdoutContents);
+                return success;
+            }
+
+            bool ElfFile::strip(const bf::path& destination) {
+                if (getStripper() == NATIVE_STRIPPER) {
+                    try {
+                        if (d->stripNatively(destination))
+                            return true;
+                    } catch (const ElfFileParseError& e) {
+                        ldLog() << LD_WARNING << "Failed to strip file natively:" << e.what() << std::endl;
+                    }
 
-                    return stdoutContents;
-                } catch (const std::exception&) {
-                    return "";
+                    ldLog() << LD_DEBUG << "Cannot strip file natively, falling back to strip:" << d->path << std::endl;
                 }
+
+                return d->stripUsingBinutils(destination);
             }
 
-            bool ElfFile::setRPath(const std::string& value) {
+            std::map<bf::path, std::string> ElfFile::setRPaths(const std::map<bf::path, std::string>& rpaths, util::thread_pool::ThreadPool& pool, std::map<bf::path, FileMessages>* messages) {
+                auto& parseCache = ParseCache::getInstance();
+
+                // the files are edited in parallel, therefore every file must be edited only once, even if it's passed
+                // with multiple paths, in which case the last value wins, like it would when setting them one by one
+                std::map<bf::path, size_t> indicesByCanonicalPath;
+                std::vector<std::pair<bf::path, std::string>> entries;
+
+                for (const auto& rpath : rpaths) {
+                    boost::system::error_code ec;
+                    auto canonicalPath = bf::canonical(rpath.first, ec);
+
+                    if (ec)
+                        canonicalPath = rpath.first;
+
+                    const auto it = indicesByCanonicalPath.find(canonicalPath);
+
+                    if (it != indicesByCanonicalPath.end()) {
+                        entries[it->second] = rpath;
+                    } else {
+                        indicesByCanonicalPath[canonicalPath] = entries.size();
+                        entries.emplace_back(rpath);
+                    }
+                }
+
+                // the flags are set by multiple threads, which std::vector<bool> does not support
+                std::vector<char> needsPatchelf(entries.size(), true);
+                std::vector<std::string> nativeErrors(entries.size());
+
+                if (getRPathEditor() == NATIVE_EDITOR) {
+                    std::vector<std::function<void()>> tasks;
+
+                    for (size_t i = 0; i < entries.size(); ++i) {
+                        tasks.emplace_back([i, &entries, &needsPatchelf, &nativeErrors, &parseCache]() {
+                            try {
+                                ElfFile elfFile(entries[i].first);
+
+                                if (elfFile.d->setRPathNatively(entries[i].second)) {
+                                    parseCache.insert(elfFile.d->path, *elfFile.d);
+                                    needsPatchelf[i] = false;
+                                }
+                            } catch (const ElfFileParseError& e) {
+                                nativeErrors[i] = e.what();
+                            }
+                        });
+                    }
+
+                    pool.run(tasks);
+
+                    auto log = [messages](const bf::path& path, LD_LOGLEVEL level, const std::string& message) {
+                        if (messages != nullptr)
+                            (*messages)[path].emplace_back(level, message);
+                        else
+                            ldLog() << level << message << std::endl;
+                    };
+
+                    for (size_t i = 0; i < entries.size(); ++i) {
+                        const auto& path = entries[i].first;
+
+                        if (!nativeErrors[i].empty())
+                            log(path, LD_WARNING, "Failed to set rpath natively: " + nativeErrors[i]);
+
+                        if (needsPatchelf[i])
+                            log(path, LD_DEBUG, "Cannot set rpath in place, falling back to patchelf: " + path.string());
+                    }
+                }
+
+                // most files share a few values, e.g., $ORIGIN, so the files are grouped by value, and every group is
+                // passed to patchelf in as few calls as possible
+                std::map<std::string, std::vector<std::string>> filesByValue;
+
+                for (size_t i = 0; i < entries.size(); ++i) {
+                    if (needsPatchelf[i])
+                        filesByValue[entries[i].second].emplace_back(entries[i].first.string());
+                }
+
+                std::map<bf::path, std::string> errors;
+
+                if (filesByValue.empty())
+                    return errors;
+
                 // don't try to fetch patchelf path in a catchall to make sure the process exists when the tool cannot be found
                 const auto patchelfPath = PrivateData::getPatchelfPath();
 
-                try {
-                    subprocess::subprocess patchelfProc({patchelfPath.c_str(), "--set-rpath", value.c_str(), d->path.c_str()});
+                std::vector<std::pair<std::string, std::vector<std::string>>> chunks;
 
-                    const auto result = patchelfProc.run();
+                for (const auto& group : filesByValue) {
+                    for (const auto& chunk : PrivateData::splitArguments(group.second))
+                        chunks.emplace_back(group.first, chunk);
+                }
 
-                    if (result.exit_code() != 0) {
-                        ldLog() << LD_ERROR << "Call to patchelf failed:" << std::endl << result.stderr_string() << std::endl;
-                        return false;
-                    }
-                } catch (const std::exception&) {
-                    return false;
+                ldLog() << LD_DEBUG << "Setting rpath of" << static_cast<size_t>(std::count(needsPatchelf.begin(), needsPatchelf.end(), true))
+                        << "files with" << chunks.size() << "patchelf calls" << std::endl;
+
+                std::mutex errorsMutex;
+                std::vector<std::function<void()>> tasks;
+
+                for (const auto& chunk : chunks) {
+                    tasks.emplace_back([&chunk, &patchelfPath, &errors, &errorsMutex]() {
+                        if (PrivateData::runPatchelfSetRPath(patchelfPath, chunk.first, chunk.second).empty())
+                            return;
+
+                        // patchelf stops at the first file it fails to edit, therefore we don't know which files have
+                        // been edited, and need to try the files one by one to find the failing ones
+                        // setting the same value again has no effect on the files which have been edited already
+                        for (const auto& file : chunk.second) {
+                            const auto error = PrivateData::runPatchelfSetRPath(patchelfPath, chunk.first, {file});
+
+                            if (!error.empty()) {
+                                std::lock_guard<std::mutex> lock(errorsMutex);
+                                errors[file] = error;
+                            }
+                        }
+                    });
+                }
+
+                pool.run(tasks);
+
+                // patchelf might have restructured the files
+                for (const auto& group : filesByValue) {
+                    for (const auto& file : group.second)
+                        parseCache.invalidate(file);
                 }
 
-                return true;
+                return errors;
             }
 
             uint8_t ElfFile::getSystemElfABI() {
@@ -333,6 +2735,100 @@ namespace linuxdeploy {
                 #endif
             }
 
+            namespace {
+                // -1 means the resolver has not been selected yet
+                int dependencyResolver = -1;
+            }
+
+            void ElfFile::setDependencyResolver(DEPENDENCY_RESOLVER resolver) {
+                dependencyResolver = resolver;
+            }
+
+            DEPENDENCY_RESOLVER ElfFile::getDependencyResolver() {
+                if (dependencyResolver < 0) {
+                    // allow users to switch back to ldd, e.g., if they use an unusual loader configuration
+                    if (getenv("USE_LDD") != nullptr) {
+                        ldLog() << LD_WARNING << "$USE_LDD environment variable detected, using ldd to resolve dependencies" << std::endl;
+                        dependencyResolver = LDD_RESOLVER;
+                    } else {
+                        dependencyResolver = NATIVE_RESOLVER;
+                    }
+                }
+
+                return static_cast<DEPENDENCY_RESOLVER>(dependencyResolver);
+            }
+
+            namespace {
+                // -1 means the editor has not been selected yet
+                int rpathEditor = -1;
+            }
+
+            void ElfFile::setRPathEditor(RPATH_EDITOR editor) {
+                rpathEditor = editor;
+            }
+
+            RPATH_EDITOR ElfFile::getRPathEditor() {
+                if (rpathEditor < 0) {
+                    // allow users to switch back to patchelf, e.g., if they need to edit unusual binaries
+                    if (getenv("USE_PATCHELF") != nullptr) {
+                        ldLog() << LD_WARNING << "$USE_PATCHELF environment variable detected, using patchelf to edit rpaths" << std::endl;
+                        rpathEditor = PATCHELF_EDITOR;
+                    } else {
+                        rpathEditor = NATIVE_EDITOR;
+                    }
+                }
+
+                return static_cast<RPATH_EDITOR>(rpathEditor);
+            }
+
+            namespace {
+                // -1 means the stripper has not been selected yet
+                int stripper = -1;
+            }
+
+            void ElfFile::setStripper(STRIPPER value) {
+                stripper = value;
+            }
+
+            STRIPPER ElfFile::getStripper() {
+                if (stripper < 0) {
+                    // allow users to switch back to strip, e.g., if they need to strip unusual binaries
+                    if (getenv("USE_STRIP") != nullptr) {
+                        ldLog() << LD_WARNING << "$USE_STRIP environment variable detected, using strip to strip binaries" << std::endl;
+                        stripper = BINUTILS_STRIPPER;
+                    } else {
+                        stripper = NATIVE_STRIPPER;
+                    }
+                }
+
+                return static_cast<STRIPPER>(stripper);
+            }
+
+            namespace {
+                // the persistent cache is disabled unless a cache is set
+                std::shared_ptr<dependency_cache::DependencyCache> dependencyCache;
+            }
+
+            void ElfFile::setDependencyCache(std::shared_ptr<dependency_cache::DependencyCache> cache) {
+                dependencyCache = std::move(cache);
+            }
+
+            std::shared_ptr<dependency_cache::DependencyCache> ElfFile::getDependencyCache() {
+                return dependencyCache;
+            }
+
+            size_t ElfFile::getParseCacheHits() {
+                return ParseCache::getInstance().getHits();
+            }
+
+            size_t ElfFile::getParseCacheMisses() {
+                return ParseCache::getInstance().getMisses();
+            }
+
+            void ElfFile::clearParseCache() {
+                ParseCache::getInstance().clear();
+            }
+
             uint8_t ElfFile::getElfClass()  {
                 return d->elfClass;
             }
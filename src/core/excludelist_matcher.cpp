@@ -0,0 +1,538 @@
+// system includes
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+// local headers
+#include "linuxdeploy/core/excludelist_matcher.h"
+
+// generated at build time by generate-excludelist.sh
+#include "excludelist.h"
+
+namespace bf = boost::filesystem;
+
+namespace linuxdeploy {
+    namespace core {
+        namespace excludelist_matcher {
+            namespace {
+                typedef uint64_t Word;
+                constexpr size_t wordBits = 64;
+
+                // a single step of a glob pattern
+                // with FNM_PATHNAME, neither of them ever matches a slash
+                class Token {
+                    public:
+                        // * matches any number of characters
+                        bool isStar = false;
+
+                        // characters a single character step (literal character, ? or bracket expression) accepts
+                        std::bitset<256> characters;
+                };
+
+                // FNV-1a, followed by MurmurHash3's finalizer, which spreads the bits evenly
+                uint64_t hashString(const char* data, size_t size, uint64_t seed) {
+                    uint64_t hash = 14695981039346656037ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+
+                    for (size_t i = 0; i < size; ++i) {
+                        hash ^= static_cast<unsigned char>(data[i]);
+                        hash *= 1099511628211ULL;
+                    }
+
+                    hash ^= hash >> 33;
+                    hash *= 0xff51afd7ed558ccdULL;
+                    hash ^= hash >> 33;
+                    hash *= 0xc4ceb9fe1a85ec53ULL;
+                    hash ^= hash >> 33;
+
+                    return hash;
+                }
+
+                bool matchesCharacterClass(const std::string& name, int c) {
+                    if (name == "alnum") return isalnum(c) != 0;
+                    if (name == "alpha") return isalpha(c) != 0;
+                    if (name == "blank") return isblank(c) != 0;
+                    if (name == "cntrl") return iscntrl(c) != 0;
+                    if (name == "digit") return isdigit(c) != 0;
+                    if (name == "graph") return isgraph(c) != 0;
+                    if (name == "lower") return islower(c) != 0;
+                    if (name == "print") return isprint(c) != 0;
+                    if (name == "punct") return ispunct(c) != 0;
+                    if (name == "space") return isspace(c) != 0;
+                    if (name == "upper") return isupper(c) != 0;
+                    return isxdigit(c) != 0;
+                }
+
+                bool isCharacterClass(const std::string& name) {
+                    static const std::set<std::string> names = {
+                        "alnum", "alpha", "blank", "cntrl", "digit", "graph",
+                        "lower", "print", "punct", "space", "upper", "xdigit",
+                    };
+                    return names.find(name) != names.end();
+                }
+
+                // parse bracket expression starting at pattern[begin], which must be a [
+                // returns the position after the closing ], or begin if the expression isn't terminated, in which
+                // case fnmatch() treats the [ as a literal character
+                size_t parseBracketExpression(const std::string& pattern, size_t begin, std::bitset<256>& characters) {
+                    auto pos = begin + 1;
+
+                    bool negate = false;
+                    if (pos < pattern.size() && (pattern[pos] == '!' || pattern[pos] == '^')) {
+                        negate = true;
+                        ++pos;
+                    }
+
+                    std::bitset<256> set;
+
+                    // a ] right at the beginning is a regular member of the set
+                    bool first = true;
+
+                    while (pos < pattern.size()) {
+                        if (pattern[pos] == ']' && !first) {
+                            if (negate)
+                                set.flip();
+
+                            characters = set;
+                            characters.reset('/');
+                            return pos + 1;
+                        }
+
+                        first = false;
+
+                        // character classes like [:digit:]
+                        if (pattern.compare(pos, 2, "[:") == 0) {
+                            const auto end = pattern.find(":]", pos + 2);
+
+                            if (end != std::string::npos) {
+                                const auto name = pattern.substr(pos + 2, end - pos - 2);
+
+                                if (!isCharacterClass(name))
+                                    return begin;
+
+                                for (int c = 0; c < 256; ++c) {
+                                    if (matchesCharacterClass(name, c))
+                                        set.set(c);
+                                }
+
+                                pos = end + 2;
+                                continue;
+                            }
+                        }
+
+                        if (pattern[pos] == '\\' && pos + 1 < pattern.size())
+                            ++pos;
+
+                        const auto from = static_cast<unsigned char>(pattern[pos]);
+                        ++pos;
+
+                        // ranges like a-z, a - at the end of the expression is a regular member of the set
+                        if (pos + 1 < pattern.size() && pattern[pos] == '-' && pattern[pos + 1] != ']') {
+                            ++pos;
+
+                            if (pattern[pos] == '\\' && pos + 1 < pattern.size())
+                                ++pos;
+
+                            const auto to = static_cast<unsigned char>(pattern[pos]);
+                            ++pos;
+
+                            for (int c = from; c <= to; ++c)
+                                set.set(c);
+                        } else {
+                            set.set(from);
+                        }
+                    }
+
+                    return begin;
+                }
+
+                std::vector<Token> compilePattern(const std::string& pattern) {
+                    std::vector<Token> tokens;
+
+                    for (size_t pos = 0; pos < pattern.size();) {
+                        Token token;
+
+                        switch (pattern[pos]) {
+                            case '*': {
+                                ++pos;
+
+                                // consecutive stars are equivalent to a single one
+                                if (!tokens.empty() && tokens.back().isStar)
+                                    continue;
+
+                                token.isStar = true;
+                                break;
+                            }
+                            case '?': {
+                                ++pos;
+                                token.characters.set();
+                                token.characters.reset('/');
+                                break;
+                            }
+                            case '[': {
+                                const auto end = parseBracketExpression(pattern, pos, token.characters);
+
+                                if (end != pos) {
+                                    pos = end;
+                                    break;
+                                }
+
+                                token.characters.set('[');
+                                ++pos;
+                                break;
+                            }
+                            default: {
+                                // a backslash makes the next character a literal one
+                                if (pattern[pos] == '\\' && pos + 1 < pattern.size())
+                                    ++pos;
+
+                                token.characters.set(static_cast<unsigned char>(pattern[pos]));
+                                ++pos;
+                                break;
+                            }
+                        }
+
+                        tokens.emplace_back(token);
+                    }
+
+                    return tokens;
+                }
+            }
+
+            class ExcludelistMatcher::PrivateData {
+                public:
+                    // perfect hash table of the literal filenames, built using the "hash and displace" method
+                    // every literal is assigned to a bucket by its hash, and every bucket is assigned a displacement,
+                    // which is chosen so that the slots calculated from the hash and the displacement of all the
+                    // literals in the table are distinct
+                    std::vector<std::string> literals;
+                    uint64_t seed = 0;
+                    std::vector<uint32_t> displacements;
+                    // indices of the literals, -1 for empty slots
+                    std::vector<int32_t> slots;
+
+                    // combined automaton of all the glob patterns
+                    // every pattern with N tokens occupies N + 1 consecutive states, one per token, plus the
+                    // accepting state
+                    // the set of active states is stored as a bit vector, and a step over all the patterns consists
+                    // of a few bitwise operations per word
+                    std::vector<std::string> patterns;
+                    size_t wordsCount = 0;
+                    // per character, the states whose token accepts the character
+                    std::vector<Word> characterMasks;
+                    // states whose token is a *
+                    std::vector<Word> starMask;
+                    std::vector<Word> initialStates;
+                    std::vector<Word> acceptingStates;
+
+                public:
+                    PrivateData(const std::vector<std::string>& literals, const std::vector<std::string>& patterns) {
+                        // duplicates would make building the perfect hash table impossible
+                        const std::set<std::string> uniqueLiterals(literals.begin(), literals.end());
+                        this->literals.assign(uniqueLiterals.begin(), uniqueLiterals.end());
+
+                        const std::set<std::string> uniquePatterns(patterns.begin(), patterns.end());
+                        this->patterns.assign(uniquePatterns.begin(), uniquePatterns.end());
+
+                        buildHashTable();
+                        buildAutomaton();
+                    }
+
+                public:
+                    uint32_t slotIndex(uint64_t hash, uint32_t displacement) const {
+                        // the step is odd and the table size a power of two, so trying all the displacements visits
+                        // every slot
+                        const auto begin = static_cast<uint32_t>(hash);
+                        const auto step = static_cast<uint32_t>(hash >> 32) | 1u;
+                        return (begin + displacement * step) & static_cast<uint32_t>(slots.size() - 1);
+                    }
+
+                    bool tryBuildHashTable(uint64_t seed) {
+                        const auto tableSize = slots.size();
+                        const auto bucketsCount = displacements.size();
+
+                        std::vector<uint64_t> hashes;
+                        std::vector<std::vector<uint32_t>> buckets(bucketsCount);
+
+                        for (const auto& literal : literals) {
+                            const auto hash = hashString(literal.data(), literal.size(), seed);
+                            buckets[hash % bucketsCount].emplace_back(static_cast<uint32_t>(hashes.size()));
+                            hashes.emplace_back(hash);
+                        }
+
+                        // the large buckets are the hardest to place, therefore they're placed first
+                        std::vector<uint32_t> order(bucketsCount);
+                        for (uint32_t i = 0; i < bucketsCount; ++i)
+                            order[i] = i;
+
+                        std::stable_sort(order.begin(), order.end(), [&buckets](uint32_t a, uint32_t b) {
+                            return buckets[a].size() > buckets[b].size();
+                        });
+
+                        std::fill(slots.begin(), slots.end(), -1);
+                        std::fill(displacements.begin(), displacements.end(), 0);
+
+                        std::vector<uint32_t> bucketSlots;
+
+                        for (const auto bucketIndex : order) {
+                            const auto& bucket = buckets[bucketIndex];
+
+                            if (bucket.empty())
+                                break;
+
+                            bool placed = false;
+
+                            for (uint32_t displacement = 0; displacement < tableSize && !placed; ++displacement) {
+                                bucketSlots.clear();
+
+                                placed = true;
+
+                                for (const auto literalIndex : bucket) {
+                                    const auto slot = slotIndex(hashes[literalIndex], displacement);
+
+                                    if (slots[slot] >= 0 || std::find(bucketSlots.begin(), bucketSlots.end(), slot) != bucketSlots.end()) {
+                                        placed = false;
+                                        break;
+                                    }
+
+                                    bucketSlots.emplace_back(slot);
+                                }
+
+                                if (placed) {
+                                    for (size_t i = 0; i < bucket.size(); ++i)
+                                        slots[bucketSlots[i]] = static_cast<int32_t>(bucket[i]);
+
+                                    displacements[bucketIndex] = displacement;
+                                }
+                            }
+
+                            // two literals in the bucket have the same slots for every displacement, a different seed
+                            // is needed
+                            if (!placed)
+                                return false;
+                        }
+
+                        this->seed = seed;
+                        return true;
+                    }
+
+                    void buildHashTable() {
+                        if (literals.empty())
+                            return;
+
+                        // a load factor of at most 0.5 and two literals per bucket on average make it easy to find
+                        // suitable displacements
+                        size_t tableSize = 2;
+                        while (tableSize < 2 * literals.size())
+                            tableSize *= 2;
+
+                        slots.resize(tableSize);
+                        displacements.resize(literals.size() / 2 + 1);
+
+                        for (uint64_t seed = 0; !tryBuildHashTable(seed); ++seed);
+                    }
+
+                    static void setState(std::vector<Word>& states, size_t state) {
+                        states[state / wordBits] |= Word(1) << (state % wordBits);
+                    }
+
+                    void buildAutomaton() {
+                        std::vector<std::vector<Token>> compiledPatterns;
+                        size_t statesCount = 0;
+
+                        for (const auto& pattern : patterns) {
+                            compiledPatterns.emplace_back(compilePattern(pattern));
+                            statesCount += compiledPatterns.back().size() + 1;
+                        }
+
+                        wordsCount = (statesCount + wordBits - 1) / wordBits;
+
+                        characterMasks.assign(256 * wordsCount, 0);
+                        starMask.assign(wordsCount, 0);
+                        initialStates.assign(wordsCount, 0);
+                        acceptingStates.assign(wordsCount, 0);
+
+                        size_t state = 0;
+
+                        for (const auto& tokens : compiledPatterns) {
+                            setState(initialStates, state);
+
+                            for (const auto& token : tokens) {
+                                if (token.isStar) {
+                                    setState(starMask, state);
+                                } else {
+                                    for (int c = 0; c < 256; ++c) {
+                                        if (token.characters.test(c))
+                                            characterMasks[c * wordsCount + state / wordBits] |= Word(1) << (state % wordBits);
+                                    }
+                                }
+
+                                ++state;
+                            }
+
+                            setState(acceptingStates, state);
+                            ++state;
+                        }
+
+                        // a * may also match zero characters
+                        followStars(initialStates.data());
+                    }
+
+                    // activate the states following active * states
+                    // there are no consecutive *s, therefore a single pass is sufficient
+                    void followStars(Word* states) const {
+                        Word carry = 0;
+
+                        for (size_t i = 0; i < wordsCount; ++i) {
+                            const auto stars = states[i] & starMask[i];
+                            states[i] |= (stars << 1) | carry;
+                            carry = stars >> (wordBits - 1);
+                        }
+                    }
+
+                    bool matchesLiteral(const std::string& fileName) const {
+                        if (slots.empty())
+                            return false;
+
+                        const auto hash = hashString(fileName.data(), fileName.size(), seed);
+                        const auto index = slots[slotIndex(hash, displacements[hash % displacements.size()])];
+
+                        return index >= 0 && literals[index] == fileName;
+                    }
+
+                    bool matchesPattern(const std::string& fileName) const {
+                        if (wordsCount == 0)
+                            return false;
+
+                        // the excludelists in use are small enough to avoid allocations
+                        std::array<Word, 32> stackBuffer;
+                        std::vector<Word> heapBuffer;
+
+                        Word* states = stackBuffer.data();
+                        Word* nextStates = stackBuffer.data() + wordsCount;
+
+                        if (2 * wordsCount > stackBuffer.size()) {
+                            heapBuffer.resize(2 * wordsCount);
+                            states = heapBuffer.data();
+                            nextStates = heapBuffer.data() + wordsCount;
+                        }
+
+                        std::copy(initialStates.begin(), initialStates.end(), states);
+
+                        for (const auto character : fileName) {
+                            const auto c = static_cast<unsigned char>(character);
+                            const auto* mask = characterMasks.data() + c * wordsCount;
+
+                            Word carry = 0;
+                            Word active = 0;
+
+                            for (size_t i = 0; i < wordsCount; ++i) {
+                                // states whose token accepts the character advance to the next state, *s stay where
+                                // they are
+                                const auto advancing = states[i] & mask[i];
+                                nextStates[i] = (advancing << 1) | carry;
+                                carry = advancing >> (wordBits - 1);
+
+                                if (c != '/')
+                                    nextStates[i] |= states[i] & starMask[i];
+
+                                active |= nextStates[i];
+                            }
+
+                            if (active == 0)
+                                return false;
+
+                            followStars(nextStates);
+                            std::swap(states, nextStates);
+                        }
+
+                        for (size_t i = 0; i < wordsCount; ++i) {
+                            if ((states[i] & acceptingStates[i]) != 0)
+                                return true;
+                        }
+
+                        return false;
+                    }
+            };
+
+            ExcludelistMatcher::ExcludelistMatcher(const std::vector<std::string>& entries) : d(nullptr) {
+                std::vector<std::string> literals;
+                std::vector<std::string> patterns;
+
+                for (const auto& entry : entries) {
+                    if (isPattern(entry))
+                        patterns.emplace_back(entry);
+                    else
+                        literals.emplace_back(entry);
+                }
+
+                d = new PrivateData(literals, patterns);
+            }
+
+            ExcludelistMatcher::ExcludelistMatcher(const std::vector<std::string>& literals, const std::vector<std::string>& patterns)
+                : d(new PrivateData(literals, patterns)) {}
+
+            ExcludelistMatcher::~ExcludelistMatcher() {
+                delete d;
+            }
+
+            const ExcludelistMatcher& ExcludelistMatcher::getGenerated() {
+                // the list has been split into literals and patterns by generate-excludelist.sh already
+                static const ExcludelistMatcher matcher(generatedExcludelistLiterals, generatedExcludelistPatterns);
+                return matcher;
+            }
+
+            std::vector<std::string> ExcludelistMatcher::getGeneratedEntries() {
+                auto entries = generatedExcludelistLiterals;
+                entries.insert(entries.end(), generatedExcludelistPatterns.begin(), generatedExcludelistPatterns.end());
+                return entries;
+            }
+
+            std::vector<std::string> ExcludelistMatcher::readEntries(const bf::path& path) {
+                std::ifstream ifs(path.string());
+
+                if (!ifs)
+                    throw ExcludelistError("Failed to open excludelist file " + path.string());
+
+                std::vector<std::string> entries;
+                std::string line;
+
+                while (std::getline(ifs, line)) {
+                    line = line.substr(0, line.find('#'));
+
+                    // like generate-excludelist.sh, entries are separated by whitespace
+                    std::istringstream iss(line);
+                    std::string entry;
+
+                    while (iss >> entry)
+                        entries.emplace_back(entry);
+                }
+
+                if (ifs.bad())
+                    throw ExcludelistError("Failed to read excludelist file " + path.string());
+
+                return entries;
+            }
+
+            bool ExcludelistMatcher::isPattern(const std::string& entry) {
+                return entry.find_first_of("*?[\\") != std::string::npos;
+            }
+
+            bool ExcludelistMatcher::matches(const std::string& fileName) const {
+                return d->matchesLiteral(fileName) || d->matchesPattern(fileName);
+            }
+
+            size_t ExcludelistMatcher::literalsCount() const {
+                return d->literals.size();
+            }
+
+            size_t ExcludelistMatcher::patternsCount() const {
+                return d->patterns.size();
+            }
+        }
+    }
+}
@@ -50,16 +50,37 @@ cat > "$tempfile" <<\EOF
 #include <string>
 #include <vector>
 
-static const std::vector<std::string> generatedExcludelist = {
+// the entries are split into literal filenames and glob patterns, which ExcludelistMatcher compiles into separate
+// data structures
 EOF
 
-# create array
-for item in ${blacklisted[@]:0:${#blacklisted[@]}-1}; do
-    echo -e '    "'"$item"'",' >> "$tempfile"
+# patterns contain at least one of the characters fnmatch() treats specially
+literals=()
+patterns=()
+for item in "${blacklisted[@]}"; do
+    if [[ "$item" == *[\*\?\[\\]* ]]; then
+        patterns+=("$item")
+    else
+        literals+=("$item")
+    fi
 done
-echo -e '    "'"${blacklisted[$((${#blacklisted[@]}-1))]}"'"' >> "$tempfile"
 
-echo "};" >> "$tempfile"
+# create arrays
+write_array() {
+    local name="$1"
+    shift
+
+    echo >> "$tempfile"
+    echo "static const std::vector<std::string> $name = {" >> "$tempfile"
+    for item in "$@"; do
+        # backslashes have to be escaped in C++ string literals
+        echo '    "'"${item//\\/\\\\}"'",' >> "$tempfile"
+    done
+    echo "};" >> "$tempfile"
+}
+
+write_array generatedExcludelistLiterals "${literals[@]}"
+write_array generatedExcludelistPatterns "${patterns[@]}"
 
 # avoid overwriting if the contents have not changed
 # this prevents CMake having to recompile half of linuxdeploy even if nothing changed
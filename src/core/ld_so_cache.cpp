@@ -0,0 +1,517 @@
+// system includes
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <elf.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+// local headers
+#include "linuxdeploy/core/ld_so_cache.h"
+#include "linuxdeploy/core/log.h"
+
+using namespace linuxdeploy::core::log;
+
+namespace bf = boost::filesystem;
+
+namespace linuxdeploy {
+    namespace core {
+        namespace ld_so_cache {
+            namespace {
+                // the following definitions are taken from glibc's sysdeps/generic/dl-cache.h
+
+                // old format, also used by libc5
+                constexpr auto CACHEMAGIC = "ld.so-1.7.0";
+
+                struct file_entry {
+                    int32_t flags;
+                    uint32_t key, value;
+                };
+
+                struct cache_file {
+                    char magic[sizeof("ld.so-1.7.0") - 1];
+                    uint32_t nlibs;
+                    // followed by nlibs file_entry structs
+                };
+
+                // new format, which is the only one written by recent versions of ldconfig
+                constexpr auto CACHEMAGIC_NEW = "glibc-ld.so.cache";
+                constexpr auto CACHE_VERSION = "1.1";
+
+                struct file_entry_new {
+                    int32_t flags;
+                    uint32_t key, value;
+                    uint32_t osversion;
+                    uint64_t hwcap;
+                };
+
+                struct cache_file_new {
+                    char magic[sizeof("glibc-ld.so.cache") - 1];
+                    char version[sizeof("1.1") - 1];
+                    uint32_t nlibs;
+                    uint32_t len_strings;
+                    uint8_t flags;
+                    uint8_t padding_unused[3];
+                    uint32_t extension_offset;
+                    uint32_t unused[3];
+                    // followed by nlibs file_entry_new structs
+                };
+
+                // entries describing glibc-hwcaps subdirectories have this bit set in their hwcap field, the lower 32
+                // bits are the index of the subdirectory's name in the glibc-hwcaps extension section
+                constexpr uint64_t DL_CACHE_HWCAP_EXTENSION = 1ull << 62;
+
+                // the new format may be followed by extension sections
+                constexpr uint32_t CACHE_EXTENSION_MAGIC = static_cast<uint32_t>(-358342284);
+                constexpr uint32_t CACHE_EXTENSION_TAG_GLIBC_HWCAPS = 1;
+
+                struct cache_extension_section {
+                    uint32_t tag;
+                    uint32_t flags;
+                    // relative to the beginning of the file
+                    uint32_t offset;
+                    uint32_t size;
+                };
+
+                struct cache_extension {
+                    uint32_t magic;
+                    uint32_t count;
+                    // followed by count cache_extension_section structs
+                };
+
+                bool isHwcapExtension(uint64_t hwcap) {
+                    return (hwcap >> 32) == (DL_CACHE_HWCAP_EXTENSION >> 32);
+                }
+
+                // flags used by ldconfig to describe the type of a library
+                constexpr int32_t FLAG_ELF = 0x0001;
+                constexpr int32_t FLAG_ELF_LIBC6 = 0x0003;
+                constexpr int32_t FLAG_TYPE_MASK = 0x00ff;
+                constexpr int32_t FLAG_S390_LIB64 = 0x0400;
+                constexpr int32_t FLAG_X8664_LIB64 = 0x0300;
+                constexpr int32_t FLAG_POWERPC_LIB64 = 0x0500;
+                constexpr int32_t FLAG_X8664_LIBX32 = 0x0800;
+                constexpr int32_t FLAG_ARM_LIBHF = 0x0900;
+                constexpr int32_t FLAG_AARCH64_LIB64 = 0x0a00;
+
+                // equivalent of _dl_cache_check_flags() on the respective architectures
+                bool checkFlags(int32_t flags, uint8_t elfClass, uint16_t elfMachine) {
+                    switch (elfMachine) {
+                        case EM_X86_64:
+                            if (elfClass == ELFCLASS64)
+                                return flags == (FLAG_ELF_LIBC6 | FLAG_X8664_LIB64);
+                            return flags == (FLAG_ELF_LIBC6 | FLAG_X8664_LIBX32);
+                        case EM_AARCH64:
+                            return flags == (FLAG_ELF_LIBC6 | FLAG_AARCH64_LIB64);
+                        case EM_ARM:
+                            return flags == (FLAG_ELF_LIBC6 | FLAG_ARM_LIBHF) || flags == FLAG_ELF_LIBC6;
+                        case EM_PPC64:
+                            return flags == (FLAG_ELF_LIBC6 | FLAG_POWERPC_LIB64);
+                        case EM_S390:
+                            if (elfClass == ELFCLASS64)
+                                return flags == (FLAG_ELF_LIBC6 | FLAG_S390_LIB64);
+                            return flags == FLAG_ELF || flags == FLAG_ELF_LIBC6;
+                        case EM_386:
+                            return flags == FLAG_ELF || flags == FLAG_ELF_LIBC6;
+                        default:
+                            // we don't know the exact flags for every architecture, but the type is always the same
+                            // the caller needs to check the ELF header of the returned file
+                            return (flags & FLAG_TYPE_MASK) == FLAG_ELF_LIBC6;
+                    }
+                }
+
+                // equivalent of _dl_cache_libcmp(), which compares sequences of digits numerically
+                // the entries in the cache are sorted in descending order according to this function
+                int compareLibraryNames(const char* p1, const char* p2) {
+                    auto isDigit = [](char c) {
+                        return c >= '0' && c <= '9';
+                    };
+
+                    while (*p1 != '\0') {
+                        if (isDigit(*p1)) {
+                            if (!isDigit(*p2))
+                                return 1;
+
+                            long val1 = *p1++ - '0';
+                            long val2 = *p2++ - '0';
+
+                            while (isDigit(*p1))
+                                val1 = val1 * 10 + *p1++ - '0';
+                            while (isDigit(*p2))
+                                val2 = val2 * 10 + *p2++ - '0';
+
+                            if (val1 != val2)
+                                return val1 < val2 ? -1 : 1;
+                        } else if (isDigit(*p2)) {
+                            return -1;
+                        } else if (*p1 != *p2) {
+                            return static_cast<unsigned char>(*p1) - static_cast<unsigned char>(*p2);
+                        } else {
+                            ++p1;
+                            ++p2;
+                        }
+                    }
+
+                    return static_cast<unsigned char>(*p1) - static_cast<unsigned char>(*p2);
+                }
+
+                // the x86-64 microarchitecture levels the CPU supports, with the same checks the linker performs, see
+                // glibc's sysdeps/x86/get-isa-level.h
+                // returns the names in the order the linker searches them, i.e., the highest level comes first
+                std::vector<std::string> detectX8664Levels() {
+                    std::vector<std::string> levels;
+
+                #if defined(__x86_64__) || defined(__i386__)
+                    unsigned int eax, ebx, ecx1, edx, ecx7 = 0, ebx7 = 0, ecx81 = 0;
+
+                    if (!__get_cpuid(1, &eax, &ebx, &ecx1, &edx))
+                        return levels;
+
+                    if (__get_cpuid_max(0, nullptr) >= 7)
+                        __cpuid_count(7, 0, eax, ebx7, ecx7, edx);
+
+                    if (__get_cpuid_max(0x80000000, nullptr) >= 0x80000001)
+                        __get_cpuid(0x80000001, &eax, &ebx, &ecx81, &edx);
+
+                    auto hasBits = [](unsigned int value, std::initializer_list<int> bits) {
+                        return std::all_of(bits.begin(), bits.end(), [value](int bit) { return (value & (1u << bit)) != 0; });
+                    };
+
+                    // the registers must also be enabled by the operating system
+                    uint64_t xcr0 = 0;
+
+                    if (hasBits(ecx1, {27})) {
+                        uint32_t xcr0Low, xcr0High;
+                        __asm__ ("xgetbv" : "=a" (xcr0Low), "=d" (xcr0High) : "c" (0));
+                        xcr0 = (static_cast<uint64_t>(xcr0High) << 32) | xcr0Low;
+                    }
+
+                    // SSE3, SSSE3, CMPXCHG16B, SSE4.1, SSE4.2, POPCNT and LAHF/SAHF
+                    const bool v2 = hasBits(ecx1, {0, 9, 13, 19, 20, 23}) && hasBits(ecx81, {0});
+
+                    // FMA, MOVBE, OSXSAVE, AVX and F16C, BMI1, AVX2 and BMI2, LZCNT, SSE and AVX state
+                    const bool v3 = v2 && hasBits(ecx1, {12, 22, 27, 28, 29}) && hasBits(ebx7, {3, 5, 8}) &&
+                                    hasBits(ecx81, {5}) && (xcr0 & 0x6) == 0x6;
+
+                    // AVX512F, AVX512DQ, AVX512CD, AVX512BW and AVX512VL, opmask and ZMM state
+                    const bool v4 = v3 && hasBits(ebx7, {16, 17, 28, 30, 31}) && (xcr0 & 0xe0) == 0xe0;
+
+                    if (v4)
+                        levels.emplace_back("x86-64-v4");
+                    if (v3)
+                        levels.emplace_back("x86-64-v3");
+                    if (v2)
+                        levels.emplace_back("x86-64-v2");
+                #endif
+
+                    return levels;
+                }
+            }
+
+            std::vector<std::string> getGlibcHwcapsSubdirectories(uint8_t elfClass, uint16_t elfMachine) {
+                // the levels are only used by the 64-bit x86 linker
+                if (elfMachine != EM_X86_64 || elfClass != ELFCLASS64)
+                    return {};
+
+                static const auto levels = detectX8664Levels();
+                return levels;
+            }
+
+            class LdSoCache::PrivateData {
+                public:
+                    const uint8_t* data = nullptr;
+                    size_t dataSize = 0;
+
+                    // either one of the two formats is used for lookups, the new one is preferred
+                    const file_entry* oldEntries = nullptr;
+                    const file_entry_new* newEntries = nullptr;
+                    uint32_t entriesCount = 0;
+
+                    // offset relative to which the keys and values in the entries are stored
+                    size_t stringsOffset = 0;
+
+                    // names of the glibc-hwcaps subdirectories, referenced by the entries with DL_CACHE_HWCAP_EXTENSION
+                    std::vector<const char*> hwcapsNames;
+
+                public:
+                    explicit PrivateData(const bf::path& path) {
+                        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+                        if (fd < 0)
+                            throw LdSoCacheError("Could not open file: " + path.string());
+
+                        struct stat st{};
+
+                        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+                            ::close(fd);
+                            throw LdSoCacheError("Could not determine size of file: " + path.string());
+                        }
+
+                        dataSize = static_cast<size_t>(st.st_size);
+
+                        void* mapping = mmap(nullptr, dataSize, PROT_READ, MAP_PRIVATE, fd, 0);
+                        ::close(fd);
+
+                        if (mapping == MAP_FAILED)
+                            throw LdSoCacheError("Failed to map file: " + path.string());
+
+                        data = static_cast<const uint8_t*>(mapping);
+
+                        try {
+                            parseHeader();
+                        } catch (...) {
+                            munmap(const_cast<uint8_t*>(data), dataSize);
+                            throw;
+                        }
+                    }
+
+                    ~PrivateData() {
+                        munmap(const_cast<uint8_t*>(data), dataSize);
+                    }
+
+                private:
+                    bool isNewHeaderAt(size_t offset) const {
+                        if (offset + sizeof(cache_file_new) > dataSize)
+                            return false;
+
+                        const auto* header = reinterpret_cast<const cache_file_new*>(data + offset);
+
+                        return memcmp(header->magic, CACHEMAGIC_NEW, sizeof(header->magic)) == 0 &&
+                               memcmp(header->version, CACHE_VERSION, sizeof(header->version)) == 0;
+                    }
+
+                    void useNewHeaderAt(size_t offset) {
+                        const auto* header = reinterpret_cast<const cache_file_new*>(data + offset);
+
+                        if (offset + sizeof(cache_file_new) + header->nlibs * sizeof(file_entry_new) > dataSize)
+                            throw LdSoCacheError("Invalid number of entries in cache");
+
+                        newEntries = reinterpret_cast<const file_entry_new*>(data + offset + sizeof(cache_file_new));
+                        entriesCount = header->nlibs;
+                        stringsOffset = offset;
+
+                        readExtensions(header->extension_offset);
+                    }
+
+                    // see cache_extension_load() in glibc's sysdeps/generic/dl-cache.h
+                    // invalid extensions are ignored, the generic entries can be used nevertheless
+                    void readExtensions(uint32_t extensionOffset) {
+                        if (extensionOffset == 0 || extensionOffset % alignof(cache_extension) != 0 ||
+                            static_cast<size_t>(extensionOffset) + sizeof(cache_extension) > dataSize)
+                            return;
+
+                        const auto* extension = reinterpret_cast<const cache_extension*>(data + extensionOffset);
+
+                        if (extension->magic != CACHE_EXTENSION_MAGIC ||
+                            extensionOffset + sizeof(cache_extension) + static_cast<size_t>(extension->count) * sizeof(cache_extension_section) > dataSize)
+                            return;
+
+                        const auto* sections = reinterpret_cast<const cache_extension_section*>(extension + 1);
+
+                        for (uint32_t i = 0; i < extension->count; ++i) {
+                            const auto& section = sections[i];
+
+                            if (section.tag != CACHE_EXTENSION_TAG_GLIBC_HWCAPS)
+                                continue;
+
+                            if (section.offset % alignof(uint32_t) != 0 || static_cast<size_t>(section.offset) + section.size > dataSize)
+                                return;
+
+                            const auto* nameOffsets = reinterpret_cast<const uint32_t*>(data + section.offset);
+
+                            for (uint32_t j = 0; j < section.size / sizeof(uint32_t); ++j)
+                                hwcapsNames.emplace_back(getString(nameOffsets[j]));
+                        }
+                    }
+
+                    void parseHeader() {
+                        if (isNewHeaderAt(0)) {
+                            useNewHeaderAt(0);
+                            return;
+                        }
+
+                        if (dataSize < sizeof(cache_file) || memcmp(data, CACHEMAGIC, strlen(CACHEMAGIC)) != 0)
+                            throw LdSoCacheError("Unknown cache format");
+
+                        const auto* header = reinterpret_cast<const cache_file*>(data);
+                        const auto oldEntriesEnd = sizeof(cache_file) + header->nlibs * sizeof(file_entry);
+
+                        if (oldEntriesEnd > dataSize)
+                            throw LdSoCacheError("Invalid number of entries in cache");
+
+                        // files written by older versions of ldconfig contain both formats, the new one following
+                        // the old one
+                        const auto alignment = alignof(cache_file_new);
+                        const auto newHeaderOffset = (oldEntriesEnd + alignment - 1) & ~(alignment - 1);
+
+                        if (isNewHeaderAt(newHeaderOffset)) {
+                            useNewHeaderAt(newHeaderOffset);
+                            return;
+                        }
+
+                        oldEntries = reinterpret_cast<const file_entry*>(data + sizeof(cache_file));
+                        entriesCount = header->nlibs;
+                        stringsOffset = oldEntriesEnd;
+                    }
+
+                public:
+                    const char* getString(uint32_t offset) const {
+                        const auto absoluteOffset = stringsOffset + offset;
+
+                        if (absoluteOffset >= dataSize)
+                            return nullptr;
+
+                        const auto* string = reinterpret_cast<const char*>(data + absoluteOffset);
+
+                        // make sure the string is terminated within the mapped file
+                        if (memchr(string, '\0', dataSize - absoluteOffset) == nullptr)
+                            return nullptr;
+
+                        return string;
+                    }
+
+                    const file_entry& getEntry(uint32_t index) const {
+                        // the old and new entries share a common prefix
+                        if (newEntries != nullptr)
+                            return *reinterpret_cast<const file_entry*>(&newEntries[index]);
+
+                        return oldEntries[index];
+                    }
+
+                    bool isGenericEntry(uint32_t index) const {
+                        return newEntries == nullptr || newEntries[index].hwcap == 0;
+                    }
+
+                    // return name of the glibc-hwcaps subdirectory of an entry, or nullptr if it doesn't describe one
+                    const char* getHwcapsName(uint32_t index) const {
+                        if (newEntries == nullptr || !isHwcapExtension(newEntries[index].hwcap))
+                            return nullptr;
+
+                        const auto nameIndex = static_cast<uint32_t>(newEntries[index].hwcap);
+
+                        if (nameIndex >= hwcapsNames.size())
+                            return nullptr;
+
+                        return hwcapsNames[nameIndex];
+                    }
+            };
+
+            LdSoCache::LdSoCache(const bf::path& path) {
+                d = new PrivateData(path);
+            }
+
+            LdSoCache::~LdSoCache() {
+                delete d;
+            }
+
+            std::shared_ptr<LdSoCache> LdSoCache::getInstance() {
+                static const std::shared_ptr<LdSoCache> instance = []() -> std::shared_ptr<LdSoCache> {
+                    try {
+                        return std::make_shared<LdSoCache>("/etc/ld.so.cache");
+                    } catch (const LdSoCacheError& e) {
+                        ldLog() << LD_DEBUG << "Could not read linker cache:" << e.what() << std::endl;
+                        return nullptr;
+                    }
+                }();
+
+                return instance;
+            }
+
+            const char* LdSoCache::lookup(const char* soname, uint8_t elfClass, uint16_t elfMachine) const {
+                if (d->entriesCount == 0)
+                    return nullptr;
+
+                // binary search like the linker's, see glibc's elf/dl-cache.c
+                int64_t left = 0;
+                int64_t right = static_cast<int64_t>(d->entriesCount) - 1;
+                int64_t match = -1;
+
+                while (left <= right) {
+                    const auto middle = (left + right) / 2;
+                    const auto* key = d->getString(d->getEntry(middle).key);
+
+                    if (key == nullptr)
+                        return nullptr;
+
+                    const auto result = compareLibraryNames(soname, key);
+
+                    if (result == 0) {
+                        match = middle;
+                        break;
+                    }
+
+                    if (result < 0)
+                        left = middle + 1;
+                    else
+                        right = middle - 1;
+                }
+
+                if (match < 0)
+                    return nullptr;
+
+                // there may be multiple entries with the same name, e.g., for different architectures
+                // we need to find the first one, then check all the matching ones
+                while (match > 0) {
+                    const auto* key = d->getString(d->getEntry(match - 1).key);
+
+                    if (key == nullptr || compareLibraryNames(soname, key) != 0)
+                        break;
+
+                    --match;
+                }
+
+                // like the linker, we prefer the entries of the glibc-hwcaps subdirectories the CPU supports, the
+                // highest level being the best one, and use the generic entry only if there is none of them
+                // the entries of the legacy hwcaps subdirectories (e.g., "haswell" or "tls"), which the linker doesn't
+                // support anymore since glibc 2.37, are ignored
+                const auto hwcapsSubdirectories = getGlibcHwcapsSubdirectories(elfClass, elfMachine);
+
+                const char* genericPath = nullptr;
+                const char* bestHwcapsPath = nullptr;
+                auto bestHwcapsPriority = hwcapsSubdirectories.size();
+
+                for (auto i = static_cast<uint32_t>(match); i < d->entriesCount; ++i) {
+                    const auto& entry = d->getEntry(i);
+                    const auto* key = d->getString(entry.key);
+
+                    if (key == nullptr || compareLibraryNames(soname, key) != 0)
+                        break;
+
+                    if (!checkFlags(entry.flags, elfClass, elfMachine))
+                        continue;
+
+                    if (d->isGenericEntry(i)) {
+                        if (genericPath == nullptr)
+                            genericPath = d->getString(entry.value);
+                        continue;
+                    }
+
+                    const auto* hwcapsName = d->getHwcapsName(i);
+
+                    if (hwcapsName == nullptr)
+                        continue;
+
+                    const auto priority = static_cast<size_t>(
+                        std::find(hwcapsSubdirectories.begin(), hwcapsSubdirectories.end(), hwcapsName) - hwcapsSubdirectories.begin()
+                    );
+
+                    if (priority < bestHwcapsPriority) {
+                        bestHwcapsPriority = priority;
+                        bestHwcapsPath = d->getString(entry.value);
+                    }
+                }
+
+                return bestHwcapsPath != nullptr ? bestHwcapsPath : genericPath;
+            }
+
+            size_t LdSoCache::size() const {
+                return d->entriesCount;
+            }
+        }
+    }
+}
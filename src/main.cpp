@@ -1,4 +1,5 @@
 // system headers
+#include <fstream>
 #include <glob.h>
 #include <iostream>
 
@@ -7,10 +8,13 @@
 
 // local headers
 #include "linuxdeploy/core/appdir.h"
+#include "linuxdeploy/core/copy_engine.h"
+#include "linuxdeploy/core/dependency_cache.h"
 #include "linuxdeploy/desktopfile/desktopfile.h"
 #include "linuxdeploy/core/elf_file.h"
 #include "linuxdeploy/core/log.h"
 #include "linuxdeploy/plugin/plugin.h"
+#include "linuxdeploy/subprocess/subprocess_statistics.h"
 #include "linuxdeploy/util/util.h"
 #include "core.h"
 
@@ -21,6 +25,45 @@ using namespace linuxdeploy::util;
 
 namespace bf = boost::filesystem;
 
+namespace {
+    // reports the resources used by the external tools once it goes out of scope, i.e., at the end of the run, no
+    // matter whether the run succeeds
+    class SubprocessStatisticsReport {
+        private:
+            const bool printSummary;
+            const std::string jsonPath;
+
+        public:
+            SubprocessStatisticsReport(bool printSummary, std::string jsonPath) : printSummary(printSummary),
+                                                                                  jsonPath(std::move(jsonPath)) {}
+
+            ~SubprocessStatisticsReport() {
+                const auto& statistics = subprocess::subprocess_statistics::instance();
+
+                if (printSummary) {
+                    ldLog() << std::endl << "-- Resources used by external tools --" << std::endl;
+
+                    const auto summary = statistics.summary();
+
+                    if (summary.empty()) {
+                        ldLog() << "No external tools have been run" << std::endl;
+                    } else {
+                        ldLog() << summary;
+                    }
+                }
+
+                if (!jsonPath.empty()) {
+                    std::ofstream ofs(jsonPath);
+                    ofs << statistics.to_json();
+
+                    if (!ofs) {
+                        ldLog() << LD_ERROR << "Failed to write statistics of external tools to" << jsonPath << std::endl;
+                    }
+                }
+            }
+    };
+}
+
 int main(int argc, char** argv) {
     args::ArgumentParser parser(
         "linuxdeploy -- create AppDir bundles with ease"
@@ -46,6 +89,16 @@ int main(int argc, char** argv) {
 
     args::ValueFlag<std::string> customAppRunPath(parser, "AppRun path", "Path to custom AppRun script (linuxdeploy will not create a symlink but copy this file instead)", {"custom-apprun"});
 
+    args::ValueFlag<unsigned int> jobs(parser, "N", "Number of parallel jobs used to trace dependencies (default: number of CPU cores)", {'j', "jobs"});
+
+    args::ValueFlag<unsigned int> copyQueueDepth(parser, "N", "Maximum number of files copied in parallel (default: number of jobs)", {"copy-queue-depth"});
+    args::ValueFlagList<std::string> excludelistFiles(parser, "path", "File containing additional libraries not to deploy, one filename or glob pattern per line", {"excludelist-file"});
+    args::Flag useHardlinks(parser, "", "Hardlink files into the AppDir instead of copying them where possible, also enabled by $USE_HARDLINKS (only use for throwaway AppDirs, plugins might modify the original files)", {"use-hardlinks"});
+    args::Flag useDependencyCache(parser, "", "Reuse the dependencies traced in previous runs, stored in $XDG_CACHE_HOME/linuxdeploy or ~/.cache/linuxdeploy (only use if the libraries on the system don't change between runs, see README)", {"dependency-cache"});
+    args::ValueFlag<std::string> deduplicate(parser, "policy", "Replace files with identical contents in the AppDir with links before running the output plugins (policy: hardlink or symlink)", {"deduplicate"});
+    args::Flag subprocessStats(parser, "", "Print the time and memory used by the external tools (ldd, patchelf, strip, plugins, ...) per executable at the end", {"subprocess-stats"});
+    args::ValueFlag<std::string> subprocessStatsJson(parser, "path", "Write the time and memory used by the external tools per executable to the given file as JSON at the end", {"subprocess-stats-json"});
+
     args::Flag listPlugins(parser, "", "Search for plugins, print them to stdout and exit", {"list-plugins"});
     args::ValueFlagList<std::string> inputPlugins(parser, "name", "Input plugins to run (check whether they are available with --list-plugins)", {'p', "plugin"});
     args::ValueFlagList<std::string> outputPlugins(parser, "name", "Output plugins to run (check whether they are available with --list-plugins)", {'o', "output"});
@@ -90,6 +143,23 @@ int main(int argc, char** argv) {
         ldLog::setVerbosity((LD_LOGLEVEL) verbosity.Get());
     }
 
+    // the deduplication runs at the very end, so the policy must be checked before anything is deployed
+    auto deduplicationPolicy = appdir::DEDUPLICATE_WITH_HARDLINKS;
+
+    if (deduplicate) {
+        if (deduplicate.Get() == "hardlink") {
+            deduplicationPolicy = appdir::DEDUPLICATE_WITH_HARDLINKS;
+        } else if (deduplicate.Get() == "symlink") {
+            deduplicationPolicy = appdir::DEDUPLICATE_WITH_SYMLINKS;
+        } else {
+            ldLog() << LD_ERROR << "Unknown deduplication policy:" << deduplicate.Get() << "(valid policies: hardlink, symlink)" << std::endl;
+            return 1;
+        }
+    }
+
+    // the plugins are run as subprocesses, too, so the report is set up before looking for them
+    const SubprocessStatisticsReport subprocessStatisticsReport(static_cast<bool>(subprocessStats), subprocessStatsJson.Get());
+
     auto foundPlugins = linuxdeploy::plugin::findPlugins();
 
     if (listPlugins) {
@@ -117,6 +187,39 @@ int main(int argc, char** argv) {
         appDir.setDisableCopyrightFilesDeployment(true);
     }
 
+    if (jobs)
+        appDir.setJobs(jobs.Get());
+
+    if (copyQueueDepth)
+        appDir.setCopyQueueDepth(copyQueueDepth.Get());
+
+    for (const auto& excludelistFile : excludelistFiles.Get()) {
+        if (!appDir.addExcludelistFile(excludelistFile))
+            return 1;
+    }
+
+    if (useHardlinks)
+        copy_engine::setCopyMode(copy_engine::COPY_MODE_HARDLINK);
+
+    // share the results of tracing dependencies between runs if requested
+    std::shared_ptr<dependency_cache::DependencyCache> dependencyCache;
+
+    if (useDependencyCache) {
+        const auto dependencyCachePath = dependency_cache::DependencyCache::getDefaultPath();
+
+        if (dependencyCachePath.empty()) {
+            ldLog() << LD_WARNING << "Could not determine path of dependency cache, neither $XDG_CACHE_HOME nor $HOME are set" << std::endl;
+        } else {
+            ldLog() << LD_DEBUG << "Using dependency cache:" << dependencyCachePath << std::endl;
+
+            // the resolvers don't necessarily find the same libraries, so their results must not be mixed
+            const std::string resolver = elf_file::ElfFile::getDependencyResolver() == elf_file::LDD_RESOLVER ? "ldd" : "native";
+
+            dependencyCache = std::make_shared<dependency_cache::DependencyCache>(dependencyCachePath, resolver);
+            elf_file::ElfFile::setDependencyCache(dependencyCache);
+        }
+    }
+
     // initialize AppDir with common directories
     ldLog() << std::endl << "-- Creating basic AppDir structure --" << std::endl;
     if (!appDir.createBasicStructure()) {
@@ -172,15 +275,19 @@ int main(int argc, char** argv) {
             if (bf::is_directory(path)) {
                 ldLog() << "Deploying files in directory" << path << std::endl;
 
+                std::vector<bf::path> elfFilePaths;
+
                 for (auto it = bf::directory_iterator{path}; it != bf::directory_iterator{}; ++it) {
                     if (!bf::is_regular_file(*it)) {
                         continue;
                     }
 
-                    if (!appDir.deployDependenciesOnlyForElfFile(*it, true)) {
-                        ldLog() << LD_WARNING << "Failed to deploy dependencies for ELF file" << *it << LD_NO_SPACE << ", skipping" << std::endl;
-                        continue;
-                    }
+                    elfFilePaths.emplace_back(*it);
+                }
+
+                // files which fail are skipped, the others are deployed nevertheless
+                if (!appDir.deployDependenciesOnlyForElfFiles(elfFilePaths, true)) {
+                    ldLog() << LD_WARNING << "Failed to deploy dependencies for some ELF files in directory" << path << LD_NO_SPACE << ", skipping them" << std::endl;
                 }
             } else if (bf::is_regular_file(path)) {
                 if (!appDir.deployDependenciesOnlyForElfFile(path)) {
@@ -197,7 +304,18 @@ int main(int argc, char** argv) {
     // perform deferred copy operations before running input plugins to make sure all files the plugins might expect
     // are in place
     ldLog() << std::endl << "-- Copying files into AppDir --" << std::endl;
-    if (!appDir.executeDeferredOperations()) {
+    const auto deferredOperationsSucceeded = appDir.executeDeferredOperations();
+
+    // the dependencies have been traced successfully even if deploying the files failed
+    if (dependencyCache != nullptr) {
+        ldLog() << LD_DEBUG << "Dependency cache hits:" << dependencyCache->getHits()
+                << "misses:" << dependencyCache->getMisses() << std::endl;
+
+        if (!dependencyCache->save())
+            ldLog() << LD_WARNING << "Failed to save dependency cache" << std::endl;
+    }
+
+    if (!deferredOperationsSucceeded) {
         return 1;
     }
 
@@ -329,6 +447,14 @@ int main(int argc, char** argv) {
     if (!linuxdeploy::deployAppDirRootFiles(desktopFilePaths.Get(), customAppRunPath.Get(), appDir))
         return 1;
 
+    if (deduplicate) {
+        ldLog() << std::endl << "-- Deduplicating files in AppDir --" << std::endl;
+
+        // the AppDir works nevertheless, the files which could not be replaced are just not deduplicated
+        if (!appDir.deduplicateFiles(deduplicationPolicy))
+            ldLog() << LD_WARNING << "Failed to deduplicate some files" << std::endl;
+    }
+
     if (outputPlugins) {
         for (const auto& pluginName : outputPlugins.Get()) {
             auto it = foundPlugins.find(std::string(pluginName));
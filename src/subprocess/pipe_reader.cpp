@@ -16,7 +16,7 @@ pipe_reader::pipe_reader(int pipe_fd) : pipe_fd_(pipe_fd) {
     fcntl(pipe_fd_, F_SETFL, flags);
 }
 
-size_t pipe_reader::read(std::vector<std::string::value_type>& buffer) const {
+size_t pipe_reader::read(std::vector<std::string::value_type>& buffer) {
     ssize_t rv = ::read(pipe_fd_, buffer.data(), buffer.size());
 
     if (rv == -1) {
@@ -28,5 +28,13 @@ size_t pipe_reader::read(std::vector<std::string::value_type>& buffer) const {
         throw std::runtime_error{"unexpected error reading from pipe: " + std::string(strerror(errno))};
     }
 
+    // read() only returns 0 on non-empty buffers once the write end has been closed
+    if (rv == 0 && !buffer.empty())
+        eof_ = true;
+
     return rv;
 }
+
+bool pipe_reader::eof() const {
+    return eof_;
+}
@@ -1,22 +1,206 @@
 // system headers
 #include <algorithm>
+#include <cerrno>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
 #include <utility>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
 #include <unistd.h>
 #include <memory.h>
 #include <wait.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 
 // local headers
 #include "linuxdeploy/subprocess/process.h"
 #include "linuxdeploy/subprocess/subprocess.h"
+#include "linuxdeploy/subprocess/subprocess_statistics.h"
 #include "linuxdeploy/util/assert.h"
 
 // shorter than using namespace ...
 using namespace linuxdeploy::subprocess;
 
+namespace {
+    int pidfd_open(pid_t pid) {
+#ifdef SYS_pidfd_open
+        // the returned file descriptor has the close-on-exec flag set
+        return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+        errno = ENOSYS;
+        return -1;
+#endif
+    }
+
+    // pidfds are available on Linux 5.3 and newer
+    bool pidfd_supported() {
+        static const bool supported = []() {
+            const auto fd = pidfd_open(getpid());
+
+            if (fd < 0)
+                return false;
+
+            ::close(fd);
+            return true;
+        }();
+
+        return supported;
+    }
+
+    // fallback for older kernels: the SIGCHLD handler writes a byte into a non-blocking self-pipe whenever any child
+    // exits, which can be watched along with the stdout/stderr pipes
+    int sigchld_pipe_fds[2] = {-1, -1};
+    struct sigaction previous_sigchld_action;
+
+    void sigchld_handler(int signal, siginfo_t* info, void* context) {
+        const auto saved_errno = errno;
+
+        // if the pipe is full, there are pending notifications anyway
+        const char byte = 0;
+        (void) !write(sigchld_pipe_fds[1], &byte, 1);
+
+        // don't break handlers installed before ours
+        if ((previous_sigchld_action.sa_flags & SA_SIGINFO) != 0) {
+            if (previous_sigchld_action.sa_sigaction != nullptr)
+                previous_sigchld_action.sa_sigaction(signal, info, context);
+        } else if (previous_sigchld_action.sa_handler != SIG_DFL && previous_sigchld_action.sa_handler != SIG_IGN) {
+            previous_sigchld_action.sa_handler(signal);
+        }
+
+        errno = saved_errno;
+    }
+
+    // installs the handler on first use, which must happen before the first child is forked to not miss its exit
+    int sigchld_pipe_read_fd() {
+        static std::once_flag once;
+
+        std::call_once(once, []() {
+            if (pipe2(sigchld_pipe_fds, O_CLOEXEC | O_NONBLOCK) != 0) {
+                const auto error = errno;
+                throw std::logic_error("failed to create SIGCHLD pipe: " + std::string(strerror(error)));
+            }
+
+            struct sigaction action{};
+            action.sa_sigaction = sigchld_handler;
+            action.sa_flags = SA_SIGINFO | SA_RESTART | SA_NOCLDSTOP;
+            sigemptyset(&action.sa_mask);
+
+            if (sigaction(SIGCHLD, &action, &previous_sigchld_action) != 0) {
+                const auto error = errno;
+                throw std::logic_error("failed to install SIGCHLD handler: " + std::string(strerror(error)));
+            }
+        });
+
+        return sigchld_pipe_fds[0];
+    }
+
+    void drain_sigchld_pipe() {
+        char buffer[64];
+        while (read(sigchld_pipe_fds[0], buffer, sizeof(buffer)) > 0);
+    }
+
+    /**
+     * Environment passed to child processes: a copy of our environment with the additional variables applied.
+     * Building it is comparably expensive, and the same few sets of additional variables are used over and over, so
+     * the blocks are cached. A block stays valid as long as our environment has not been changed, e.g., by setenv().
+     */
+    class environment_block {
+    private:
+        // pointers to the entries of environ at the time the block was built, used to detect changes
+        std::vector<const char*> environ_snapshot_;
+        subprocess_env_map_t additional_variables_;
+
+        std::vector<std::string> variables_;
+        // nullptr-terminated array pointing into variables_, as exec*e want it
+        std::vector<char*> pointers_;
+
+        // the most recently used blocks come first
+        static std::mutex cache_mutex_;
+        static std::vector<std::shared_ptr<const environment_block>> cache_;
+        static constexpr size_t cache_size_ = 8;
+
+        static std::vector<const char*> snapshot_environ() {
+            std::vector<const char*> rv;
+
+            if (environ != nullptr) {
+                for (auto** current_env_var = environ; *current_env_var != nullptr; ++current_env_var)
+                    rv.emplace_back(*current_env_var);
+            }
+
+            return rv;
+        }
+
+        static std::string variable_name(const std::string& variable) {
+            return variable.substr(0, variable.find('='));
+        }
+
+    public:
+        environment_block(std::vector<const char*> environ_snapshot, const subprocess_env_map_t& additional_variables)
+            : environ_snapshot_(std::move(environ_snapshot)), additional_variables_(additional_variables) {
+            variables_.reserve(environ_snapshot_.size() + additional_variables_.size());
+
+            // the additional variables replace existing ones with the same name
+            for (const auto* variable : environ_snapshot_) {
+                if (additional_variables_.find(variable_name(variable)) == additional_variables_.end())
+                    variables_.emplace_back(variable);
+            }
+
+            for (const auto& variable : additional_variables_)
+                variables_.emplace_back(variable.first + "=" + variable.second);
+
+            // the strings must not be moved anymore from here on
+            pointers_.reserve(variables_.size() + 1);
+
+            for (auto& variable : variables_)
+                pointers_.emplace_back(&variable[0]);
+
+            pointers_.emplace_back(nullptr);
+        }
+
+        char* const* data() const {
+            return pointers_.data();
+        }
+
+        static std::shared_ptr<const environment_block> get(const subprocess_env_map_t& additional_variables) {
+            auto environ_snapshot = snapshot_environ();
+
+            std::lock_guard<std::mutex> lock(cache_mutex_);
+
+            for (auto it = cache_.begin(); it != cache_.end(); ++it) {
+                if ((*it)->additional_variables_ != additional_variables)
+                    continue;
+
+                if ((*it)->environ_snapshot_ != environ_snapshot) {
+                    // outdated, will be replaced below
+                    cache_.erase(it);
+                    break;
+                }
+
+                std::rotate(cache_.begin(), it, it + 1);
+                return cache_.front();
+            }
+
+            std::shared_ptr<const environment_block> block =
+                std::make_shared<environment_block>(std::move(environ_snapshot), additional_variables);
+
+            cache_.insert(cache_.begin(), block);
+
+            if (cache_.size() > cache_size_)
+                cache_.pop_back();
+
+            return block;
+        }
+    };
+
+    std::mutex environment_block::cache_mutex_;
+    std::vector<std::shared_ptr<const environment_block>> environment_block::cache_;
+    constexpr size_t environment_block::cache_size_;
+}
+
 int process::pid() const {
     return child_pid_;
 }
@@ -29,6 +213,48 @@ int process::stderr_fd() const {
     return stderr_fd_;
 }
 
+int process::exit_fd() const {
+    return exit_fd_;
+}
+
+bool process::exit_fd_is_shared() const {
+    return exit_fd_is_shared_;
+}
+
+const subprocess_resource_usage& process::resource_usage() const {
+    return resource_usage_;
+}
+
+void process::record_resource_usage_(const struct rusage& usage) {
+    auto to_seconds = [](const timeval& time) {
+        return static_cast<double>(time.tv_sec) + static_cast<double>(time.tv_usec) / 1e6;
+    };
+
+    const std::chrono::duration<double> wall_time = std::chrono::steady_clock::now() - start_time_;
+
+    resource_usage_.wall_time_seconds = wall_time.count();
+    resource_usage_.user_time_seconds = to_seconds(usage.ru_utime);
+    resource_usage_.system_time_seconds = to_seconds(usage.ru_stime);
+    // Linux reports kilobytes
+    resource_usage_.max_rss_kib = usage.ru_maxrss;
+
+    subprocess_statistics::instance().record(resource_usage_);
+}
+
+void process::open_exit_fd_() {
+    if (pidfd_supported()) {
+        exit_fd_ = pidfd_open(child_pid_);
+
+        if (exit_fd_ >= 0)
+            return;
+    }
+
+    // the handler has been installed before forking already unless pidfd_open() failed unexpectedly, in which case
+    // callers just have to wait for their timeouts
+    exit_fd_ = sigchld_pipe_read_fd();
+    exit_fd_is_shared_ = true;
+}
+
 process::process(std::initializer_list<std::string> args, const subprocess_env_map_t& env)
     : process(std::vector<std::string>(args), env) {}
 
@@ -43,7 +269,10 @@ process::process(const std::vector<std::string>& args, const subprocess_env_map_
 
     // FIXME: for debugging of #150
     auto create_pipe = [](int fds[]) {
-        const auto rv = pipe(fds);
+        // the pipes must not be inherited by processes spawned concurrently by other threads, otherwise the write
+        // ends stay open, and reading the output never finishes
+        // dup2() clears the flag on the file descriptors connected to the child's stdout and stderr
+        const auto rv = pipe2(fds, O_CLOEXEC);
 
         if (rv != 0) {
             const auto error = errno;
@@ -55,61 +284,45 @@ process::process(const std::vector<std::string>& args, const subprocess_env_map_
     create_pipe(stdout_pipe_fds);
     create_pipe(stderr_pipe_fds);
 
-    // create child process
-    child_pid_ = fork();
-
-    if (child_pid_ < 0) {
-        throw std::runtime_error{"fork() failed"};
-    }
-
-    if (child_pid_ == 0) {
-        // we're in the child process
-
-        // first step: close the read end of both pipes
-        close_pipe_fd_(stdout_pipe_fds[READ_END_]);
-        close_pipe_fd_(stderr_pipe_fds[READ_END_]);
+    // prepare arguments for exec*
+    // posix_spawn() does not run any code of ours in the child, so the arguments can point to the strings directly
+    auto exec_args = make_args_vector_(args);
+    const auto exec_env = environment_block::get(env);
 
-        auto connect_fd = [](int fd, int fileno) {
-            for (;;) {
-                if (dup2(fd, fileno) == -1) {
-                    const auto error = errno;
-                    if (error != EINTR) {
-                        throw std::logic_error{"failed to connect pipes: " + std::string(strerror(error))};
-                    }
-                    continue;
-                }
-
-                break;
-            }
-        };
+    // without pidfds, the exit of the child is signaled through SIGCHLD, so the handler must be in place beforehand
+    if (!pidfd_supported())
+        (void) sigchld_pipe_read_fd();
 
-        connect_fd(stdout_pipe_fds[WRITE_END_], STDOUT_FILENO);
-        connect_fd(stderr_pipe_fds[WRITE_END_], STDERR_FILENO);
+    // connect the write ends of the pipes to the child's stdout and stderr
+    // all other pipe fds are closed on exec
+    posix_spawn_file_actions_t file_actions;
+    posix_spawn_file_actions_init(&file_actions);
+    posix_spawn_file_actions_adddup2(&file_actions, stdout_pipe_fds[WRITE_END_], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&file_actions, stderr_pipe_fds[WRITE_END_], STDERR_FILENO);
 
-        // now, we also have to close the write end of both pipes
-        close_pipe_fd_(stdout_pipe_fds[WRITE_END_]);
-        close_pipe_fd_(stderr_pipe_fds[WRITE_END_]);
-
-        // prepare arguments for exec*
-        auto exec_args = make_args_vector_(args);
-        auto exec_env = make_env_vector_(env);
+    // create child process
+    // glibc implements posix_spawn() with clone(CLONE_VM | CLONE_VFORK), which, unlike fork(), does not have to copy
+    // the page tables of our process, and reports exec() failures back to us
+    const auto spawn_error = posix_spawnp(
+        &child_pid_, args.front().c_str(), &file_actions, nullptr, exec_args.data(), exec_env->data()
+    );
 
-        // call subprocess
-        execvpe(args.front().c_str(), exec_args.data(), exec_env.data());
+    posix_spawn_file_actions_destroy(&file_actions);
 
-        // only reached if exec* fails
+    start_time_ = std::chrono::steady_clock::now();
 
-        // clean up memory if exec should ever return
-        // prevents memleaks if the exception below would be handled by a caller
-        auto deleter = [](char* ptr) {
-            free(ptr);
-            ptr = nullptr;
-        };
+    {
+        const auto& executable = args.front();
+        resource_usage_.executable = executable.substr(executable.find_last_of('/') + 1);
+    }
 
-        std::for_each(exec_args.begin(), exec_args.end(), deleter);
-        std::for_each(exec_env.begin(), exec_env.end(), deleter);
+    if (spawn_error != 0) {
+        // like a shell, report the error on the child's stderr, close() returns exit code 127 then
+        // this way, callers see the same as if the child had failed to exec itself
+        child_pid_ = -1;
 
-        throw std::runtime_error{"exec() failed: " + std::string(strerror(errno))};
+        const auto message = args.front() + ": " + strerror(spawn_error) + "\n";
+        (void) !write(stderr_pipe_fds[WRITE_END_], message.data(), message.size());
     }
 
     // parent code
@@ -121,6 +334,9 @@ process::process(const std::vector<std::string>& args, const subprocess_env_map_
     // store file descriptors
     stdout_fd_ = stdout_pipe_fds[READ_END_];
     stderr_fd_ = stderr_pipe_fds[READ_END_];
+
+    if (child_pid_ > 0)
+        open_exit_fd_();
 }
 
 int process::close() {
@@ -131,15 +347,21 @@ int process::close() {
         close_pipe_fd_(stderr_fd_);
         stderr_fd_ = -1;
 
-        {
+        exited_ = true;
+
+        // the child could not be spawned
+        if (child_pid_ < 0) {
+            exit_code_ = SPAWN_FAILED_EXIT_CODE_;
+        } else {
             int status;
+            struct rusage usage{};
 
-            if (waitpid(child_pid_, &status, 0) == -1) {
-                throw std::logic_error{"waitpid() failed"};
+            if (wait4(child_pid_, &status, 0, &usage) == -1) {
+                throw std::logic_error{"wait4() failed"};
             }
 
-            exited_ = true;
             exit_code_ = check_waitpid_status_(status);
+            record_resource_usage_(usage);
         }
     }
 
@@ -148,14 +370,18 @@ int process::close() {
 
 process::~process() {
     (void) close();
+
+    if (exit_fd_ >= 0 && !exit_fd_is_shared_)
+        ::close(exit_fd_);
 }
 
 std::vector<char*> process::make_args_vector_(const std::vector<std::string>& args) {
     std::vector<char*> rv{};
-    rv.reserve(args.size());
+    rv.reserve(args.size() + 1);
 
+    // posix_spawn() does not modify the strings, its interface just predates const
     for (const auto& arg : args) {
-        rv.emplace_back(strdup(arg.c_str()));
+        rv.emplace_back(const_cast<char*>(arg.c_str()));
     }
 
     // execv* want a nullptr-terminated array
@@ -164,51 +390,12 @@ std::vector<char*> process::make_args_vector_(const std::vector<std::string>& ar
     return rv;
 }
 
-std::vector<char*> process::make_env_vector_(const subprocess_env_map_t& env) {
-    std::vector<char*> rv;
-
-    // first, copy existing environment
-    // we cannot reserve space in the vector unfortunately, as we don't know the size of environ before the iteration
-    if (environ != nullptr) {
-        for (auto** current_env_var = environ; *current_env_var != nullptr; ++current_env_var) {
-            rv.emplace_back(strdup(*current_env_var));
-        }
-    }
-
-    // add own environment variables, overwriting existing ones if necessary
-    for (const auto& env_var : env) {
-        const auto& key = env_var.first;
-        const auto& value = env_var.second;
-
-        auto predicate = [&key](char* existing_env_var) {
-            char* equal_sign = strstr(existing_env_var, "=");
-
-            if (equal_sign == nullptr) {
-                throw std::runtime_error{"no equal sign in environment variable"};
-            }
-
-            return strncmp(existing_env_var, key.c_str(), std::distance(equal_sign, existing_env_var)) == 0;
-        };
-
-        // delete existing env var, if any
-        rv.erase(std::remove_if(rv.begin(), rv.end(), predicate), rv.end());
-
-        // insert new value
-        std::ostringstream oss;
-        oss << key;
-        oss << "=";
-        oss << value;
-
-        rv.emplace_back(strdup(oss.str().c_str()));
+void process::kill(int signal) const {
+    // kill(-1, ...) would signal every process we are allowed to
+    if (child_pid_ < 0) {
+        throw std::logic_error{"child process has not been spawned"};
     }
 
-    // exec*e want a nullptr-terminated array
-    rv.emplace_back(nullptr);
-
-    return rv;
-}
-
-void process::kill(int signal) const {
     if (::kill(child_pid_, signal) != 0) {
         throw std::logic_error{"failed to kill child process"};
     }
@@ -223,8 +410,18 @@ bool process::is_running() {
         return false;
     }
 
+    if (child_pid_ < 0) {
+        (void) close();
+        return false;
+    }
+
+    // the notifications are cleared before checking, so that an exit right after the check wakes up the next poll()
+    if (exit_fd_is_shared_)
+        drain_sigchld_pipe();
+
     int status;
-    auto result = waitpid(child_pid_, &status, WNOHANG);
+    struct rusage usage{};
+    auto result = wait4(child_pid_, &status, WNOHANG, &usage);
 
     if (result == 0) {
         return true;
@@ -240,16 +437,17 @@ bool process::is_running() {
 
         exited_ = true;
         exit_code_ = check_waitpid_status_(status);
+        record_resource_usage_(usage);
 
         return false;
     }
 
     if (result < 0) {
         // TODO: check errno == ECHILD
-        throw std::logic_error{"waitpid() failed: " + std::string(strerror(errno))};
+        throw std::logic_error{"wait4() failed: " + std::string(strerror(errno))};
     }
 
-    // can only happen if waitpid() returns an unknown process ID
+    // can only happen if wait4() returns an unknown process ID
     throw std::logic_error{"unknown error occured"};
 }
 
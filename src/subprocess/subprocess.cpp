@@ -1,11 +1,14 @@
 // system headers
 #include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
 #include <utility>
+#include <poll.h>
 #include <unistd.h>
-#include <thread>
 
 // local headers
 #include "linuxdeploy/subprocess/subprocess.h"
@@ -24,58 +27,177 @@ namespace linuxdeploy {
             util::assert::assert_not_empty(args_);
         }
 
+        line_splitter::line_splitter(subprocess_output_callback_t line_callback)
+            : line_callback_(std::move(line_callback)) {}
+
+        void line_splitter::feed(boost::string_view data) {
+            for (;;) {
+                const auto line_break = data.find('\n');
+
+                if (line_break == boost::string_view::npos) {
+                    partial_line_.append(data.data(), data.size());
+                    return;
+                }
+
+                if (partial_line_.empty()) {
+                    line_callback_(data.substr(0, line_break));
+                } else {
+                    partial_line_.append(data.data(), line_break);
+                    line_callback_(partial_line_);
+                    partial_line_.clear();
+                }
+
+                data.remove_prefix(line_break + 1);
+            }
+        }
+
+        void line_splitter::finish() {
+            if (!partial_line_.empty()) {
+                line_callback_(partial_line_);
+                partial_line_.clear();
+            }
+        }
+
         subprocess_result subprocess::run() const {
+            subprocess_result_buffer_t stdout_contents;
+            subprocess_result_buffer_t stderr_contents;
+
+            auto append_to = [](subprocess_result_buffer_t& buffer) {
+                return [&buffer](boost::string_view data) {
+                    buffer.insert(buffer.end(), data.begin(), data.end());
+                };
+            };
+
+            subprocess_resource_usage resource_usage;
+
+            const auto exit_code = run_(append_to(stdout_contents), append_to(stderr_contents), resource_usage);
+
+            // make sure contents are null-terminated
+            stdout_contents.emplace_back('\0');
+            stderr_contents.emplace_back('\0');
+
+            return subprocess_result{exit_code, std::move(stdout_contents), std::move(stderr_contents), resource_usage};
+        }
+
+        int subprocess::run(const subprocess_output_callback_t& stdout_callback,
+                            const subprocess_output_callback_t& stderr_callback) const {
+            subprocess_resource_usage resource_usage;
+            return run_(stdout_callback, stderr_callback, resource_usage);
+        }
+
+        int subprocess::run_(const subprocess_output_callback_t& stdout_callback,
+                             const subprocess_output_callback_t& stderr_callback,
+                             subprocess_resource_usage& resource_usage) const {
             process proc{args_, env_};
 
-            // create pipe readers and empty buffers for both stdout and stderr
+            // create pipe readers and callbacks for both stdout and stderr
             // we manage them in this (admittedly, kind of complex-looking) array so we can later easily perform the
             // operations in a loop
-            std::array<std::pair<pipe_reader, subprocess_result_buffer_t>, 2> buffers{
-                std::make_pair(pipe_reader(proc.stdout_fd()), subprocess_result_buffer_t{}),
-                std::make_pair(pipe_reader(proc.stderr_fd()), subprocess_result_buffer_t{}),
+            std::array<std::pair<pipe_reader, const subprocess_output_callback_t*>, 2> pipes{
+                std::make_pair(pipe_reader(proc.stdout_fd()), &stdout_callback),
+                std::make_pair(pipe_reader(proc.stderr_fd()), &stderr_callback),
             };
 
-            for (;;) {
-                for (auto& pair : buffers) {
-                    // make code more readable
-                    auto& reader = pair.first;
-                    auto& buffer = pair.second;
-
-                    // read some bytes into smaller intermediate buffer to prevent either of the pipes to overflow
-                    // the results are immediately appended to the main buffer
-                    subprocess_result_buffer_t intermediate_buffer(4096);
+            // instead of checking the pipes and the process state periodically, we wait for events on the pipes and
+            // the process's exit fd, so the completion of short-lived processes is noticed right away
+            // the pipes' entries are set to -1 (ignored by poll()) once they have been closed by the child
+            std::array<pollfd, 3> poll_fds{{
+                {proc.stdout_fd(), POLLIN, 0},
+                {proc.stderr_fd(), POLLIN, 0},
+                {proc.exit_fd(), POLLIN, 0},
+            }};
+
+            // the SIGCHLD fallback pipe is shared between all children, and another thread may consume the notification
+            // for ours, so we need to check the process state every now and then
+            const int timeout_ms = proc.exit_fd_is_shared() ? 50 : -1;
+
+            // all the data is read into the same buffer, and handed to the callbacks from there
+            // it is large enough to read a full pipe buffer at once
+            subprocess_result_buffer_t read_buffer(65536);
+
+            // (try to) read all available data from pipe
+            auto read_available_data = [&pipes, &poll_fds, &read_buffer](size_t index) {
+                auto& reader = pipes[index].first;
+                const auto& callback = *pipes[index].second;
+
+                if (poll_fds[index].fd < 0) {
+                    return;
+                }
 
-                    // (try to) read all available data from pipe
-                    for (;;) {
-                        const auto bytes_read = reader.read(intermediate_buffer);
+                for (;;) {
+                    const auto bytes_read = reader.read(read_buffer);
 
-                        if (bytes_read == 0) {
-                            break;
+                    if (bytes_read == 0) {
+                        if (reader.eof()) {
+                            poll_fds[index].fd = -1;
                         }
 
-                        // append to main buffer
-                        buffer.reserve(buffer.size() + bytes_read);
-                        std::copy(intermediate_buffer.begin(), (intermediate_buffer.begin() + bytes_read),
-                                  std::back_inserter(buffer));
+                        break;
+                    }
+
+                    if (callback) {
+                        callback(boost::string_view(read_buffer.data(), bytes_read));
                     }
                 }
+            };
 
-                // do-while might be a little more elegant, but we can save this one unnecessary sleep, so...
-                if (proc.is_running()) {
-                    // reduce load on CPU
-                    std::this_thread::sleep_for(std::chrono::milliseconds(50));
-                } else {
-                    break;
+            for (;;) {
+                const auto rv = poll(poll_fds.data(), poll_fds.size(), timeout_ms);
+
+                if (rv < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+
+                    throw std::runtime_error{"poll() failed: " + std::string(strerror(errno))};
+                }
+
+                for (size_t i = 0; i < pipes.size(); ++i) {
+                    if (poll_fds[i].revents != 0) {
+                        read_available_data(i);
+                    }
+                }
+
+                // the exit fd is missing if the process could not be spawned at all
+                if (rv == 0 || poll_fds[2].revents != 0 || poll_fds[2].fd < 0) {
+                    // everything the child wrote before exiting is in the pipes by now
+                    // is_running() closes the pipes, so they have to be emptied before
+                    read_available_data(0);
+                    read_available_data(1);
+
+                    if (!proc.is_running()) {
+                        break;
+                    }
                 }
             }
 
-            // make sure contents are null-terminated
-            buffers[0].second.emplace_back('\0');
-            buffers[1].second.emplace_back('\0');
+            const auto exit_code = proc.close();
+            resource_usage = proc.resource_usage();
+
+            return exit_code;
+        }
+
+        int subprocess::run_lines(const subprocess_output_callback_t& stdout_line_callback,
+                                  const subprocess_output_callback_t& stderr_line_callback) const {
+            std::array<line_splitter, 2> splitters{{
+                line_splitter(stdout_line_callback),
+                line_splitter(stderr_line_callback),
+            }};
+
+            // there's no need to split the output nobody is interested in
+            auto feed_to = [](line_splitter& splitter, const subprocess_output_callback_t& line_callback) {
+                return line_callback ? [&splitter](boost::string_view data) { splitter.feed(data); }
+                                     : subprocess_output_callback_t{};
+            };
+
+            const auto exit_code = run(
+                feed_to(splitters[0], stdout_line_callback), feed_to(splitters[1], stderr_line_callback)
+            );
 
-            auto exit_code = proc.close();
+            splitters[0].finish();
+            splitters[1].finish();
 
-            return subprocess_result{exit_code, buffers[0].second, buffers[1].second};
+            return exit_code;
         }
 
         std::string subprocess::check_output() const {
@@ -1,10 +1,154 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <sstream>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <wait.h>
 
+#include "linuxdeploy/subprocess/process.h"
 #include "linuxdeploy/subprocess/subprocess.h"
 
 using namespace linuxdeploy::subprocess;
 
+// the way process used to spawn children: copy the environment, fork() and exec in the child
+int legacy_spawn(const std::vector<std::string>& args, const subprocess_env_map_t& env) {
+    int stdout_pipe_fds[2];
+    int stderr_pipe_fds[2];
+
+    if (pipe2(stdout_pipe_fds, O_CLOEXEC) != 0 || pipe2(stderr_pipe_fds, O_CLOEXEC) != 0)
+        throw std::runtime_error{"pipe2() failed"};
+
+    std::vector<char*> exec_args;
+    for (const auto& arg : args)
+        exec_args.emplace_back(strdup(arg.c_str()));
+    exec_args.emplace_back(nullptr);
+
+    std::vector<char*> exec_env;
+    for (auto** current_env_var = environ; *current_env_var != nullptr; ++current_env_var)
+        exec_env.emplace_back(strdup(*current_env_var));
+
+    for (const auto& env_var : env) {
+        const auto& key = env_var.first;
+
+        exec_env.erase(std::remove_if(exec_env.begin(), exec_env.end(), [&key](char* existing_env_var) {
+            char* equal_sign = strstr(existing_env_var, "=");
+            return strncmp(existing_env_var, key.c_str(), std::distance(equal_sign, existing_env_var)) == 0;
+        }), exec_env.end());
+
+        std::ostringstream oss;
+        oss << key << "=" << env_var.second;
+        exec_env.emplace_back(strdup(oss.str().c_str()));
+    }
+    exec_env.emplace_back(nullptr);
+
+    const auto pid = fork();
+
+    if (pid == 0) {
+        dup2(stdout_pipe_fds[1], STDOUT_FILENO);
+        dup2(stderr_pipe_fds[1], STDERR_FILENO);
+        execvpe(args.front().c_str(), exec_args.data(), exec_env.data());
+        _exit(127);
+    }
+
+    for (auto* ptr : exec_args)
+        free(ptr);
+    for (auto* ptr : exec_env)
+        free(ptr);
+
+    for (const auto fd : {stdout_pipe_fds[0], stdout_pipe_fds[1], stderr_pipe_fds[0], stderr_pipe_fds[1]})
+        close(fd);
+
+    int status;
+    waitpid(pid, &status, 0);
+    return WEXITSTATUS(status);
+}
+
+// returns the average time per call in microseconds
+double measure_spawn(int iterations, const std::function<int()>& spawn) {
+    const auto begin = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < iterations; ++i) {
+        if (spawn() != 0)
+            throw std::runtime_error{"command failed"};
+    }
+
+    const std::chrono::duration<double, std::micro> duration = std::chrono::steady_clock::now() - begin;
+    return duration.count() / iterations;
+}
+
+// compares spawning processes the way process does to the old fork() based implementation
+// optionally, some memory is allocated first, as fork() has to copy the page tables of the parent
+int spawn_benchmark(int iterations, size_t memory_mib) {
+    std::vector<char> memory(memory_mib * 1024 * 1024);
+    // make sure the pages are actually mapped
+    std::fill(memory.begin(), memory.end(), 1);
+
+    const std::vector<std::string> args{"true"};
+    const subprocess_env_map_t env{{"LC_ALL", "C"}};
+
+    const auto legacy_us = measure_spawn(iterations, [&args, &env]() {
+        return legacy_spawn(args, env);
+    });
+
+    const auto current_us = measure_spawn(iterations, [&args, &env]() {
+        process proc{args, env};
+        return proc.close();
+    });
+
+    std::cout << iterations << " spawns with " << memory_mib << " MiB of memory mapped, per spawn:" << std::endl
+              << "fork() and exec:             " << legacy_us << " µs" << std::endl
+              << "posix_spawn() and env cache: " << current_us << " µs" << std::endl;
+
+    return 0;
+}
+
+// runs a trivial command repeatedly and prints the wall time per call, which is dominated by the time it takes to
+// notice the child's exit
+int benchmark(int iterations) {
+    const subprocess proc({"true"});
+
+    double total_ms = 0, min_ms = 0, max_ms = 0;
+
+    for (int i = 0; i < iterations; ++i) {
+        const auto begin = std::chrono::steady_clock::now();
+        const auto result = proc.run();
+        const std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - begin;
+
+        if (result.exit_code() != 0) {
+            std::cerr << "Error: command failed with exit code " << result.exit_code() << std::endl;
+            return 1;
+        }
+
+        total_ms += duration.count();
+        min_ms = (i == 0) ? duration.count() : std::min(min_ms, duration.count());
+        max_ms = std::max(max_ms, duration.count());
+    }
+
+    std::cout << iterations << " calls, per call: average " << (total_ms / iterations) << " ms, "
+              << "min " << min_ms << " ms, max " << max_ms << " ms" << std::endl;
+
+    return 0;
+}
+
+// usage: subprocess_demo [--benchmark [iterations]]
+//        subprocess_demo [--spawn-benchmark [iterations] [MiB of memory]]
 int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--benchmark") == 0) {
+        const auto iterations = (argc > 2) ? std::atoi(argv[2]) : 200;
+        return benchmark(std::max(iterations, 1));
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--spawn-benchmark") == 0) {
+        const auto iterations = (argc > 2) ? std::atoi(argv[2]) : 200;
+        const auto memory_mib = (argc > 3) ? std::atoi(argv[3]) : 0;
+        return spawn_benchmark(std::max(iterations, 1), static_cast<size_t>(std::max(memory_mib, 0)));
+    }
+
     subprocess proc({"cat", "/proc/cpuinfo"});
 
     auto result = proc.run();
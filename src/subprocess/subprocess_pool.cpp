@@ -0,0 +1,363 @@
+// system headers
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+// local headers
+#include "linuxdeploy/subprocess/subprocess_pool.h"
+#include "linuxdeploy/subprocess/process.h"
+#include "linuxdeploy/subprocess/pipe_reader.h"
+#include "linuxdeploy/util/assert.h"
+
+namespace linuxdeploy {
+    namespace subprocess {
+        /**
+         * A started job: the process and the output read from it so far.
+         */
+        class subprocess_pool::running_job_ {
+        public:
+            std::unique_ptr<job_> job;
+            process proc;
+
+            std::array<pipe_reader, 2> readers;
+            std::array<subprocess_result_buffer_t, 2> buffers;
+
+            // stdout, stderr and exit fd, set to -1 once the pipes have been closed by the child
+            std::array<int, 3> fds;
+
+            explicit running_job_(std::unique_ptr<job_> job)
+                : job(std::move(job)),
+                  proc(this->job->args, this->job->env),
+                  readers{{pipe_reader(proc.stdout_fd()), pipe_reader(proc.stderr_fd())}},
+                  fds{{proc.stdout_fd(), proc.stderr_fd(), proc.exit_fd()}} {}
+
+            // (try to) read all available data from pipe
+            void read_available_data(size_t index, subprocess_result_buffer_t& intermediate_buffer) {
+                if (fds[index] < 0) {
+                    return;
+                }
+
+                for (;;) {
+                    const auto bytes_read = readers[index].read(intermediate_buffer);
+
+                    if (bytes_read == 0) {
+                        if (readers[index].eof()) {
+                            fds[index] = -1;
+                        }
+
+                        break;
+                    }
+
+                    auto& buffer = buffers[index];
+                    buffer.insert(buffer.end(), intermediate_buffer.begin(), intermediate_buffer.begin() + bytes_read);
+                }
+            }
+
+            subprocess_result result() {
+                // make sure contents are null-terminated
+                buffers[0].emplace_back('\0');
+                buffers[1].emplace_back('\0');
+
+                const auto exit_code = proc.close();
+
+                return subprocess_result{
+                    exit_code, std::move(buffers[0]), std::move(buffers[1]), proc.resource_usage()
+                };
+            }
+        };
+
+        subprocess_pool::subprocess_pool(size_t max_concurrency)
+            : max_concurrency_(
+                max_concurrency > 0 ? max_concurrency : std::max(std::thread::hardware_concurrency(), 1u)
+            ) {
+            if (pipe2(wake_up_fds_, O_CLOEXEC | O_NONBLOCK) != 0) {
+                const auto error = errno;
+                throw std::runtime_error("failed to create pipe: " + std::string(strerror(error)));
+            }
+
+            event_loop_ = std::thread(&subprocess_pool::run_event_loop_, this);
+        }
+
+        subprocess_pool::~subprocess_pool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+
+            // the event loop finishes the queued and running jobs before it returns
+            wake_up_event_loop_();
+            event_loop_.join();
+
+            ::close(wake_up_fds_[0]);
+            ::close(wake_up_fds_[1]);
+        }
+
+        size_t subprocess_pool::max_concurrency() const {
+            return max_concurrency_;
+        }
+
+        std::future<subprocess_result> subprocess_pool::submit(std::vector<std::string> args,
+                                                               subprocess_env_map_t env) {
+            // preconditions
+            util::assert::assert_not_empty(args);
+
+            // std::function requires copyable functors, so the promise has to be shared
+            auto promise = std::make_shared<std::promise<subprocess_result>>();
+            auto future = promise->get_future();
+
+            std::unique_ptr<job_> job(new job_{std::move(args), std::move(env), nullptr, nullptr});
+
+            job->on_result = [promise](subprocess_result result) {
+                promise->set_value(std::move(result));
+            };
+
+            job->on_error = [promise](std::exception_ptr error) {
+                promise->set_exception(std::move(error));
+            };
+
+            enqueue_(std::move(job));
+
+            return future;
+        }
+
+        void subprocess_pool::submit(std::vector<std::string> args, subprocess_env_map_t env, callback_t callback) {
+            // preconditions
+            util::assert::assert_not_empty(args);
+
+            std::unique_ptr<job_> job(new job_{std::move(args), std::move(env), std::move(callback), nullptr});
+
+            // reported by wait() through finish_job_()
+            job->on_error = [](std::exception_ptr error) {
+                std::rethrow_exception(std::move(error));
+            };
+
+            enqueue_(std::move(job));
+        }
+
+        void subprocess_pool::wait() {
+            std::unique_lock<std::mutex> lock(mutex_);
+
+            job_finished_.wait(lock, [this]() {
+                return unfinished_jobs_ == 0;
+            });
+
+            if (error_ != nullptr) {
+                auto error = std::move(error_);
+                error_ = nullptr;
+                std::rethrow_exception(error);
+            }
+        }
+
+        void subprocess_pool::enqueue_(std::unique_ptr<job_> job) {
+            std::exception_ptr event_loop_error;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+
+                ++unfinished_jobs_;
+
+                // nobody would ever start the job
+                if (event_loop_error_ != nullptr) {
+                    event_loop_error = event_loop_error_;
+                } else {
+                    queue_.emplace_back(std::move(job));
+                }
+            }
+
+            if (event_loop_error != nullptr) {
+                finish_job_([&job, &event_loop_error]() {
+                    job->on_error(event_loop_error);
+                });
+
+                return;
+            }
+
+            wake_up_event_loop_();
+        }
+
+        void subprocess_pool::wake_up_event_loop_() {
+            // if the pipe is full, the event loop is going to wake up anyway
+            const char byte = 0;
+            (void) !write(wake_up_fds_[1], &byte, 1);
+        }
+
+        void subprocess_pool::finish_job_(const std::function<void()>& deliver) {
+            std::exception_ptr error;
+
+            try {
+                deliver();
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+
+                if (error != nullptr && error_ == nullptr) {
+                    error_ = error;
+                }
+
+                --unfinished_jobs_;
+            }
+
+            job_finished_.notify_all();
+        }
+
+        void subprocess_pool::run_event_loop_() {
+            std::vector<std::unique_ptr<running_job_>> running_jobs;
+
+            try {
+                process_events_(running_jobs);
+            } catch (...) {
+                fail_all_jobs_(running_jobs, std::current_exception());
+            }
+        }
+
+        void subprocess_pool::fail_all_jobs_(std::vector<std::unique_ptr<running_job_>>& running_jobs,
+                                             const std::exception_ptr& error) {
+            std::deque<std::unique_ptr<job_>> queued_jobs;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+
+                // jobs submitted from now on are failed right away by enqueue_()
+                event_loop_error_ = error;
+                queued_jobs.swap(queue_);
+            }
+
+            for (const auto& running_job : running_jobs) {
+                finish_job_([&running_job, &error]() {
+                    running_job->job->on_error(error);
+                });
+            }
+
+            for (const auto& job : queued_jobs) {
+                finish_job_([&job, &error]() {
+                    job->on_error(error);
+                });
+            }
+
+            // the processes are reaped by their destructors
+            running_jobs.clear();
+        }
+
+        void subprocess_pool::process_events_(std::vector<std::unique_ptr<running_job_>>& running_jobs) {
+            std::vector<pollfd> poll_fds;
+
+            // shared by all jobs, the data is appended to the jobs' buffers right away
+            subprocess_result_buffer_t intermediate_buffer(4096);
+
+            for (;;) {
+                std::vector<std::unique_ptr<job_>> jobs_to_start;
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+
+                    while (running_jobs.size() + jobs_to_start.size() < max_concurrency_ && !queue_.empty()) {
+                        jobs_to_start.emplace_back(std::move(queue_.front()));
+                        queue_.pop_front();
+                    }
+
+                    if (stopping_ && queue_.empty() && running_jobs.empty() && jobs_to_start.empty()) {
+                        return;
+                    }
+                }
+
+                // spawning takes a while, so it's done without holding the lock
+                for (auto& job : jobs_to_start) {
+                    // the job is gone if the constructor throws
+                    const auto on_error = job->on_error;
+
+                    try {
+                        running_jobs.emplace_back(new running_job_(std::move(job)));
+                    } catch (...) {
+                        const auto error = std::current_exception();
+                        finish_job_([&on_error, &error]() {
+                            on_error(error);
+                        });
+                    }
+                }
+
+                // the wake up pipe comes first, followed by stdout, stderr and exit fd of every running job
+                poll_fds.clear();
+                poll_fds.push_back({wake_up_fds_[0], POLLIN, 0});
+
+                // with the SIGCHLD fallback, notifications may be consumed by other threads, see process::exit_fd()
+                int timeout_ms = -1;
+
+                for (const auto& running_job : running_jobs) {
+                    for (const auto fd : running_job->fds) {
+                        poll_fds.push_back({fd, POLLIN, 0});
+                    }
+
+                    if (running_job->proc.exit_fd_is_shared()) {
+                        timeout_ms = 50;
+                    }
+                }
+
+                const auto rv = poll(poll_fds.data(), poll_fds.size(), timeout_ms);
+
+                if (rv < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+
+                    throw std::runtime_error{"poll() failed: " + std::string(strerror(errno))};
+                }
+
+                if (poll_fds[0].revents != 0) {
+                    char buffer[64];
+                    while (read(wake_up_fds_[0], buffer, sizeof(buffer)) > 0);
+                }
+
+                // finished jobs are removed from running_jobs while iterating, so the indices differ
+                const auto polled_jobs_count = running_jobs.size();
+
+                for (size_t i = 0, job_index = 0; i < polled_jobs_count; ++i) {
+                    auto& running_job = *running_jobs[job_index];
+                    const auto* job_poll_fds = &poll_fds[1 + i * 3];
+
+                    for (size_t j = 0; j < running_job.readers.size(); ++j) {
+                        if (job_poll_fds[j].revents != 0) {
+                            running_job.read_available_data(j, intermediate_buffer);
+                        }
+                    }
+
+                    // see subprocess::run()
+                    if (rv == 0 || job_poll_fds[2].revents != 0 || running_job.fds[2] < 0) {
+                        running_job.read_available_data(0, intermediate_buffer);
+                        running_job.read_available_data(1, intermediate_buffer);
+
+                        if (!running_job.proc.is_running()) {
+                            std::unique_ptr<running_job_> finished_job = std::move(running_jobs[job_index]);
+                            running_jobs.erase(running_jobs.begin() + job_index);
+
+                            try {
+                                auto result = finished_job->result();
+
+                                finish_job_([&finished_job, &result]() {
+                                    finished_job->job->on_result(std::move(result));
+                                });
+                            } catch (...) {
+                                const auto error = std::current_exception();
+                                finish_job_([&finished_job, &error]() {
+                                    finished_job->job->on_error(error);
+                                });
+                            }
+
+                            continue;
+                        }
+                    }
+
+                    ++job_index;
+                }
+            }
+        }
+    }
+}
@@ -5,14 +5,20 @@
 using namespace linuxdeploy::subprocess;
 
 subprocess_result::subprocess_result(int exit_code, subprocess_result_buffer_t stdout_contents,
-                                     subprocess_result_buffer_t stderr_contents)
-    : exit_code_(exit_code), stdout_contents_(std::move(stdout_contents)), stderr_contents_(std::move(stderr_contents)) {}
+                                     subprocess_result_buffer_t stderr_contents,
+                                     subprocess_resource_usage resource_usage)
+    : exit_code_(exit_code), stdout_contents_(std::move(stdout_contents)), stderr_contents_(std::move(stderr_contents)),
+      resource_usage_(std::move(resource_usage)) {}
 
 
 int subprocess_result::exit_code() const {
     return exit_code_;
 }
 
+const subprocess_resource_usage& subprocess_result::resource_usage() const {
+    return resource_usage_;
+}
+
 const subprocess_result_buffer_t& subprocess_result::stdout_contents() const {
     return stdout_contents_;
 }
@@ -28,3 +34,22 @@ std::string subprocess_result::stdout_string() const {
 std::string subprocess_result::stderr_string() const {
     return stderr_contents().data();
 }
+
+namespace {
+    boost::string_view view_without_terminator(const subprocess_result_buffer_t& buffer) {
+        auto size = buffer.size();
+
+        if (size > 0 && buffer.back() == '\0')
+            --size;
+
+        return {buffer.data(), size};
+    }
+}
+
+boost::string_view subprocess_result::stdout_view() const {
+    return view_without_terminator(stdout_contents_);
+}
+
+boost::string_view subprocess_result::stderr_view() const {
+    return view_without_terminator(stderr_contents_);
+}
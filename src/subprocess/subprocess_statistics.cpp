@@ -0,0 +1,143 @@
+// system headers
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+
+// local headers
+#include "linuxdeploy/subprocess/subprocess_statistics.h"
+
+// shorter than using namespace ...
+using namespace linuxdeploy::subprocess;
+
+namespace {
+    std::string json_string(const std::string& value) {
+        std::string rv = "\"";
+
+        for (const auto c : value) {
+            switch (c) {
+                case '"':
+                    rv += "\\\"";
+                    break;
+                case '\\':
+                    rv += "\\\\";
+                    break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char escaped[8];
+                        snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned int>(c));
+                        rv += escaped;
+                    } else {
+                        rv += c;
+                    }
+            }
+        }
+
+        return rv + "\"";
+    }
+}
+
+subprocess_statistics& subprocess_statistics::instance() {
+    static subprocess_statistics instance;
+    return instance;
+}
+
+void subprocess_statistics::record(const subprocess_resource_usage& resource_usage) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto& entry = entries_[resource_usage.executable];
+
+    entry.executable = resource_usage.executable;
+    ++entry.processes_count;
+    entry.wall_time_seconds += resource_usage.wall_time_seconds;
+    entry.user_time_seconds += resource_usage.user_time_seconds;
+    entry.system_time_seconds += resource_usage.system_time_seconds;
+    entry.max_rss_kib = std::max(entry.max_rss_kib, resource_usage.max_rss_kib);
+}
+
+void subprocess_statistics::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+}
+
+std::vector<subprocess_statistics_entry> subprocess_statistics::entries() const {
+    std::vector<subprocess_statistics_entry> rv;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        for (const auto& entry : entries_)
+            rv.emplace_back(entry.second);
+    }
+
+    auto by_wall_time = [](const subprocess_statistics_entry& a, const subprocess_statistics_entry& b) {
+        return a.wall_time_seconds > b.wall_time_seconds;
+    };
+
+    std::stable_sort(rv.begin(), rv.end(), by_wall_time);
+
+    return rv;
+}
+
+std::string subprocess_statistics::summary() const {
+    const auto entries = this->entries();
+
+    if (entries.empty())
+        return "";
+
+    size_t executable_width = std::string("executable").size();
+
+    for (const auto& entry : entries)
+        executable_width = std::max(executable_width, entry.executable.size());
+
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(3);
+
+    oss << std::left << std::setw(static_cast<int>(executable_width)) << "executable" << std::right
+        << std::setw(10) << "processes"
+        << std::setw(12) << "wall [s]"
+        << std::setw(12) << "user [s]"
+        << std::setw(12) << "sys [s]"
+        << std::setw(16) << "max RSS [KiB]" << std::endl;
+
+    for (const auto& entry : entries) {
+        oss << std::left << std::setw(static_cast<int>(executable_width)) << entry.executable << std::right
+            << std::setw(10) << entry.processes_count
+            << std::setw(12) << entry.wall_time_seconds
+            << std::setw(12) << entry.user_time_seconds
+            << std::setw(12) << entry.system_time_seconds
+            << std::setw(16) << entry.max_rss_kib << std::endl;
+    }
+
+    return oss.str();
+}
+
+std::string subprocess_statistics::to_json() const {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(6);
+
+    oss << "[";
+
+    bool first = true;
+
+    for (const auto& entry : entries()) {
+        if (!first)
+            oss << ",";
+
+        first = false;
+
+        oss << std::endl
+            << "  {"
+            << "\"executable\": " << json_string(entry.executable) << ", "
+            << "\"processes_count\": " << entry.processes_count << ", "
+            << "\"wall_time_seconds\": " << entry.wall_time_seconds << ", "
+            << "\"user_time_seconds\": " << entry.user_time_seconds << ", "
+            << "\"system_time_seconds\": " << entry.system_time_seconds << ", "
+            << "\"max_rss_kib\": " << entry.max_rss_kib
+            << "}";
+    }
+
+    oss << std::endl << "]" << std::endl;
+
+    return oss.str();
+}
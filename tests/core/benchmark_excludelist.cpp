@@ -0,0 +1,115 @@
+// compares the compiled excludelist matcher with a linear scan calling fnmatch() for every entry
+// usage: benchmark_excludelist [iterations] [excludelist file] [directory...]
+// the filenames are taken from the given directories, or the system library directories by default
+// without an excludelist file, the one generated at build time is used
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fnmatch.h>
+
+#include "linuxdeploy/core/excludelist_matcher.h"
+
+using namespace linuxdeploy::core::excludelist_matcher;
+namespace bf = boost::filesystem;
+
+namespace {
+    // the way deployLibrary() used to check the excludelist
+    bool isInExcludelistLinear(const std::vector<std::string>& entries, const std::string& fileName) {
+        for (const auto& entry : entries) {
+            if (entry == fileName)
+                return true;
+
+            if (fnmatch(entry.c_str(), fileName.c_str(), FNM_PATHNAME) == 0)
+                return true;
+        }
+
+        return false;
+    }
+
+    // runs check on every filename iterations times, returns the average duration per filename in nanoseconds
+    template<typename Check>
+    double measure(const std::vector<std::string>& fileNames, int iterations, size_t& matchesCount, Check check) {
+        matchesCount = 0;
+
+        const auto begin = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < iterations; ++i) {
+            for (const auto& fileName : fileNames) {
+                if (check(fileName))
+                    ++matchesCount;
+            }
+        }
+
+        const std::chrono::duration<double, std::nano> duration = std::chrono::steady_clock::now() - begin;
+        matchesCount /= iterations;
+        return duration.count() / iterations / fileNames.size();
+    }
+}
+
+int main(int argc, char** argv) {
+    int iterations = 100;
+    std::vector<std::string> entries;
+    std::vector<bf::path> directories;
+
+    for (int i = 1; i < argc; ++i) {
+        const bf::path arg(argv[i]);
+
+        if (i == 1 && arg.string().find_first_not_of("0123456789") == std::string::npos)
+            iterations = std::atoi(argv[i]);
+        else if (entries.empty() && bf::is_regular_file(arg))
+            entries = ExcludelistMatcher::readEntries(arg);
+        else
+            directories.emplace_back(arg);
+    }
+
+    if (entries.empty())
+        entries = ExcludelistMatcher::getGeneratedEntries();
+
+    if (directories.empty())
+        directories = {"/lib", "/lib64", "/usr/lib", "/usr/lib64", "/usr/lib/x86_64-linux-gnu", "/usr/local/lib"};
+
+    std::vector<std::string> fileNames;
+
+    for (const auto& directory : directories) {
+        if (!bf::is_directory(directory))
+            continue;
+
+        for (bf::directory_iterator it(directory); it != bf::directory_iterator(); ++it)
+            fileNames.emplace_back(it->path().filename().string());
+    }
+
+    // make sure there are some hits, too
+    fileNames.insert(fileNames.end(), entries.begin(), entries.end());
+
+    const auto compileBegin = std::chrono::steady_clock::now();
+    const ExcludelistMatcher matcher(entries);
+    const std::chrono::duration<double, std::micro> compileDuration = std::chrono::steady_clock::now() - compileBegin;
+
+    std::cout << entries.size() << " excludelist entries (" << matcher.literalsCount() << " literals, "
+              << matcher.patternsCount() << " patterns) compiled in " << compileDuration.count() << " µs" << std::endl;
+    std::cout << fileNames.size() << " filenames, " << iterations << " iterations" << std::endl;
+
+    size_t linearMatches, compiledMatches;
+
+    const auto linearDuration = measure(fileNames, iterations, linearMatches, [&entries](const std::string& fileName) {
+        return isInExcludelistLinear(entries, fileName);
+    });
+
+    const auto compiledDuration = measure(fileNames, iterations, compiledMatches, [&matcher](const std::string& fileName) {
+        return matcher.matches(fileName);
+    });
+
+    std::cout << "linear fnmatch scan: " << linearDuration << " ns per library, " << linearMatches << " matches" << std::endl;
+    std::cout << "compiled matcher:    " << compiledDuration << " ns per library, " << compiledMatches << " matches" << std::endl;
+
+    if (linearMatches != compiledMatches) {
+        std::cerr << "Error: the results differ" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
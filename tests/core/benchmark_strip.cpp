@@ -0,0 +1,86 @@
+// compares the native stripper with binutils' strip
+// usage: benchmark_strip [iterations] <ELF file>...
+// if no files are passed, the test library is used, which is too small for meaningful results, though
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "linuxdeploy/core/elf_file.h"
+#include "linuxdeploy/core/log.h"
+
+using namespace linuxdeploy::core::elf_file;
+using namespace linuxdeploy::core::log;
+namespace bf = boost::filesystem;
+
+namespace {
+    // strips file to destination iterations times, returns the average duration in milliseconds
+    double measure(STRIPPER stripper, const bf::path& path, const bf::path& destination, int iterations) {
+        ElfFile::setStripper(stripper);
+
+        const auto begin = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < iterations; ++i) {
+            if (!ElfFile(path).strip(destination)) {
+                std::cerr << "Failed to strip " << path << std::endl;
+                exit(1);
+            }
+        }
+
+        const std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - begin;
+        return duration.count() / iterations;
+    }
+}
+
+int main(int argc, char** argv) {
+    ldLog::setVerbosity(LD_WARNING);
+
+    int iterations = 10;
+    std::vector<bf::path> paths;
+
+    for (int i = 1; i < argc; ++i) {
+        if (i == 1 && std::string(argv[i]).find_first_not_of("0123456789") == std::string::npos)
+            iterations = std::atoi(argv[i]);
+        else
+            paths.emplace_back(argv[i]);
+    }
+
+    if (paths.empty())
+        paths.emplace_back(SIMPLE_LIBRARY_PATH);
+
+    const auto tmpDir = bf::temp_directory_path() / bf::unique_path("linuxdeploy-benchmark-%%%%-%%%%-%%%%");
+    bf::create_directories(tmpDir);
+
+    std::cout << std::left << std::setw(40) << "file" << std::right
+              << std::setw(12) << "size" << std::setw(12) << "native" << std::setw(12) << "binutils"
+              << std::setw(12) << "native ms" << std::setw(12) << "strip ms" << std::endl;
+
+    double nativeTotal = 0, binutilsTotal = 0;
+
+    for (const auto& path : paths) {
+        const auto nativePath = tmpDir / "native";
+        const auto binutilsPath = tmpDir / "binutils";
+
+        const auto nativeDuration = measure(NATIVE_STRIPPER, path, nativePath, iterations);
+        const auto binutilsDuration = measure(BINUTILS_STRIPPER, path, binutilsPath, iterations);
+
+        nativeTotal += nativeDuration;
+        binutilsTotal += binutilsDuration;
+
+        std::cout << std::left << std::setw(40) << path.filename().string() << std::right
+                  << std::setw(12) << bf::file_size(path)
+                  << std::setw(12) << bf::file_size(nativePath)
+                  << std::setw(12) << bf::file_size(binutilsPath)
+                  << std::fixed << std::setprecision(2)
+                  << std::setw(12) << nativeDuration << std::setw(12) << binutilsDuration << std::endl;
+    }
+
+    std::cout << "total: native " << nativeTotal << " ms, binutils " << binutilsTotal << " ms per iteration" << std::endl;
+
+    bf::remove_all(tmpDir);
+
+    return 0;
+}
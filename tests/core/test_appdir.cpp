@@ -1,7 +1,11 @@
+#include <fstream>
+
 #include "gtest/gtest.h"
 #include  "linuxdeploy/core/appdir.h"
+#include "linuxdeploy/core/elf_file.h"
 
 using namespace linuxdeploy::core::appdir;
+using namespace linuxdeploy::core::elf_file;
 using namespace linuxdeploy::desktopfile;
 using namespace boost::filesystem;
 
@@ -99,6 +103,45 @@ namespace AppDirTest {
         ASSERT_TRUE(is_regular_file(tmpAppDir / "usr/lib" / path(SIMPLE_LIBRARY_PATH).filename()));
     }
 
+    TEST_F(AppDirUnitTestsFixture, deployLibraryThroughAliases) {
+        const auto aliasesDir = temp_directory_path() / unique_path("linuxdeploy-tests-aliases-%%%%-%%%%");
+        create_directories(aliasesDir / "lib");
+
+        const auto fileName = path(SIMPLE_LIBRARY_PATH).filename();
+
+        // the same filename in another directory, and another filename
+        create_symlink(SIMPLE_LIBRARY_PATH, aliasesDir / "lib" / fileName);
+        create_symlink(SIMPLE_LIBRARY_PATH, aliasesDir / "libsimple_alias.so.1");
+
+        ASSERT_TRUE(appDir.deployLibrary(SIMPLE_LIBRARY_PATH));
+        ASSERT_TRUE(appDir.deployLibrary(aliasesDir / "lib" / fileName));
+        ASSERT_TRUE(appDir.deployLibrary(aliasesDir / "libsimple_alias.so.1"));
+        ASSERT_TRUE(appDir.executeDeferredOperations());
+
+        remove_all(aliasesDir);
+
+        assertIsRegularFile(tmpAppDir / "usr/lib" / fileName);
+        assertIsSymlink(fileName, tmpAppDir / "usr/lib/libsimple_alias.so.1");
+    }
+
+    TEST_F(AppDirUnitTestsFixture, deployLibrarySymlinkChain) {
+        const auto chainDir = temp_directory_path() / unique_path("linuxdeploy-tests-chain-%%%%-%%%%");
+        create_directories(chainDir);
+
+        copy_file(SIMPLE_LIBRARY_PATH, chainDir / "libchain.so.1.2.3");
+        create_symlink("libchain.so.1.2.3", chainDir / "libchain.so.1");
+        create_symlink("libchain.so.1", chainDir / "libchain.so");
+
+        ASSERT_TRUE(appDir.deployLibrary(chainDir / "libchain.so"));
+        ASSERT_TRUE(appDir.executeDeferredOperations());
+
+        remove_all(chainDir);
+
+        assertIsRegularFile(tmpAppDir / "usr/lib/libchain.so.1.2.3");
+        assertIsSymlink("libchain.so.1.2.3", tmpAppDir / "usr/lib/libchain.so.1");
+        assertIsSymlink("libchain.so.1", tmpAppDir / "usr/lib/libchain.so");
+    }
+
     TEST_F(AppDirUnitTestsFixture, deployExecutable) {
         appDir.deployExecutable(SIMPLE_EXECUTABLE_PATH);
         ASSERT_TRUE(appDir.executeDeferredOperations());
@@ -110,6 +153,38 @@ namespace AppDirTest {
         assertIsRegularFile(libTargetPath);
     }
 
+    TEST_F(AppDirUnitTestsFixture, deployExecutableWithExcludelistFile) {
+        const auto excludelistPath = temp_directory_path() / unique_path("linuxdeploy-tests-excludelist-%%%%-%%%%");
+        std::ofstream(excludelistPath.string()) << "# comment" << std::endl << "libsimple_*.so" << std::endl;
+
+        ASSERT_TRUE(appDir.addExcludelistFile(excludelistPath));
+        ASSERT_FALSE(appDir.addExcludelistFile(tmpAppDir / "does-not-exist"));
+        remove(excludelistPath);
+
+        appDir.deployExecutable(SIMPLE_EXECUTABLE_PATH);
+        ASSERT_TRUE(appDir.executeDeferredOperations());
+
+        assertIsRegularFile(tmpAppDir / "usr/bin" / path(SIMPLE_EXECUTABLE_PATH).filename());
+        ASSERT_FALSE(exists(tmpAppDir / "usr/lib" / path(SIMPLE_LIBRARY_PATH).filename()));
+    }
+
+    TEST_F(AppDirUnitTestsFixture, deployDependenciesOnlyForElfFiles) {
+        appDir.createBasicStructure();
+
+        const auto executablePath = tmpAppDir / "usr/bin" / path(SIMPLE_EXECUTABLE_PATH).filename();
+        const auto textFilePath = tmpAppDir / "usr/bin" / path(SIMPLE_FILE_PATH).filename();
+        copy_file(SIMPLE_EXECUTABLE_PATH, executablePath);
+        copy_file(SIMPLE_FILE_PATH, textFilePath);
+
+        // non-ELF files are skipped silently if requested
+        ASSERT_TRUE(appDir.deployDependenciesOnlyForElfFiles({executablePath, textFilePath}, true));
+        ASSERT_TRUE(appDir.executeDeferredOperations());
+
+        assertIsRegularFile(tmpAppDir / "usr/lib" / path(SIMPLE_LIBRARY_PATH).filename());
+
+        ASSERT_FALSE(appDir.deployDependenciesOnlyForElfFiles({executablePath, textFilePath}, false));
+    }
+
     TEST_F(AppDirUnitTestsFixture, deployDesktopFile) {
         const DesktopFile desktopFile{SIMPLE_DESKTOP_ENTRY_PATH};
         appDir.deployDesktopFile(desktopFile);
@@ -177,6 +252,78 @@ namespace AppDirTest {
         appDir.deployFile(nonexistingFilePath, destination);
         ASSERT_FALSE(appDir.executeDeferredOperations());
     }
+
+    TEST_F(AppDirUnitTestsFixture, deployFilesInParallel) {
+        appDir.setCopyQueueDepth(4);
+
+        const auto destination = tmpAppDir / "usr/share/doc/simple_application/";
+        appDir.deployFile(SIMPLE_FILE_PATH, destination);
+        appDir.deployFile(READONLY_FILE_PATH, destination);
+        appDir.deployFile(SIMPLE_ICON_PATH, destination / "icons/");
+        appDir.deployFile(SIMPLE_DESKTOP_ENTRY_PATH, destination / "icons/simple_app.desktop");
+
+        // a failing copy must not prevent the other files from being copied
+        appDir.deployFile("/i/am/sure/this/file/does/not/exist", destination);
+
+        ASSERT_FALSE(appDir.executeDeferredOperations());
+
+        assertIsRegularFile(destination / path(SIMPLE_FILE_PATH).filename());
+        assertIsRegularFile(destination / path(READONLY_FILE_PATH).filename());
+        assertIsRegularFile(destination / "icons" / path(SIMPLE_ICON_PATH).filename());
+        assertIsRegularFile(destination / "icons/simple_app.desktop");
+    }
+
+    TEST_F(AppDirUnitTestsFixture, deployExecutableInParallel) {
+        appDir.setJobs(4);
+        appDir.deployExecutable(SIMPLE_EXECUTABLE_PATH);
+        ASSERT_TRUE(appDir.executeDeferredOperations());
+
+        const auto binaryTargetPath = tmpAppDir / "usr/bin" / path(SIMPLE_EXECUTABLE_PATH).filename();
+        const auto libTargetPath = tmpAppDir / "usr/lib" / path(SIMPLE_LIBRARY_PATH).filename();
+
+        // every file is copied, stripped and has its rpath set by its own pipeline
+        assertIsExecutableFile(binaryTargetPath);
+        assertIsRegularFile(libTargetPath);
+        EXPECT_EQ(ElfFile(binaryTargetPath).getRPath(), "$ORIGIN/../lib");
+        EXPECT_EQ(ElfFile(libTargetPath).getRPath(), "$ORIGIN");
+    }
+
+    TEST_F(AppDirUnitTestsFixture, deduplicateFiles) {
+        const auto docDir = tmpAppDir / "usr/share/doc";
+        create_directories(docDir / "a");
+        create_directories(docDir / "b");
+
+        std::ofstream(path(docDir / "a/original.txt").string()) << "duplicate";
+        std::ofstream(path(docDir / "b/duplicate.txt").string()) << "duplicate";
+        std::ofstream(path(docDir / "b/other.txt").string()) << "different";
+        std::ofstream(path(docDir / "b/executable.txt").string()) << "duplicate";
+        permissions(docDir / "b/executable.txt", add_perms | owner_exe);
+
+        ASSERT_TRUE(appDir.deduplicateFiles(DEDUPLICATE_WITH_HARDLINKS));
+
+        EXPECT_TRUE(equivalent(docDir / "a/original.txt", docDir / "b/duplicate.txt"));
+        EXPECT_FALSE(equivalent(docDir / "a/original.txt", docDir / "b/other.txt"));
+        // files with other permissions are kept, too
+        EXPECT_FALSE(equivalent(docDir / "a/original.txt", docDir / "b/executable.txt"));
+
+        // files which are hardlinks of each other already are left alone
+        ASSERT_TRUE(appDir.deduplicateFiles(DEDUPLICATE_WITH_SYMLINKS));
+        EXPECT_FALSE(is_symlink(docDir / "b/duplicate.txt"));
+    }
+
+    TEST_F(AppDirUnitTestsFixture, deduplicateFilesWithSymlinks) {
+        const auto docDir = tmpAppDir / "usr/share/doc";
+        create_directories(docDir / "a");
+        create_directories(docDir / "b");
+
+        std::ofstream(path(docDir / "a/original.txt").string()) << "duplicate";
+        std::ofstream(path(docDir / "b/duplicate.txt").string()) << "duplicate";
+
+        ASSERT_TRUE(appDir.deduplicateFiles(DEDUPLICATE_WITH_SYMLINKS));
+
+        assertIsSymlink("../a/original.txt", docDir / "b/duplicate.txt");
+        EXPECT_FALSE(is_symlink(docDir / "a/original.txt"));
+    }
 }
 
 int main(int argc, char **argv) {
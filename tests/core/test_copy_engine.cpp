@@ -0,0 +1,122 @@
+#include <fstream>
+#include <iterator>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+#include "linuxdeploy/core/copy_engine.h"
+
+using namespace linuxdeploy::core::copy_engine;
+namespace bf = boost::filesystem;
+
+namespace {
+    std::string readFile(const bf::path& path) {
+        std::ifstream ifs(path.string(), std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    }
+
+    struct stat statFile(const bf::path& path) {
+        struct stat st{};
+        stat(path.c_str(), &st);
+        return st;
+    }
+}
+
+namespace LinuxDeployTest {
+    class CopyEngineTest : public ::testing::Test {
+    public:
+        bf::path tmpDir;
+
+        void SetUp() override {
+            tmpDir = bf::temp_directory_path() / bf::unique_path("linuxdeploy-tests-%%%%-%%%%-%%%%");
+            bf::create_directories(tmpDir);
+        }
+
+        void TearDown() override {
+            setCopyMode(COPY_MODE_COPY);
+            bf::remove_all(tmpDir);
+        }
+    };
+
+    TEST_F(CopyEngineTest, checkCopyFile) {
+        const auto copyPath = tmpDir / "copy";
+
+        const auto method = copyFile(SIMPLE_LIBRARY_PATH, copyPath);
+        EXPECT_NE(method, COPY_METHOD_HARDLINK);
+        EXPECT_EQ(readFile(copyPath), readFile(SIMPLE_LIBRARY_PATH));
+        EXPECT_EQ(statFile(copyPath).st_mode, statFile(SIMPLE_LIBRARY_PATH).st_mode);
+
+        // existing files are replaced
+        copyFile(SIMPLE_FILE_PATH, copyPath);
+        EXPECT_EQ(readFile(copyPath), readFile(SIMPLE_FILE_PATH));
+
+        EXPECT_THROW(copyFile(tmpDir / "does-not-exist", tmpDir / "copy2"), CopyError);
+        EXPECT_THROW(copyFile(tmpDir, tmpDir / "copy2"), CopyError);
+    }
+
+    TEST_F(CopyEngineTest, checkSparseFile) {
+        const auto sparsePath = tmpDir / "sparse";
+        const auto copyPath = tmpDir / "copy";
+
+        constexpr off_t size = 16 * 1024 * 1024;
+
+        // data at the beginning and in the middle, holes everywhere else
+        {
+            const int fd = open(sparsePath.c_str(), O_WRONLY | O_CREAT, 0644);
+            ASSERT_GE(fd, 0);
+            ASSERT_EQ(pwrite(fd, "begin", 5, 0), 5);
+            ASSERT_EQ(pwrite(fd, "middle", 6, size / 2), 6);
+            ASSERT_EQ(ftruncate(fd, size), 0);
+            close(fd);
+        }
+
+        copyFile(sparsePath, copyPath);
+
+        EXPECT_EQ(readFile(copyPath), readFile(sparsePath));
+        EXPECT_EQ(statFile(copyPath).st_size, size);
+
+        // if the filesystem supports holes, the copy must not use (much) more space than the original
+        EXPECT_LE(statFile(copyPath).st_blocks, statFile(sparsePath).st_blocks + 1024);
+    }
+
+    TEST_F(CopyEngineTest, checkHardlinkMode) {
+        const auto sourcePath = tmpDir / "source";
+        const auto linkPath = tmpDir / "link";
+        bf::copy_file(SIMPLE_FILE_PATH, sourcePath);
+
+        // hardlinks are only created if the mode is selected and the caller allows it
+        EXPECT_NE(copyFile(sourcePath, linkPath, true), COPY_METHOD_HARDLINK);
+
+        setCopyMode(COPY_MODE_HARDLINK);
+        EXPECT_NE(copyFile(sourcePath, linkPath, false), COPY_METHOD_HARDLINK);
+
+        EXPECT_EQ(copyFile(sourcePath, linkPath, true), COPY_METHOD_HARDLINK);
+        EXPECT_EQ(statFile(linkPath).st_ino, statFile(sourcePath).st_ino);
+
+        // copying into a hardlink must not modify the source file
+        setCopyMode(COPY_MODE_COPY);
+        copyFile(SIMPLE_LIBRARY_PATH, linkPath);
+        EXPECT_EQ(readFile(sourcePath), readFile(SIMPLE_FILE_PATH));
+        EXPECT_NE(statFile(linkPath).st_ino, statFile(sourcePath).st_ino);
+    }
+
+    TEST_F(CopyEngineTest, checkBreakHardlink) {
+        const auto sourcePath = tmpDir / "source";
+        const auto linkPath = tmpDir / "link";
+        bf::copy_file(SIMPLE_FILE_PATH, sourcePath);
+        bf::create_hard_link(sourcePath, linkPath);
+
+        breakHardlink(linkPath);
+
+        EXPECT_NE(statFile(linkPath).st_ino, statFile(sourcePath).st_ino);
+        EXPECT_EQ(statFile(sourcePath).st_nlink, 1);
+        EXPECT_EQ(readFile(linkPath), readFile(sourcePath));
+
+        // files with a single link are left alone
+        const auto inode = statFile(linkPath).st_ino;
+        breakHardlink(linkPath);
+        EXPECT_EQ(statFile(linkPath).st_ino, inode);
+    }
+}
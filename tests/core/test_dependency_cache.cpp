@@ -0,0 +1,143 @@
+#include <cstdlib>
+#include <fstream>
+
+#include "gtest/gtest.h"
+
+#include "linuxdeploy/core/dependency_cache.h"
+#include "linuxdeploy/core/elf_file.h"
+
+using namespace linuxdeploy::core::dependency_cache;
+using namespace linuxdeploy::core::elf_file;
+namespace bf = boost::filesystem;
+
+namespace LinuxDeployTest {
+    class DependencyCacheTest : public ::testing::Test {
+    public:
+        bf::path tmpDir;
+        bf::path cachePath;
+        bf::path libraryPath;
+        bf::path executablePath;
+        DEPENDENCY_RESOLVER previousDependencyResolver{};
+
+        void SetUp() override {
+            previousDependencyResolver = ElfFile::getDependencyResolver();
+
+            tmpDir = bf::temp_directory_path() / bf::unique_path("linuxdeploy-tests-%%%%-%%%%-%%%%");
+            bf::create_directories(tmpDir);
+
+            cachePath = tmpDir / "cache" / "dependencies.cache";
+
+            libraryPath = tmpDir / bf::path(SIMPLE_LIBRARY_PATH).filename();
+            executablePath = tmpDir / bf::path(SIMPLE_EXECUTABLE_PATH).filename();
+            bf::copy_file(SIMPLE_LIBRARY_PATH, libraryPath);
+            bf::copy_file(SIMPLE_EXECUTABLE_PATH, executablePath);
+        }
+
+        void TearDown() override {
+            ElfFile::setDependencyCache(nullptr);
+            ElfFile::setDependencyResolver(previousDependencyResolver);
+            bf::remove_all(tmpDir);
+        }
+
+        CachedFile createCachedFile() const {
+            CachedFile cachedFile;
+            cachedFile.rpath = "$ORIGIN";
+            cachedFile.hasDependencies = true;
+            cachedFile.dependencies = {libraryPath};
+            return cachedFile;
+        }
+    };
+
+    TEST_F(DependencyCacheTest, checkEntriesArePersisted) {
+        {
+            DependencyCache cache(cachePath);
+            EXPECT_EQ(cache.size(), 0);
+
+            cache.insert(executablePath, createCachedFile());
+            EXPECT_EQ(cache.size(), 1);
+            EXPECT_TRUE(cache.save());
+        }
+
+        DependencyCache cache(cachePath);
+        EXPECT_EQ(cache.size(), 1);
+
+        CachedFile cachedFile;
+        ASSERT_TRUE(cache.lookup(executablePath, cachedFile));
+        EXPECT_EQ(cachedFile.rpath, "$ORIGIN");
+        EXPECT_TRUE(cachedFile.hasDependencies);
+        EXPECT_EQ(cachedFile.dependencies, std::vector<bf::path>{libraryPath});
+
+        EXPECT_FALSE(cache.lookup(libraryPath, cachedFile));
+
+        EXPECT_EQ(cache.getHits(), 1);
+        EXPECT_EQ(cache.getMisses(), 1);
+    }
+
+    TEST_F(DependencyCacheTest, checkChangedFilesAreNotReturned) {
+        DependencyCache cache(cachePath);
+        cache.insert(executablePath, createCachedFile());
+
+        CachedFile cachedFile;
+        ASSERT_TRUE(cache.lookup(executablePath, cachedFile));
+
+        // changing a dependency must invalidate the entry, too
+        std::ofstream(libraryPath.string(), std::ios::app) << "changed";
+        EXPECT_FALSE(cache.lookup(executablePath, cachedFile));
+    }
+
+    TEST_F(DependencyCacheTest, checkChangedEnvironmentInvalidatesCache) {
+        {
+            DependencyCache cache(cachePath);
+            cache.insert(executablePath, createCachedFile());
+            EXPECT_TRUE(cache.save());
+        }
+
+        const auto* oldLdLibraryPath = getenv("LD_LIBRARY_PATH");
+        const std::string oldValue = oldLdLibraryPath != nullptr ? oldLdLibraryPath : "";
+
+        setenv("LD_LIBRARY_PATH", tmpDir.c_str(), 1);
+
+        EXPECT_EQ(DependencyCache(cachePath).size(), 0);
+
+        if (oldLdLibraryPath != nullptr)
+            setenv("LD_LIBRARY_PATH", oldValue.c_str(), 1);
+        else
+            unsetenv("LD_LIBRARY_PATH");
+
+        EXPECT_EQ(DependencyCache(cachePath).size(), 1);
+
+        // e.g., the entries created by tracing with ldd must not be used when tracing natively
+        EXPECT_EQ(DependencyCache(cachePath, "ldd").size(), 0);
+    }
+
+    TEST_F(DependencyCacheTest, checkConcurrentSavesAreMerged) {
+        // both instances load the (empty) cache before either of them saves its entries
+        DependencyCache firstCache(cachePath);
+        DependencyCache secondCache(cachePath);
+
+        firstCache.insert(executablePath, createCachedFile());
+        secondCache.insert(libraryPath, CachedFile{});
+
+        EXPECT_TRUE(firstCache.save());
+        EXPECT_TRUE(secondCache.save());
+
+        EXPECT_EQ(DependencyCache(cachePath).size(), 2);
+    }
+
+    TEST_F(DependencyCacheTest, checkTracingUsesCache) {
+        ElfFile::setDependencyResolver(NATIVE_RESOLVER);
+
+        const auto cache = std::make_shared<DependencyCache>(cachePath);
+        ElfFile::setDependencyCache(cache);
+
+        const auto dependencies = ElfFile(SIMPLE_EXECUTABLE_PATH).traceDynamicDependencies();
+        EXPECT_EQ(cache->getMisses(), 1);
+
+        EXPECT_EQ(ElfFile(SIMPLE_EXECUTABLE_PATH).traceDynamicDependencies(), dependencies);
+        EXPECT_EQ(cache->getHits(), 1);
+
+        const auto results = ElfFile::traceDynamicDependencies({SIMPLE_EXECUTABLE_PATH});
+        EXPECT_EQ(results.at(SIMPLE_EXECUTABLE_PATH).dependencies, dependencies);
+        EXPECT_EQ(cache->getHits(), 2);
+    }
+}
@@ -1,7 +1,15 @@
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include <boost/regex.hpp>
+
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
 
 #include "linuxdeploy/core/elf_file.h"
+#include "linuxdeploy/core/ld_so_cache.h"
+#include "linuxdeploy/subprocess/subprocess.h"
 
 using namespace std;
 using namespace linuxdeploy::core;
@@ -29,10 +37,157 @@ namespace {
     void expectThrowsElfFileErrorFileNotFound(const char* path) {
         expectElfFileConstructorThrowMessage(path, "No such file or directory: ");
     }
+
+    template<typename T>
+    void swapBytes(T& value) {
+        auto* bytes = reinterpret_cast<uint8_t*>(&value);
+        std::reverse(bytes, bytes + sizeof(T));
+    }
+
+    // converts a 64-bit little endian ELF file into a big endian one
+    // the contents of the sections are not converted, which is fine for the metadata we're interested in
+    void convertToBigEndian(const bf::path& path) {
+        std::fstream file(path.string(), std::ios::in | std::ios::out | std::ios::binary);
+
+        auto readAt = [&file](uint64_t offset, void* target, size_t size) {
+            file.seekg(offset);
+            file.read(static_cast<char*>(target), size);
+        };
+
+        auto writeAt = [&file](uint64_t offset, const void* source, size_t size) {
+            file.seekp(offset);
+            file.write(static_cast<const char*>(source), size);
+        };
+
+        Elf64_Ehdr ehdr{};
+        readAt(0, &ehdr, sizeof(ehdr));
+        ASSERT_EQ(ehdr.e_ident[EI_CLASS], ELFCLASS64);
+        ASSERT_EQ(ehdr.e_ident[EI_DATA], ELFDATA2LSB);
+
+        for (uint64_t i = 0; i < ehdr.e_phnum; ++i) {
+            Elf64_Phdr phdr{};
+            readAt(ehdr.e_phoff + i * sizeof(phdr), &phdr, sizeof(phdr));
+
+            if (phdr.p_type == PT_DYNAMIC) {
+                for (uint64_t j = 0; j < phdr.p_filesz / sizeof(Elf64_Dyn); ++j) {
+                    Elf64_Dyn dyn{};
+                    readAt(phdr.p_offset + j * sizeof(dyn), &dyn, sizeof(dyn));
+                    swapBytes(dyn.d_tag);
+                    swapBytes(dyn.d_un.d_val);
+                    writeAt(phdr.p_offset + j * sizeof(dyn), &dyn, sizeof(dyn));
+                }
+            }
+
+            for (auto* field : {&phdr.p_offset, &phdr.p_vaddr, &phdr.p_paddr, &phdr.p_filesz, &phdr.p_memsz, &phdr.p_align})
+                swapBytes(*field);
+            swapBytes(phdr.p_type);
+            swapBytes(phdr.p_flags);
+            writeAt(ehdr.e_phoff + i * sizeof(phdr), &phdr, sizeof(phdr));
+        }
+
+        for (uint64_t i = 0; i < ehdr.e_shnum; ++i) {
+            Elf64_Shdr shdr{};
+            readAt(ehdr.e_shoff + i * sizeof(shdr), &shdr, sizeof(shdr));
+            for (auto* field : {&shdr.sh_flags, &shdr.sh_addr, &shdr.sh_offset, &shdr.sh_size, &shdr.sh_addralign, &shdr.sh_entsize})
+                swapBytes(*field);
+            for (auto* field : {&shdr.sh_name, &shdr.sh_type, &shdr.sh_link, &shdr.sh_info})
+                swapBytes(*field);
+            writeAt(ehdr.e_shoff + i * sizeof(shdr), &shdr, sizeof(shdr));
+        }
+
+        ehdr.e_ident[EI_DATA] = ELFDATA2MSB;
+        for (auto* field : {&ehdr.e_type, &ehdr.e_machine, &ehdr.e_ehsize, &ehdr.e_phentsize, &ehdr.e_phnum, &ehdr.e_shentsize, &ehdr.e_shnum, &ehdr.e_shstrndx})
+            swapBytes(*field);
+        for (auto* field : {&ehdr.e_entry, &ehdr.e_phoff, &ehdr.e_shoff})
+            swapBytes(*field);
+        swapBytes(ehdr.e_version);
+        swapBytes(ehdr.e_flags);
+        writeAt(0, &ehdr, sizeof(ehdr));
+    }
+
+    // removes the spare DT_NULL entries GNU ld adds to the dynamic section of a 64-bit ELF file in the host's byte
+    // order, like other linkers, e.g., lld, don't add them either
+    void removeSpareDynamicEntries(const bf::path& path) {
+        std::fstream file(path.string(), std::ios::in | std::ios::out | std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        Elf64_Ehdr ehdr{};
+        memcpy(&ehdr, data.data(), sizeof(ehdr));
+        ASSERT_EQ(ehdr.e_ident[EI_CLASS], ELFCLASS64);
+
+        std::vector<Elf64_Phdr> phdrs(ehdr.e_phnum);
+        memcpy(phdrs.data(), data.data() + ehdr.e_phoff, ehdr.e_phnum * sizeof(Elf64_Phdr));
+
+        std::vector<Elf64_Shdr> shdrs(ehdr.e_shnum);
+        memcpy(shdrs.data(), data.data() + ehdr.e_shoff, ehdr.e_shnum * sizeof(Elf64_Shdr));
+
+        const auto dynamicSegment = std::find_if(phdrs.begin(), phdrs.end(), [](const Elf64_Phdr& phdr) { return phdr.p_type == PT_DYNAMIC; });
+        ASSERT_NE(dynamicSegment, phdrs.end());
+
+        const auto* dynamicEntries = reinterpret_cast<const Elf64_Dyn*>(&data[dynamicSegment->p_offset]);
+
+        uint64_t entriesCount = 1;
+        while (dynamicEntries[entriesCount - 1].d_tag != DT_NULL)
+            ++entriesCount;
+
+        dynamicSegment->p_filesz = dynamicSegment->p_memsz = entriesCount * sizeof(Elf64_Dyn);
+
+        for (auto& shdr : shdrs) {
+            if (shdr.sh_type == SHT_DYNAMIC)
+                shdr.sh_size = dynamicSegment->p_filesz;
+        }
+
+        memcpy(&data[ehdr.e_phoff], phdrs.data(), ehdr.e_phnum * sizeof(Elf64_Phdr));
+        memcpy(&data[ehdr.e_shoff], shdrs.data(), ehdr.e_shnum * sizeof(Elf64_Shdr));
+
+        file.seekp(0);
+        file.write(data.data(), data.size());
+    }
+
+    std::string runReadelf(const std::vector<std::string>& args) {
+        std::vector<std::string> command{"readelf"};
+        command.insert(command.end(), args.begin(), args.end());
+        return linuxdeploy::subprocess::subprocess(command).check_output();
+    }
+
+    // reads the names of the sections of a 64-bit ELF file in the host's byte order
+    std::vector<std::string> readSectionNames(const bf::path& path) {
+        std::ifstream file(path.string(), std::ios::binary);
+        const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        Elf64_Ehdr ehdr{};
+        memcpy(&ehdr, data.data(), sizeof(ehdr));
+
+        std::vector<Elf64_Shdr> shdrs(ehdr.e_shnum);
+        memcpy(shdrs.data(), data.data() + ehdr.e_shoff, ehdr.e_shnum * sizeof(Elf64_Shdr));
+
+        std::vector<std::string> names;
+
+        for (const auto& shdr : shdrs)
+            names.emplace_back(data.c_str() + shdrs[ehdr.e_shstrndx].sh_offset + shdr.sh_name);
+
+        return names;
+    }
 }
 
 namespace LinuxDeployTest {
-    class ElfFileTest : public ::testing::Test {};
+    class ElfFileTest : public ::testing::Test {
+    public:
+        DEPENDENCY_RESOLVER previousDependencyResolver{};
+        RPATH_EDITOR previousRPathEditor{};
+
+    public:
+        // the methods are selected process-wide, they must not leak into other tests
+        void SetUp() override {
+            previousDependencyResolver = ElfFile::getDependencyResolver();
+            previousRPathEditor = ElfFile::getRPathEditor();
+        }
+
+        void TearDown() override {
+            ElfFile::setDependencyResolver(previousDependencyResolver);
+            ElfFile::setRPathEditor(previousRPathEditor);
+        }
+    };
 
     TEST_F(ElfFileTest, checkIsDebugSymbolsFile) {
         ElfFile debugSymbolsFile(SIMPLE_LIBRARY_DEBUG_PATH);
@@ -50,6 +205,426 @@ namespace LinuxDeployTest {
         EXPECT_FALSE(staticLibraryFile.isDynamicallyLinked());
     }
 
+    TEST_F(ElfFileTest, checkNativeResolverMatchesLdd) {
+        ElfFile::setDependencyResolver(LDD_RESOLVER);
+        const auto lddResult = ElfFile(SIMPLE_EXECUTABLE_PATH).traceDynamicDependencies();
+
+        ElfFile::setDependencyResolver(NATIVE_RESOLVER);
+        const auto nativeResult = ElfFile(SIMPLE_EXECUTABLE_PATH).traceDynamicDependencies();
+
+        EXPECT_FALSE(nativeResult.empty());
+        EXPECT_EQ(nativeResult, lddResult);
+    }
+
+    TEST_F(ElfFileTest, checkNativeResolverOnStaticExecutable) {
+        ElfFile::setDependencyResolver(NATIVE_RESOLVER);
+        EXPECT_TRUE(ElfFile(SIMPLE_EXECUTABLE_STATIC_PATH).traceDynamicDependencies().empty());
+    }
+
+    TEST_F(ElfFileTest, checkNativeResolverSearchesGlibcHwcapsSubdirectories) {
+        Elf32_Ehdr ehdr{};
+        std::ifstream(SIMPLE_EXECUTABLE_PATH, std::ios::binary).read(reinterpret_cast<char*>(&ehdr), sizeof(ehdr));
+
+        const auto subdirectories = ld_so_cache::getGlibcHwcapsSubdirectories(ehdr.e_ident[EI_CLASS], ehdr.e_machine);
+
+        if (subdirectories.empty())
+            GTEST_SKIP() << "host does not support any glibc-hwcaps subdirectories";
+
+        const auto tmpDir = bf::temp_directory_path() / bf::unique_path("linuxdeploy-tests-%%%%-%%%%-%%%%");
+        const auto hwcapsDir = tmpDir / "glibc-hwcaps" / subdirectories.front();
+        bf::create_directories(hwcapsDir);
+
+        const auto libraryFilename = bf::path(SIMPLE_LIBRARY_PATH).filename();
+        bf::copy_file(SIMPLE_LIBRARY_PATH, tmpDir / libraryFilename);
+        bf::copy_file(SIMPLE_LIBRARY_PATH, hwcapsDir / libraryFilename);
+
+        // the executable has a DT_RUNPATH, so LD_LIBRARY_PATH takes precedence
+        const auto* oldLdLibraryPath = getenv("LD_LIBRARY_PATH");
+        const std::string savedLdLibraryPath = oldLdLibraryPath != nullptr ? oldLdLibraryPath : "";
+        setenv("LD_LIBRARY_PATH", tmpDir.c_str(), 1);
+
+        ElfFile::setDependencyResolver(LDD_RESOLVER);
+        const auto lddResult = ElfFile(SIMPLE_EXECUTABLE_PATH).traceDynamicDependencies();
+
+        ElfFile::setDependencyResolver(NATIVE_RESOLVER);
+        const auto nativeResult = ElfFile(SIMPLE_EXECUTABLE_PATH).traceDynamicDependencies();
+
+        if (oldLdLibraryPath != nullptr)
+            setenv("LD_LIBRARY_PATH", savedLdLibraryPath.c_str(), 1);
+        else
+            unsetenv("LD_LIBRARY_PATH");
+
+        // the library in the subdirectory with the highest priority must be preferred, just like ld.so does
+        EXPECT_NE(std::find(nativeResult.begin(), nativeResult.end(), hwcapsDir / libraryFilename), nativeResult.end());
+        EXPECT_EQ(nativeResult, lddResult);
+
+        bf::remove_all(tmpDir);
+    }
+
+    TEST_F(ElfFileTest, checkBatchTracing) {
+        const std::vector<bf::path> paths{SIMPLE_EXECUTABLE_PATH, SIMPLE_LIBRARY_PATH, SIMPLE_EXECUTABLE_STATIC_PATH};
+
+        for (const auto resolver : {LDD_RESOLVER, NATIVE_RESOLVER}) {
+            ElfFile::setDependencyResolver(resolver);
+
+            const auto results = ElfFile::traceDynamicDependencies(paths);
+            ASSERT_EQ(results.size(), paths.size());
+
+            for (const auto& path : paths) {
+                const auto& result = results.at(path);
+                EXPECT_TRUE(result.error.empty());
+                EXPECT_EQ(result.dependencies, ElfFile(path).traceDynamicDependencies());
+            }
+
+            EXPECT_TRUE(results.at(SIMPLE_EXECUTABLE_STATIC_PATH).dependencies.empty());
+        }
+    }
+
+    TEST_F(ElfFileTest, checkBatchTracingWithInvalidFiles) {
+        const auto tmpDir = bf::temp_directory_path() / bf::unique_path("linuxdeploy-tests-%%%%-%%%%-%%%%");
+        bf::create_directories(tmpDir);
+
+        const auto textFilePath = tmpDir / "not-an-elf-file";
+        std::ofstream(textFilePath.string()) << "hello world" << std::endl;
+
+        const auto directoryPath = tmpDir / "directory";
+        bf::create_directories(directoryPath);
+
+        const auto missingPath = tmpDir / "missing";
+
+        const std::vector<bf::path> paths{
+            SIMPLE_EXECUTABLE_PATH, textFilePath, directoryPath, missingPath, SIMPLE_EXECUTABLE_STATIC_PATH
+        };
+
+        ElfFile::setDependencyResolver(LDD_RESOLVER);
+
+        const auto results = ElfFile::traceDynamicDependencies(paths);
+        ASSERT_EQ(results.size(), paths.size());
+
+        // the other files must not be affected by the invalid ones
+        EXPECT_TRUE(results.at(SIMPLE_EXECUTABLE_PATH).error.empty());
+        EXPECT_EQ(results.at(SIMPLE_EXECUTABLE_PATH).dependencies, ElfFile(SIMPLE_EXECUTABLE_PATH).traceDynamicDependencies());
+
+        // ldd treats files which are not ELF files like static executables
+        for (const auto& path : {bf::path(SIMPLE_EXECUTABLE_STATIC_PATH), textFilePath}) {
+            EXPECT_TRUE(results.at(path).error.empty()) << results.at(path).error;
+            EXPECT_TRUE(results.at(path).dependencies.empty());
+        }
+
+        for (const auto& path : {directoryPath, missingPath}) {
+            EXPECT_THAT(results.at(path).error, ::testing::HasSubstr(path.string()));
+            EXPECT_TRUE(results.at(path).dependencies.empty());
+        }
+
+        bf::remove_all(tmpDir);
+    }
+
+    TEST_F(ElfFileTest, checkParallelTracing) {
+        const std::vector<bf::path> paths{SIMPLE_EXECUTABLE_PATH, SIMPLE_LIBRARY_PATH, SIMPLE_EXECUTABLE_STATIC_PATH};
+
+        ElfFile::setDependencyResolver(NATIVE_RESOLVER);
+
+        // more jobs than files, so that the pool's threads have to steal work
+        linuxdeploy::util::thread_pool::ThreadPool pool(4);
+
+        const auto results = ElfFile::traceDynamicDependencies(paths, pool);
+        ASSERT_EQ(results.size(), paths.size());
+
+        // the order of the dependencies must not depend on the order in which the tasks finish
+        for (const auto& path : paths) {
+            EXPECT_EQ(results.at(path).dependencies, ElfFile(path).traceDynamicDependencies());
+            EXPECT_EQ(ElfFile(path).traceDynamicDependencies(pool), ElfFile(path).traceDynamicDependencies());
+        }
+    }
+
+    TEST_F(ElfFileTest, checkNativeRPathEditor) {
+        const auto tmpDir = bf::temp_directory_path() / bf::unique_path("linuxdeploy-tests-%%%%-%%%%-%%%%");
+        bf::create_directories(tmpDir);
+
+        const auto libraryPath = tmpDir / bf::path(SIMPLE_LIBRARY_PATH).filename();
+        const auto executablePath = tmpDir / bf::path(SIMPLE_EXECUTABLE_PATH).filename();
+        bf::copy_file(SIMPLE_LIBRARY_PATH, libraryPath);
+        bf::copy_file(SIMPLE_EXECUTABLE_PATH, executablePath);
+
+        ElfFile::setRPathEditor(NATIVE_EDITOR);
+
+        // library doesn't have an rpath yet, the entry must be added
+        EXPECT_TRUE(ElfFile(libraryPath).setRPath("$ORIGIN"));
+        EXPECT_EQ(ElfFile(libraryPath).getRPath(), "$ORIGIN");
+
+        // executable's rpath points to the original library's directory, shorter values fit in place
+        EXPECT_TRUE(ElfFile(executablePath).setRPath("$ORIGIN"));
+        EXPECT_EQ(ElfFile(executablePath).getRPath(), "$ORIGIN");
+
+        // longer values must be appended to the string table
+        const std::string longRPath = "$ORIGIN/../lib:$ORIGIN/../lib/x86_64-linux-gnu:$ORIGIN/../lib/other";
+        EXPECT_TRUE(ElfFile(executablePath).setRPath(longRPath));
+        EXPECT_EQ(ElfFile(executablePath).getRPath(), longRPath);
+
+        // the rewritten file must still be loadable, and its dependencies must now be resolved next to it
+        EXPECT_TRUE(ElfFile(executablePath).setRPath("$ORIGIN"));
+
+        ElfFile::setDependencyResolver(LDD_RESOLVER);
+        const auto dependencies = ElfFile(executablePath).traceDynamicDependencies();
+        EXPECT_NE(std::find(dependencies.begin(), dependencies.end(), libraryPath), dependencies.end());
+
+        bf::remove_all(tmpDir);
+    }
+
+    TEST_F(ElfFileTest, checkNativeRPathEditorUpdatesSections) {
+        const auto tmpDir = bf::temp_directory_path() / bf::unique_path("linuxdeploy-tests-%%%%-%%%%-%%%%");
+        bf::create_directories(tmpDir);
+
+        const auto libraryPath = tmpDir / bf::path(SIMPLE_LIBRARY_PATH).filename();
+        const auto executablePath = tmpDir / bf::path(SIMPLE_EXECUTABLE_PATH).filename();
+        bf::copy_file(SIMPLE_LIBRARY_PATH, libraryPath);
+        bf::copy_file(SIMPLE_EXECUTABLE_PATH, executablePath);
+
+        ElfFile::setRPathEditor(NATIVE_EDITOR);
+
+        // the linker puts other sections after the dynamic string table, therefore the table must be moved to make
+        // room for a value which is longer than the existing one
+        // patchelf must not be needed for that, it's replaced with a tool which always fails
+        setenv("PATCHELF", "/bin/false", 1);
+
+        const std::string longRPath = "$ORIGIN:$ORIGIN/" + std::string(ElfFile(SIMPLE_EXECUTABLE_PATH).getRPath().size(), 'x');
+        EXPECT_TRUE(ElfFile(executablePath).setRPath(longRPath));
+        EXPECT_EQ(ElfFile(executablePath).getRPath(), longRPath);
+        EXPECT_GT(bf::file_size(executablePath), bf::file_size(SIMPLE_EXECUTABLE_PATH));
+
+        // the library doesn't have an rpath yet
+        EXPECT_TRUE(ElfFile(libraryPath).setRPath("$ORIGIN"));
+        EXPECT_EQ(ElfFile(libraryPath).getRPath(), "$ORIGIN");
+
+        unsetenv("PATCHELF");
+
+        for (const auto& path : {executablePath, libraryPath}) {
+            // the new value must be part of the .dynstr section, which must match the table in the dynamic section
+            const auto sections = runReadelf({"-SW", path.string()});
+            const auto dynamicSection = runReadelf({"-dW", path.string()});
+
+            boost::smatch match;
+            ASSERT_TRUE(boost::regex_search(sections, match, boost::regex(R"(\.dynstr\s+STRTAB\s+(\S+)\s+\S+\s+(\S+))")));
+            const auto sectionAddress = std::stoul(match[1].str(), nullptr, 16);
+            const auto sectionSize = std::stoul(match[2].str(), nullptr, 16);
+            ASSERT_TRUE(boost::regex_search(dynamicSection, match, boost::regex(R"(\(STRTAB\)\s+(\S+))")));
+            EXPECT_EQ(sectionAddress, std::stoul(match[1].str(), nullptr, 16));
+            ASSERT_TRUE(boost::regex_search(dynamicSection, match, boost::regex(R"(\(STRSZ\)\s+(\d+))")));
+            EXPECT_EQ(sectionSize, std::stoul(match[1].str()));
+
+            EXPECT_THAT(runReadelf({"-p", ".dynstr", path.string()}), ::testing::HasSubstr(ElfFile(path).getRPath()));
+        }
+
+        // the rewritten files must still be loadable, and the dependencies must be resolved next to them, even after
+        // stripping them with the binutils
+        ElfFile::setDependencyResolver(LDD_RESOLVER);
+
+        for (const auto strip : {false, true}) {
+            if (strip)
+                linuxdeploy::subprocess::subprocess({"strip", executablePath.string(), libraryPath.string()}).check_output();
+
+            const auto dependencies = ElfFile(executablePath).traceDynamicDependencies();
+            EXPECT_NE(std::find(dependencies.begin(), dependencies.end(), libraryPath), dependencies.end());
+            EXPECT_EQ(ElfFile(executablePath).getRPath(), longRPath);
+        }
+
+        bf::remove_all(tmpDir);
+    }
+
+    TEST_F(ElfFileTest, checkNativeRPathEditorMovesDynamicSection) {
+        const auto tmpDir = bf::temp_directory_path() / bf::unique_path("linuxdeploy-tests-%%%%-%%%%-%%%%");
+        bf::create_directories(tmpDir);
+
+        const auto libraryPath = tmpDir / bf::path(SIMPLE_LIBRARY_PATH).filename();
+        const auto executablePath = tmpDir / bf::path(SIMPLE_EXECUTABLE_PATH).filename();
+        bf::copy_file(SIMPLE_LIBRARY_PATH, libraryPath);
+        bf::copy_file(SIMPLE_EXECUTABLE_PATH, executablePath);
+        removeSpareDynamicEntries(libraryPath);
+
+        ElfFile::setRPathEditor(NATIVE_EDITOR);
+
+        // without a spare entry, the dynamic section has to be extended
+        setenv("PATCHELF", "/bin/false", 1);
+        EXPECT_TRUE(ElfFile(libraryPath).setRPath("$ORIGIN"));
+        EXPECT_TRUE(ElfFile(executablePath).setRPath("$ORIGIN"));
+        unsetenv("PATCHELF");
+
+        EXPECT_EQ(ElfFile(libraryPath).getRPath(), "$ORIGIN");
+        EXPECT_THAT(runReadelf({"-dW", libraryPath.string()}), ::testing::HasSubstr("Library runpath: [$ORIGIN]"));
+
+        ElfFile::setDependencyResolver(LDD_RESOLVER);
+        const auto dependencies = ElfFile(executablePath).traceDynamicDependencies();
+        EXPECT_NE(std::find(dependencies.begin(), dependencies.end(), libraryPath), dependencies.end());
+
+        bf::remove_all(tmpDir);
+    }
+
+    TEST_F(ElfFileTest, checkBatchRPathEditing) {
+        const auto tmpDir = bf::temp_directory_path() / bf::unique_path("linuxdeploy-tests-%%%%-%%%%-%%%%");
+        bf::create_directories(tmpDir);
+
+        const auto libraryPath = tmpDir / bf::path(SIMPLE_LIBRARY_PATH).filename();
+        const auto executablePath = tmpDir / bf::path(SIMPLE_EXECUTABLE_PATH).filename();
+        const auto symlinkPath = tmpDir / "symlink.so";
+        bf::copy_file(SIMPLE_LIBRARY_PATH, libraryPath);
+        bf::copy_file(SIMPLE_EXECUTABLE_PATH, executablePath);
+        bf::create_symlink(libraryPath.filename(), symlinkPath);
+
+        ElfFile::setRPathEditor(NATIVE_EDITOR);
+
+        linuxdeploy::util::thread_pool::ThreadPool pool(4);
+
+        // the library is passed twice, the last value must win, like when setting the values one by one
+        const auto errors = ElfFile::setRPaths({
+            {executablePath, "$ORIGIN/../lib"},
+            {libraryPath, "$ORIGIN"},
+            {symlinkPath, "$ORIGIN/other"},
+        }, pool);
+
+        EXPECT_TRUE(errors.empty());
+        EXPECT_EQ(ElfFile(executablePath).getRPath(), "$ORIGIN/../lib");
+        EXPECT_EQ(ElfFile(libraryPath).getRPath(), "$ORIGIN/other");
+
+        bf::remove_all(tmpDir);
+    }
+
+    TEST_F(ElfFileTest, checkBatchRPathEditingMessages) {
+        const auto tmpDir = bf::temp_directory_path() / bf::unique_path("linuxdeploy-tests-%%%%-%%%%-%%%%");
+        bf::create_directories(tmpDir);
+
+        const auto libraryPath = tmpDir / bf::path(SIMPLE_LIBRARY_PATH).filename();
+        const auto textFilePath = tmpDir / "not-an-elf-file";
+        bf::copy_file(SIMPLE_LIBRARY_PATH, libraryPath);
+        std::ofstream(textFilePath.string()) << "hello world" << std::endl;
+
+        ElfFile::setRPathEditor(NATIVE_EDITOR);
+
+        // the file the native editor fails on is passed to patchelf, which we replace with a no-op
+        setenv("PATCHELF", "/bin/true", 1);
+
+        linuxdeploy::util::thread_pool::ThreadPool pool(2);
+
+        std::map<bf::path, FileMessages> messages;
+        const auto errors = ElfFile::setRPaths({{libraryPath, "$ORIGIN"}, {textFilePath, "$ORIGIN"}}, pool, &messages);
+
+        unsetenv("PATCHELF");
+
+        EXPECT_TRUE(errors.empty());
+
+        // the messages must be attributed to the file they are about
+        ASSERT_EQ(messages.size(), 1);
+        ASSERT_EQ(messages.count(textFilePath), 1);
+
+        const auto& textFileMessages = messages.at(textFilePath);
+        ASSERT_EQ(textFileMessages.size(), 2);
+        EXPECT_EQ(textFileMessages[0].first, linuxdeploy::core::log::LD_WARNING);
+        EXPECT_THAT(textFileMessages[0].second, ::testing::HasSubstr("Failed to set rpath natively"));
+        EXPECT_EQ(textFileMessages[1].first, linuxdeploy::core::log::LD_DEBUG);
+        EXPECT_THAT(textFileMessages[1].second, ::testing::HasSubstr(textFilePath.string()));
+
+        bf::remove_all(tmpDir);
+    }
+
+    TEST_F(ElfFileTest, checkNativeStripper) {
+        const auto tmpDir = bf::temp_directory_path() / bf::unique_path("linuxdeploy-tests-%%%%-%%%%-%%%%");
+        bf::create_directories(tmpDir);
+
+        const auto libraryPath = tmpDir / bf::path(SIMPLE_LIBRARY_PATH).filename();
+        const auto executablePath = tmpDir / bf::path(SIMPLE_EXECUTABLE_PATH).filename();
+        bf::copy_file(SIMPLE_EXECUTABLE_PATH, executablePath);
+
+        ElfFile::setStripper(NATIVE_STRIPPER);
+
+        // the library is built with debug information, which must be removed from the copy
+        EXPECT_TRUE(ElfFile(SIMPLE_LIBRARY_PATH).strip(libraryPath));
+        EXPECT_LT(bf::file_size(libraryPath), bf::file_size(SIMPLE_LIBRARY_PATH));
+        EXPECT_EQ(bf::status(libraryPath).permissions(), bf::status(SIMPLE_LIBRARY_PATH).permissions());
+
+        const auto sectionNames = readSectionNames(libraryPath);
+
+        for (const auto& name : {".symtab", ".strtab", ".debug_info", ".comment"})
+            EXPECT_EQ(std::find(sectionNames.begin(), sectionNames.end(), name), sectionNames.end()) << name;
+
+        for (const auto& name : {".dynsym", ".dynstr", ".text", ".shstrtab"})
+            EXPECT_NE(std::find(sectionNames.begin(), sectionNames.end(), name), sectionNames.end()) << name;
+
+        ElfFile strippedLibrary(libraryPath);
+        EXPECT_TRUE(strippedLibrary.isDynamicallyLinked());
+        EXPECT_FALSE(strippedLibrary.isDebugSymbolsFile());
+
+        // files can be stripped in place, and must still work afterwards
+        EXPECT_TRUE(ElfFile(executablePath).strip(executablePath));
+        EXPECT_EQ(ElfFile(executablePath).getRPath(), ElfFile(SIMPLE_EXECUTABLE_PATH).getRPath());
+        EXPECT_EQ(system(executablePath.c_str()), 0);
+
+        bf::remove_all(tmpDir);
+    }
+
+    TEST_F(ElfFileTest, checkParseCache) {
+        const auto tmpDir = bf::temp_directory_path() / bf::unique_path("linuxdeploy-tests-%%%%-%%%%-%%%%");
+        bf::create_directories(tmpDir);
+
+        const auto libraryPath = tmpDir / bf::path(SIMPLE_LIBRARY_PATH).filename();
+        const auto symlinkPath = tmpDir / "libsymlink.so";
+        bf::copy_file(SIMPLE_LIBRARY_PATH, libraryPath);
+        bf::create_symlink(libraryPath.filename(), symlinkPath);
+
+        ElfFile::clearParseCache();
+
+        ElfFile(libraryPath).getElfClass();
+        EXPECT_EQ(ElfFile::getParseCacheMisses(), 1);
+        EXPECT_EQ(ElfFile::getParseCacheHits(), 0);
+
+        // symlinks resolve to the same file, therefore the cached data can be used
+        ElfFile(symlinkPath).getElfClass();
+        ElfFile(libraryPath).getElfClass();
+        EXPECT_EQ(ElfFile::getParseCacheMisses(), 1);
+        EXPECT_EQ(ElfFile::getParseCacheHits(), 2);
+
+        // modified files must be parsed again
+        bf::copy_file(SIMPLE_LIBRARY_STRIPPED_PATH, libraryPath, bf::copy_option::overwrite_if_exists);
+        bf::last_write_time(libraryPath, bf::last_write_time(libraryPath) + 10);
+        ElfFile(libraryPath).getElfClass();
+        EXPECT_EQ(ElfFile::getParseCacheMisses(), 2);
+
+        // the cached data must reflect rpath changes
+        ElfFile::setRPathEditor(NATIVE_EDITOR);
+        EXPECT_TRUE(ElfFile(libraryPath).setRPath("$ORIGIN"));
+        EXPECT_EQ(ElfFile(symlinkPath).getRPath(), "$ORIGIN");
+
+        bf::remove_all(tmpDir);
+    }
+
+    TEST_F(ElfFileTest, checkForeignByteOrder) {
+        const auto tmpDir = bf::temp_directory_path() / bf::unique_path("linuxdeploy-tests-%%%%-%%%%-%%%%");
+        bf::create_directories(tmpDir);
+
+        const auto executablePath = tmpDir / bf::path(SIMPLE_EXECUTABLE_PATH).filename();
+        bf::copy_file(SIMPLE_EXECUTABLE_PATH, executablePath);
+        convertToBigEndian(executablePath);
+
+        const auto otherByteOrder = (ElfFile::getSystemElfEndianness() == ELFDATA2LSB) ? ELFDATA2MSB : ELFDATA2LSB;
+
+        // make sure the tests are meaningful on both little and big endian hosts
+        if (otherByteOrder == ELFDATA2MSB) {
+            ElfFile elfFile(executablePath);
+            EXPECT_EQ(elfFile.getElfClass(), ELFCLASS64);
+            EXPECT_TRUE(elfFile.isDynamicallyLinked());
+            EXPECT_FALSE(elfFile.isDebugSymbolsFile());
+            EXPECT_EQ(elfFile.getRPath(), ElfFile(SIMPLE_EXECUTABLE_PATH).getRPath());
+
+            ElfFile::setRPathEditor(NATIVE_EDITOR);
+
+            const std::string longRPath = "$ORIGIN/../lib:$ORIGIN/../lib/powerpc64-linux-gnu:$ORIGIN/../lib/other";
+            EXPECT_TRUE(elfFile.setRPath(longRPath));
+
+            ElfFile::clearParseCache();
+            EXPECT_EQ(ElfFile(executablePath).getRPath(), longRPath);
+        }
+
+        bf::remove_all(tmpDir);
+    }
+
     TEST_F(ElfFileTest, checkInvalidElfHeaderOnEmptyFile) {
         expectThrowsElfFileErrorInvalidElfHeader("/dev/null");
     }
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <fstream>
+#include <fnmatch.h>
+
+#include "gtest/gtest.h"
+
+#include "linuxdeploy/core/excludelist_matcher.h"
+
+using namespace linuxdeploy::core::excludelist_matcher;
+namespace bf = boost::filesystem;
+
+namespace {
+    // reference implementation the matcher has to agree with
+    bool fnmatchesAny(const std::vector<std::string>& patterns, const std::string& fileName) {
+        for (const auto& pattern : patterns) {
+            if (fnmatch(pattern.c_str(), fileName.c_str(), FNM_PATHNAME) == 0)
+                return true;
+        }
+
+        return false;
+    }
+}
+
+namespace LinuxDeployTest {
+    class ExcludelistMatcherTest : public ::testing::Test {};
+
+    TEST_F(ExcludelistMatcherTest, checkLiterals) {
+        const ExcludelistMatcher matcher({"libc.so.6", "libm.so.6", "libc.so.6", "ld-linux-x86-64.so.2"});
+
+        EXPECT_EQ(matcher.literalsCount(), 3);
+        EXPECT_EQ(matcher.patternsCount(), 0);
+
+        EXPECT_TRUE(matcher.matches("libc.so.6"));
+        EXPECT_TRUE(matcher.matches("ld-linux-x86-64.so.2"));
+        EXPECT_FALSE(matcher.matches("libc.so"));
+        EXPECT_FALSE(matcher.matches("libc.so.66"));
+        EXPECT_FALSE(matcher.matches(""));
+
+        EXPECT_FALSE(ExcludelistMatcher(std::vector<std::string>{}).matches("libc.so.6"));
+    }
+
+    TEST_F(ExcludelistMatcherTest, checkManyLiterals) {
+        std::vector<std::string> literals;
+        for (int i = 0; i < 2000; ++i)
+            literals.emplace_back("lib" + std::to_string(i) + ".so");
+
+        const ExcludelistMatcher matcher(literals);
+
+        for (const auto& literal : literals)
+            EXPECT_TRUE(matcher.matches(literal)) << literal;
+
+        for (int i = 2000; i < 4000; ++i)
+            EXPECT_FALSE(matcher.matches("lib" + std::to_string(i) + ".so"));
+    }
+
+    TEST_F(ExcludelistMatcherTest, checkPatternsAgreeWithFnmatch) {
+        const std::vector<std::string> patterns = {
+            "libGL.so.*", "libEGL*.so*", "lib?ss3.so", "libfoo-[0-9].so", "libbar-[!a-c].so", "lib[]x].so",
+            "lib[a-].so", "lib\\*.so", "lib[.so", "lib**z.so", "*", "lib[[:digit:]]x.so", "*.so.1*",
+        };
+
+        const std::vector<std::string> fileNames = {
+            "libGL.so.1", "libGL.so.", "libGL.so", "libEGL.so", "libEGL_mesa.so.0", "libnss3.so", "libnss33.so",
+            "libfoo-1.so", "libfoo-a.so", "libbar-d.so", "libbar-b.so", "lib].so", "libx.so", "lib-.so", "lib*.so",
+            "libX.so", "lib[.so", "libz.so", "libabcz.so", "lib1x.so", "libax.so", "libfoo.so.10", "", "a/b",
+        };
+
+        // every pattern on its own, to check the compilation of the single patterns
+        for (const auto& pattern : patterns) {
+            const ExcludelistMatcher matcher(std::vector<std::string>{pattern});
+            EXPECT_EQ(matcher.patternsCount(), 1);
+
+            for (const auto& fileName : fileNames)
+                EXPECT_EQ(matcher.matches(fileName), fnmatchesAny({pattern}, fileName)) << pattern << " " << fileName;
+        }
+
+        // all the patterns except for the catch-all one combined
+        std::vector<std::string> combinedPatterns(patterns);
+        combinedPatterns.erase(std::find(combinedPatterns.begin(), combinedPatterns.end(), "*"));
+
+        const ExcludelistMatcher matcher(combinedPatterns);
+
+        for (const auto& fileName : fileNames)
+            EXPECT_EQ(matcher.matches(fileName), fnmatchesAny(combinedPatterns, fileName)) << fileName;
+    }
+
+    TEST_F(ExcludelistMatcherTest, checkManyPatterns) {
+        // requires more states than fit into the matcher's stack buffer
+        std::vector<std::string> patterns;
+        for (int i = 0; i < 300; ++i)
+            patterns.emplace_back("lib" + std::to_string(i) + "-*.so.[0-9]");
+
+        const ExcludelistMatcher matcher(patterns);
+
+        for (const auto* fileName : {"lib0-x.so.1", "lib299-.so.9", "lib299-a-b.so.0", "lib300-x.so.1", "lib1-x.so.a", "lib150.so.1"})
+            EXPECT_EQ(matcher.matches(fileName), fnmatchesAny(patterns, fileName)) << fileName;
+    }
+
+    TEST_F(ExcludelistMatcherTest, checkGeneratedExcludelist) {
+        const auto entries = ExcludelistMatcher::getGeneratedEntries();
+        ASSERT_FALSE(entries.empty());
+
+        const auto& matcher = ExcludelistMatcher::getGenerated();
+
+        for (const auto& entry : entries) {
+            if (!ExcludelistMatcher::isPattern(entry)) {
+                EXPECT_TRUE(matcher.matches(entry)) << entry;
+            }
+        }
+
+        EXPECT_FALSE(matcher.matches("libsimple_library.so"));
+    }
+
+    TEST_F(ExcludelistMatcherTest, checkReadEntries) {
+        const auto path = bf::temp_directory_path() / bf::unique_path("linuxdeploy-tests-%%%%-%%%%-%%%%");
+
+        std::ofstream(path.string()) << "# comment" << std::endl
+                                     << std::endl
+                                     << "libfoo.so.1 # trailing comment" << std::endl
+                                     << "  libbar-*.so  " << std::endl;
+
+        const auto entries = ExcludelistMatcher::readEntries(path);
+        bf::remove(path);
+
+        EXPECT_EQ(entries, (std::vector<std::string>{"libfoo.so.1", "libbar-*.so"}));
+
+        EXPECT_THROW(ExcludelistMatcher::readEntries(path), ExcludelistError);
+    }
+}
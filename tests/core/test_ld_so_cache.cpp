@@ -0,0 +1,120 @@
+#include <fstream>
+#include <sstream>
+
+#include "gtest/gtest.h"
+
+#include "linuxdeploy/core/elf_file.h"
+#include "linuxdeploy/core/ld_so_cache.h"
+#include "linuxdeploy/subprocess/subprocess.h"
+
+using namespace linuxdeploy::core::elf_file;
+using namespace linuxdeploy::core::ld_so_cache;
+namespace bf = boost::filesystem;
+
+namespace {
+    uint16_t getOwnElfMachine() {
+        std::ifstream ifs("/proc/self/exe", std::ios::binary);
+
+        // e_machine is located at the same offset in both 32-bit and 64-bit headers
+        Elf32_Ehdr ehdr{};
+        ifs.read(reinterpret_cast<char*>(&ehdr), sizeof(ehdr));
+
+        return ehdr.e_machine;
+    }
+}
+
+namespace LinuxDeployTest {
+    class LdSoCacheTest : public ::testing::Test {};
+
+    TEST_F(LdSoCacheTest, checkLookupOfSystemLibrary) {
+        const auto cache = LdSoCache::getInstance();
+        ASSERT_NE(cache, nullptr);
+        EXPECT_GT(cache->size(), 0);
+
+        const auto* libcPath = cache->lookup("libc.so.6", ElfFile::getSystemElfClass(), getOwnElfMachine());
+        ASSERT_NE(libcPath, nullptr);
+        EXPECT_TRUE(bf::exists(libcPath));
+        EXPECT_EQ(bf::path(libcPath).filename(), "libc.so.6");
+    }
+
+    TEST_F(LdSoCacheTest, checkLookupOfNonExistingLibrary) {
+        const auto cache = LdSoCache::getInstance();
+        ASSERT_NE(cache, nullptr);
+
+        EXPECT_EQ(cache->lookup("libdoesnotexist.so.42", ElfFile::getSystemElfClass(), getOwnElfMachine()), nullptr);
+    }
+
+    TEST_F(LdSoCacheTest, checkGlibcHwcapsSubdirectories) {
+        const auto subdirectories = getGlibcHwcapsSubdirectories(ElfFile::getSystemElfClass(), getOwnElfMachine());
+
+        // the linker lists the subdirectories it searches in its help text
+        std::vector<std::string> linkerSubdirectories;
+
+        const auto* linkerPath = "/lib64/ld-linux-x86-64.so.2";
+
+        if (getOwnElfMachine() == EM_X86_64 && bf::exists(linkerPath)) {
+            std::istringstream iss(linuxdeploy::subprocess::subprocess({linkerPath, "--help"}).check_output());
+            std::string line;
+
+            while (std::getline(iss, line)) {
+                const auto pos = line.find(" (supported, searched)");
+
+                if (pos != std::string::npos && line.find("x86-64-v") != std::string::npos)
+                    linkerSubdirectories.emplace_back(line.substr(2, pos - 2));
+            }
+
+            EXPECT_EQ(subdirectories, linkerSubdirectories);
+        }
+
+        // the subdirectories are specific to the linker of the respective architecture
+        EXPECT_TRUE(getGlibcHwcapsSubdirectories(ELFCLASS32, EM_386).empty());
+    }
+
+    TEST_F(LdSoCacheTest, checkLookupOfGlibcHwcapsLibrary) {
+        const bf::path ldconfigPath = "/sbin/ldconfig";
+
+        if (!bf::exists(ldconfigPath))
+            return;
+
+        const auto tmpDir = bf::temp_directory_path() / bf::unique_path("linuxdeploy-tests-%%%%-%%%%-%%%%");
+        const auto libraryDir = tmpDir / "lib";
+        const auto libraryName = bf::path(SIMPLE_LIBRARY_PATH).filename();
+
+        // ldconfig only adds the subdirectories which are valid on the current architecture
+        const std::vector<std::string> levels{"x86-64-v2", "x86-64-v3", "x86-64-v4"};
+
+        bf::create_directories(libraryDir);
+        bf::copy_file(SIMPLE_LIBRARY_PATH, libraryDir / libraryName);
+
+        for (const auto& level : levels) {
+            bf::create_directories(libraryDir / "glibc-hwcaps" / level);
+            bf::copy_file(SIMPLE_LIBRARY_PATH, libraryDir / "glibc-hwcaps" / level / libraryName);
+        }
+
+        const auto configPath = tmpDir / "ld.so.conf";
+        const auto cachePath = tmpDir / "ld.so.cache";
+        std::ofstream(configPath.string()) << libraryDir.string() << std::endl;
+
+        linuxdeploy::subprocess::subprocess({ldconfigPath.string(), "-C", cachePath.string(), "-f", configPath.string()}).run();
+
+        const LdSoCache cache(cachePath);
+        const auto* path = cache.lookup(libraryName.c_str(), ElfFile::getSystemElfClass(), getOwnElfMachine());
+        ASSERT_NE(path, nullptr);
+
+        // the best subdirectory the CPU supports must be preferred over the generic one
+        const auto subdirectories = getGlibcHwcapsSubdirectories(ElfFile::getSystemElfClass(), getOwnElfMachine());
+
+        if (subdirectories.empty()) {
+            EXPECT_EQ(bf::path(path), libraryDir / libraryName);
+        } else {
+            EXPECT_EQ(bf::path(path), libraryDir / "glibc-hwcaps" / subdirectories.front() / libraryName);
+        }
+
+        bf::remove_all(tmpDir);
+    }
+
+    TEST_F(LdSoCacheTest, checkInvalidCacheFile) {
+        EXPECT_THROW(LdSoCache{SIMPLE_FILE_PATH}, LdSoCacheError);
+        EXPECT_THROW(LdSoCache{"/abc/def/ghi/jkl/mno/pqr/stu/vwx/yz"}, LdSoCacheError);
+    }
+}
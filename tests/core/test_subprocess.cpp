@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "linuxdeploy/subprocess/subprocess.h"
+
+using namespace linuxdeploy::subprocess;
+
+namespace LinuxDeployTest {
+    class SubprocessTest : public ::testing::Test {};
+
+    TEST_F(SubprocessTest, checkOutputAndExitCode) {
+        const auto result = subprocess({"sh", "-c", "echo out; echo err >&2; exit 3"}).run();
+
+        EXPECT_EQ(result.exit_code(), 3);
+        EXPECT_EQ(result.stdout_string(), "out\n");
+        EXPECT_EQ(result.stderr_string(), "err\n");
+
+        EXPECT_EQ(subprocess({"echo", "hello"}).check_output(), "hello\n");
+        EXPECT_THROW(subprocess({"false"}).check_output(), std::logic_error);
+    }
+
+    TEST_F(SubprocessTest, checkMissingExecutable) {
+        const auto result = subprocess({"linuxdeploy-tests-does-not-exist"}).run();
+
+        // like in a shell
+        EXPECT_EQ(result.exit_code(), 127);
+        EXPECT_NE(result.stderr_string().find("linuxdeploy-tests-does-not-exist"), std::string::npos);
+        EXPECT_EQ(result.stdout_string(), "");
+    }
+
+    TEST_F(SubprocessTest, checkEnvironment) {
+        setenv("LINUXDEPLOY_TESTS_VARIABLE", "original", 1);
+
+        const subprocess_env_map_t env{{"LINUXDEPLOY_TESTS_VARIABLE", "overridden"}, {"LINUXDEPLOY_TESTS_NEW", "new"}};
+
+        // additional variables replace the existing ones rather than being added a second time
+        const auto output = subprocess({"env"}, env).check_output();
+        EXPECT_NE(output.find("\nLINUXDEPLOY_TESTS_VARIABLE=overridden\n"), std::string::npos);
+        EXPECT_EQ(output.find("LINUXDEPLOY_TESTS_VARIABLE=original"), std::string::npos);
+        EXPECT_NE(output.find("\nLINUXDEPLOY_TESTS_NEW=new\n"), std::string::npos);
+
+        EXPECT_EQ(subprocess({"sh", "-c", "echo $LINUXDEPLOY_TESTS_VARIABLE"}).check_output(), "original\n");
+
+        // changes to our environment must be picked up
+        setenv("LINUXDEPLOY_TESTS_VARIABLE", "changed", 1);
+        EXPECT_EQ(subprocess({"sh", "-c", "echo $LINUXDEPLOY_TESTS_VARIABLE"}).check_output(), "changed\n");
+        EXPECT_EQ(subprocess({"sh", "-c", "echo $LINUXDEPLOY_TESTS_NEW"}, env).check_output(), "new\n");
+
+        unsetenv("LINUXDEPLOY_TESTS_VARIABLE");
+        EXPECT_EQ(subprocess({"sh", "-c", "echo $LINUXDEPLOY_TESTS_VARIABLE"}).check_output(), "\n");
+    }
+
+    TEST_F(SubprocessTest, checkLargeOutput) {
+        // a lot more than fits into the pipe buffers, on both streams
+        const auto result = subprocess({"sh", "-c", "head -c 1000000 /dev/zero | tr '\\0' a; head -c 300000 /dev/zero | tr '\\0' b >&2"}).run();
+
+        EXPECT_EQ(result.exit_code(), 0);
+        EXPECT_EQ(result.stdout_string(), std::string(1000000, 'a'));
+        EXPECT_EQ(result.stderr_string(), std::string(300000, 'b'));
+    }
+
+    TEST_F(SubprocessTest, checkOutputOfChildOutlivingProcess) {
+        // the background process keeps the pipes open, but we only wait for the direct child
+        const auto begin = std::chrono::steady_clock::now();
+        const auto result = subprocess({"sh", "-c", "sleep 2 & echo done"}).run();
+
+        EXPECT_EQ(result.stdout_string(), "done\n");
+        EXPECT_LT(std::chrono::steady_clock::now() - begin, std::chrono::seconds(1));
+    }
+
+    TEST_F(SubprocessTest, checkExitIsNoticedQuickly) {
+        // the exit of short-lived processes must not be noticed with a delay
+        const auto begin = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < 20; ++i)
+            EXPECT_EQ(subprocess({"true"}).run().exit_code(), 0);
+
+        EXPECT_LT(std::chrono::steady_clock::now() - begin, std::chrono::milliseconds(500));
+    }
+
+    TEST_F(SubprocessTest, checkConcurrentProcesses) {
+        std::vector<std::thread> threads;
+        std::vector<std::string> outputs(8);
+
+        for (size_t i = 0; i < outputs.size(); ++i) {
+            threads.emplace_back([i, &outputs]() {
+                outputs[i] = subprocess({"sh", "-c", "sleep 0.1; echo " + std::to_string(i)}).check_output();
+            });
+        }
+
+        for (auto& thread : threads)
+            thread.join();
+
+        for (size_t i = 0; i < outputs.size(); ++i)
+            EXPECT_EQ(outputs[i], std::to_string(i) + "\n");
+    }
+
+    TEST_F(SubprocessTest, checkLineSplitter) {
+        std::vector<std::string> lines;
+        line_splitter splitter([&lines](boost::string_view line) {
+            lines.emplace_back(line.to_string());
+        });
+
+        splitter.feed("first\nsec");
+        splitter.feed("");
+        splitter.feed("ond\n\nthi");
+        splitter.feed("rd");
+        EXPECT_EQ(lines, (std::vector<std::string>{"first", "second", ""}));
+
+        splitter.finish();
+        EXPECT_EQ(lines, (std::vector<std::string>{"first", "second", "", "third"}));
+
+        // nothing left to pass on
+        splitter.finish();
+        EXPECT_EQ(lines.size(), 4);
+    }
+
+    TEST_F(SubprocessTest, checkStreamingOutput) {
+        const subprocess proc({"sh", "-c", "seq 1 20000; echo error >&2; printf last"});
+
+        size_t stdout_size = 0;
+        std::string stderr_data;
+
+        const auto exit_code = proc.run([&stdout_size](boost::string_view data) {
+            stdout_size += data.size();
+        }, [&stderr_data](boost::string_view data) {
+            stderr_data.append(data.data(), data.size());
+        });
+
+        EXPECT_EQ(exit_code, 0);
+        EXPECT_EQ(stderr_data, "error\n");
+
+        std::vector<std::string> lines;
+
+        EXPECT_EQ(proc.run_lines([&lines](boost::string_view line) {
+            lines.emplace_back(line.to_string());
+        }, nullptr), 0);
+
+        ASSERT_EQ(lines.size(), 20001);
+        EXPECT_EQ(lines[0], "1");
+        EXPECT_EQ(lines[19999], "20000");
+        EXPECT_EQ(lines[20000], "last");
+
+        size_t total_size = 0;
+        for (const auto& line : lines)
+            total_size += line.size() + 1;
+
+        // every line but the last one has a line break
+        EXPECT_EQ(stdout_size, total_size - 1);
+
+        // the collected output is the same
+        const auto result = proc.run();
+        EXPECT_EQ(result.stdout_view().size(), stdout_size);
+        EXPECT_EQ(result.stdout_view().substr(0, 4), "1\n2\n");
+        EXPECT_EQ(result.stderr_view(), "error\n");
+    }
+}
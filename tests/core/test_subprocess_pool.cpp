@@ -0,0 +1,137 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <sys/resource.h>
+
+#include "gtest/gtest.h"
+
+#include "linuxdeploy/subprocess/subprocess_pool.h"
+
+using namespace linuxdeploy::subprocess;
+
+namespace LinuxDeployTest {
+    class SubprocessPoolTest : public ::testing::Test {};
+
+    TEST_F(SubprocessPoolTest, checkFutures) {
+        subprocess_pool pool(4);
+        EXPECT_EQ(pool.max_concurrency(), 4);
+
+        std::vector<std::future<subprocess_result>> futures;
+
+        for (int i = 0; i < 50; ++i) {
+            const auto command = "echo " + std::to_string(i) + "; echo err >&2; exit " + std::to_string(i % 3);
+            futures.emplace_back(pool.submit({"sh", "-c", command}));
+        }
+
+        for (int i = 0; i < 50; ++i) {
+            const auto result = futures[i].get();
+
+            EXPECT_EQ(result.exit_code(), i % 3);
+            EXPECT_EQ(result.stdout_string(), std::to_string(i) + "\n");
+            EXPECT_EQ(result.stderr_string(), "err\n");
+        }
+
+        // commands which cannot be run behave like in a shell
+        EXPECT_EQ(pool.submit({"linuxdeploy-tests-does-not-exist"}).get().exit_code(), 127);
+
+        const subprocess_env_map_t env{{"LINUXDEPLOY_TESTS_VARIABLE", "value"}};
+        EXPECT_EQ(pool.submit({"sh", "-c", "echo $LINUXDEPLOY_TESTS_VARIABLE"}, env).get().stdout_string(), "value\n");
+    }
+
+    TEST_F(SubprocessPoolTest, checkCallbacks) {
+        std::atomic<int> sum{0};
+
+        {
+            subprocess_pool pool(3);
+
+            for (int i = 1; i <= 20; ++i) {
+                pool.submit({"echo", std::to_string(i)}, {}, [&sum](subprocess_result result) {
+                    sum += std::stoi(result.stdout_string());
+                });
+            }
+
+            pool.wait();
+            EXPECT_EQ(sum, 210);
+
+            // errors thrown by callbacks are reported by wait()
+            pool.submit({"true"}, {}, [](subprocess_result) {
+                throw std::runtime_error("callback failed");
+            });
+
+            EXPECT_THROW(pool.wait(), std::runtime_error);
+            EXPECT_NO_THROW(pool.wait());
+
+            // the destructor waits for the remaining commands
+            pool.submit({"sh", "-c", "sleep 0.2; echo 1"}, {}, [&sum](subprocess_result result) {
+                sum += std::stoi(result.stdout_string());
+            });
+        }
+
+        EXPECT_EQ(sum, 211);
+    }
+
+    TEST_F(SubprocessPoolTest, checkConcurrencyLimit) {
+        // the commands sleep 0.2 seconds each, so they must have run concurrently, but not all at once
+        const auto begin = std::chrono::steady_clock::now();
+
+        {
+            subprocess_pool pool(4);
+
+            for (int i = 0; i < 8; ++i)
+                pool.submit({"sleep", "0.2"});
+        }
+
+        const auto duration = std::chrono::steady_clock::now() - begin;
+
+        EXPECT_GE(duration, std::chrono::milliseconds(400));
+        EXPECT_LT(duration, std::chrono::milliseconds(800));
+    }
+
+    TEST_F(SubprocessPoolTest, checkLargeOutput) {
+        // more than fits into the pipe buffers, for several processes at once
+        subprocess_pool pool(4);
+
+        std::vector<std::future<subprocess_result>> futures;
+
+        for (int i = 0; i < 4; ++i)
+            futures.emplace_back(pool.submit({"sh", "-c", "head -c 500000 /dev/zero | tr '\\0' a"}));
+
+        for (auto& future : futures)
+            EXPECT_EQ(future.get().stdout_string(), std::string(500000, 'a'));
+    }
+
+    TEST_F(SubprocessPoolTest, checkEventLoopFailure) {
+        subprocess_pool pool(2);
+
+        std::vector<std::future<subprocess_result>> futures;
+        futures.emplace_back(pool.submit({"sleep", "1"}));
+        futures.emplace_back(pool.submit({"sleep", "1"}));
+        futures.emplace_back(pool.submit({"true"}));
+
+        // give the event loop some time to start the processes
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        // poll() fails if it's called with more fds than the limit, which happens as soon as the event loop is woken
+        // up by the next job
+        rlimit old_limit{};
+        ASSERT_EQ(getrlimit(RLIMIT_NOFILE, &old_limit), 0);
+
+        rlimit new_limit = old_limit;
+        new_limit.rlim_cur = 4;
+        ASSERT_EQ(setrlimit(RLIMIT_NOFILE, &new_limit), 0);
+
+        futures.emplace_back(pool.submit({"true"}));
+
+        // the running and queued jobs must be failed rather than left pending forever
+        for (auto& future : futures)
+            EXPECT_THROW(future.get(), std::runtime_error);
+
+        ASSERT_EQ(setrlimit(RLIMIT_NOFILE, &old_limit), 0);
+
+        // as well as the ones submitted afterwards
+        EXPECT_THROW(pool.submit({"true"}).get(), std::runtime_error);
+
+        pool.submit({"true"}, {}, [](subprocess_result) {});
+        EXPECT_THROW(pool.wait(), std::runtime_error);
+    }
+}
@@ -0,0 +1,73 @@
+#include "gtest/gtest.h"
+
+#include "linuxdeploy/subprocess/subprocess.h"
+#include "linuxdeploy/subprocess/subprocess_statistics.h"
+
+using namespace linuxdeploy::subprocess;
+
+namespace LinuxDeployTest {
+    class SubprocessStatisticsTest : public ::testing::Test {
+    public:
+        void SetUp() override {
+            subprocess_statistics::instance().clear();
+        }
+    };
+
+    TEST_F(SubprocessStatisticsTest, checkResourceUsage) {
+        // burns some CPU time, and takes some wall time without using the CPU
+        const auto command = "i=0; while [ $i -lt 100000 ]; do i=$((i+1)); done; sleep 0.1";
+        const auto result = subprocess({"/bin/sh", "-c", command}).run();
+
+        const auto& usage = result.resource_usage();
+
+        EXPECT_EQ(usage.executable, "sh");
+        EXPECT_GE(usage.wall_time_seconds, 0.1);
+        EXPECT_GT(usage.user_time_seconds + usage.system_time_seconds, 0);
+        EXPECT_LT(usage.user_time_seconds + usage.system_time_seconds, usage.wall_time_seconds);
+        EXPECT_GT(usage.max_rss_kib, 0);
+
+        // processes which could not be spawned don't use any resources
+        EXPECT_EQ(subprocess({"linuxdeploy-tests-does-not-exist"}).run().resource_usage().wall_time_seconds, 0);
+    }
+
+    TEST_F(SubprocessStatisticsTest, checkAggregation) {
+        for (int i = 0; i < 3; ++i)
+            subprocess({"true"}).run();
+
+        subprocess({"sh", "-c", "sleep 0.1"}).run();
+
+        const auto entries = subprocess_statistics::instance().entries();
+
+        ASSERT_EQ(entries.size(), 2);
+
+        // sorted by wall time
+        EXPECT_EQ(entries[0].executable, "sh");
+        EXPECT_EQ(entries[0].processes_count, 1);
+        EXPECT_EQ(entries[1].executable, "true");
+        EXPECT_EQ(entries[1].processes_count, 3);
+        EXPECT_GT(entries[1].wall_time_seconds, 0);
+
+        const auto summary = subprocess_statistics::instance().summary();
+        EXPECT_NE(summary.find("true"), std::string::npos);
+        EXPECT_NE(summary.find("sh"), std::string::npos);
+
+        const auto json = subprocess_statistics::instance().to_json();
+        EXPECT_NE(json.find(R"({"executable": "sh", "processes_count": 1, )"), std::string::npos) << json;
+        EXPECT_NE(json.find(R"({"executable": "true", "processes_count": 3, )"), std::string::npos) << json;
+    }
+
+    TEST_F(SubprocessStatisticsTest, checkEmpty) {
+        EXPECT_TRUE(subprocess_statistics::instance().entries().empty());
+        EXPECT_EQ(subprocess_statistics::instance().summary(), "");
+        EXPECT_EQ(subprocess_statistics::instance().to_json(), "[\n]\n");
+    }
+
+    TEST_F(SubprocessStatisticsTest, checkJsonEscaping) {
+        subprocess_resource_usage usage;
+        usage.executable = "quote\"back\\slash\ttab";
+        subprocess_statistics::instance().record(usage);
+
+        const auto json = subprocess_statistics::instance().to_json();
+        EXPECT_NE(json.find(R"("quote\"back\\slash\u0009tab")"), std::string::npos) << json;
+    }
+}